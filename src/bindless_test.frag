@@ -0,0 +1,18 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless_textures.glsl"
+
+// Fills the target with the texture at the pushed index of the bindless
+// table. Tests use it to check that draws reach registered textures.
+
+layout(push_constant) uniform PushConstants {
+  uint texture_index;
+};
+
+layout(location = 0) out vec4 color;
+
+void main() {
+  color = SampleBindless(texture_index, vec2(0.5));
+}
@@ -0,0 +1,8 @@
+#version 450
+
+// Covers the target with a single triangle for indices 0, 1 and 2.
+
+void main() {
+  const vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+  gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
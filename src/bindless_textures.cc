@@ -0,0 +1,197 @@
+#include "bindless_textures.h"
+
+#include <algorithm>
+
+#include "context.h"
+#include "fml/logging.h"
+
+namespace one {
+
+static uint32_t GetMaxCapacity(const vk::PhysicalDevice& device) {
+  const auto properties =
+      device
+          .getProperties2<vk::PhysicalDeviceProperties2,
+                          vk::PhysicalDeviceVulkan12Properties>()
+          .get<vk::PhysicalDeviceVulkan12Properties>();
+  return std::min({
+      properties.maxDescriptorSetUpdateAfterBindSampledImages,
+      properties.maxDescriptorSetUpdateAfterBindSamplers,
+      properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+      properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+  });
+}
+
+std::shared_ptr<BindlessTextures> BindlessTextures::Make(
+    const std::shared_ptr<Context>& context,
+    uint32_t capacity) {
+  auto textures = std::shared_ptr<BindlessTextures>(
+      new BindlessTextures(context, capacity));
+  if (!textures->IsValid()) {
+    return nullptr;
+  }
+  return textures;
+}
+
+BindlessTextures::BindlessTextures(const std::shared_ptr<Context>& context,
+                                   uint32_t capacity)
+    : context_(context) {
+  if (!context || !context->SupportsBindlessTextures()) {
+    FML_LOG(ERROR) << "Device doesn't support bindless textures.";
+    return;
+  }
+
+  capacity_ = std::min(capacity, GetMaxCapacity(context->GetPhysicalDevice()));
+  if (capacity_ == 0u) {
+    return;
+  }
+
+  const auto& device = context->GetDevice();
+
+  {
+    vk::DescriptorSetLayoutBinding binding;
+    binding.binding = kBinding;
+    binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    binding.descriptorCount = capacity_;
+    binding.stageFlags = vk::ShaderStageFlagBits::eAll;
+
+    // Slots that aren't registered are never accessed and registering a
+    // texture must not disturb submissions in flight using other slots.
+    const vk::DescriptorBindingFlags binding_flags =
+        vk::DescriptorBindingFlagBits::ePartiallyBound |
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+        vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info;
+    binding_flags_info.setBindingFlags(binding_flags);
+
+    vk::DescriptorSetLayoutCreateInfo layout_info;
+    layout_info.flags =
+        vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+    layout_info.setBindings(binding);
+    layout_info.pNext = &binding_flags_info;
+
+    auto [result, layout] = device.createDescriptorSetLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_layout_ = std::move(layout);
+  }
+
+  {
+    vk::DescriptorPoolSize pool_size;
+    pool_size.type = vk::DescriptorType::eCombinedImageSampler;
+    pool_size.descriptorCount = capacity_;
+
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+    pool_info.maxSets = 1u;
+    pool_info.setPoolSizes(pool_size);
+
+    auto [result, pool] = device.createDescriptorPoolUnique(pool_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_pool_ = std::move(pool);
+  }
+
+  {
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info.descriptorPool = *descriptor_pool_;
+    set_info.setSetLayouts(*descriptor_set_layout_);
+
+    auto [result, sets] = device.allocateDescriptorSets(set_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_ = sets.front();
+  }
+
+  registered_.resize(capacity_, false);
+
+  is_valid_ = true;
+}
+
+BindlessTextures::~BindlessTextures() = default;
+
+bool BindlessTextures::IsValid() const {
+  return is_valid_;
+}
+
+uint32_t BindlessTextures::GetCapacity() const {
+  return capacity_;
+}
+
+const vk::DescriptorSetLayout& BindlessTextures::GetDescriptorSetLayout()
+    const {
+  return *descriptor_set_layout_;
+}
+
+const vk::DescriptorSet& BindlessTextures::GetDescriptorSet() const {
+  return descriptor_set_;
+}
+
+std::optional<uint32_t> BindlessTextures::Register(
+    const vk::ImageView& image_view,
+    const vk::Sampler& sampler,
+    vk::ImageLayout layout) {
+  auto context = context_.lock();
+  if (!context || !IsValid()) {
+    return std::nullopt;
+  }
+
+  // Updates to the descriptor set must be externally synchronized.
+  std::scoped_lock lock(indices_mutex_);
+
+  uint32_t index = 0u;
+  if (!free_indices_.empty()) {
+    index = free_indices_.back();
+    free_indices_.pop_back();
+  } else if (next_index_ < capacity_) {
+    index = next_index_++;
+  } else {
+    FML_LOG(ERROR) << "Bindless texture table is full.";
+    return std::nullopt;
+  }
+  registered_[index] = true;
+
+  vk::DescriptorImageInfo image_info;
+  image_info.sampler = sampler;
+  image_info.imageView = image_view;
+  image_info.imageLayout = layout;
+
+  vk::WriteDescriptorSet write;
+  write.dstSet = descriptor_set_;
+  write.dstBinding = kBinding;
+  write.dstArrayElement = index;
+  write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+  write.setImageInfo(image_info);
+
+  context->GetDevice().updateDescriptorSets(write, {});
+
+  return index;
+}
+
+void BindlessTextures::Unregister(uint32_t index) {
+  auto context = context_.lock();
+  if (!context) {
+    return;
+  }
+  {
+    std::scoped_lock lock(indices_mutex_);
+    // Freeing an index twice would hand it out to two textures.
+    if (index >= next_index_ || !registered_[index]) {
+      FML_LOG(ERROR) << "Bindless texture " << index << " isn't registered.";
+      return;
+    }
+    registered_[index] = false;
+  }
+  context->GetDeletionQueue().EnqueueCallback(
+      [weak = weak_from_this(), index]() {
+        if (auto textures = weak.lock()) {
+          std::scoped_lock lock(textures->indices_mutex_);
+          textures->free_indices_.push_back(index);
+        }
+      },
+      context->GetLastSubmittedTimelineValue());
+}
+
+}  // namespace one
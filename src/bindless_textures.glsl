@@ -0,0 +1,15 @@
+// Shader side of the table in bindless_textures.h. The set index is the one
+// the table's descriptor set layout is placed at in the pipeline layout.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#ifndef BINDLESS_TEXTURES_SET
+#define BINDLESS_TEXTURES_SET 0
+#endif
+
+layout(set = BINDLESS_TEXTURES_SET, binding = 0) uniform sampler2D
+    bindless_textures[];
+
+vec4 SampleBindless(uint index, vec2 uv) {
+  return texture(bindless_textures[nonuniformEXT(index)], uv);
+}
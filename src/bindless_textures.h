@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "fml/macros.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+// A global table of textures. Textures are registered once and shaders refer
+// to them by their index in the table. The table lives in a single descriptor
+// set that stays bound across draws so draws using different textures don't
+// need descriptor updates or rebinding. See bindless_textures.glsl for the
+// shader side.
+class BindlessTextures final
+    : public std::enable_shared_from_this<BindlessTextures> {
+ public:
+  static constexpr uint32_t kBinding = 0u;
+
+  static std::shared_ptr<BindlessTextures> Make(
+      const std::shared_ptr<Context>& context,
+      uint32_t capacity);
+
+  ~BindlessTextures();
+
+  bool IsValid() const;
+
+  uint32_t GetCapacity() const;
+
+  const vk::DescriptorSetLayout& GetDescriptorSetLayout() const;
+
+  const vk::DescriptorSet& GetDescriptorSet() const;
+
+  std::optional<uint32_t> Register(
+      const vk::ImageView& image_view,
+      const vk::Sampler& sampler,
+      vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+  // The index is only reused once the GPU is done with all submissions made
+  // till now as they may still sample from it. Indices that aren't registered
+  // are ignored.
+  void Unregister(uint32_t index);
+
+ private:
+  std::weak_ptr<Context> context_;
+  uint32_t capacity_ = 0u;
+  vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+  vk::UniqueDescriptorPool descriptor_pool_;
+  vk::DescriptorSet descriptor_set_;
+  std::mutex indices_mutex_;
+  std::vector<uint32_t> free_indices_;
+  std::vector<bool> registered_;
+  uint32_t next_index_ = 0u;
+  bool is_valid_ = false;
+
+  BindlessTextures(const std::shared_ptr<Context>& context, uint32_t capacity);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(BindlessTextures);
+};
+
+}  // namespace one
@@ -74,13 +74,19 @@ bool Capabilities::InstanceHasAllExtensions(
   return true;
 }
 
-bool Capabilities::DeviceHasAllExtensions(
-    const vk::PhysicalDevice& device,
-    const std::vector<std::string>& extensions) {
+std::set<std::string> Capabilities::GetDeviceExtensions(
+    const vk::PhysicalDevice& device) {
   std::set<std::string> supported_extensions;
   for (const auto& ext : device.enumerateDeviceExtensionProperties().value) {
     supported_extensions.insert(ext.extensionName);
   }
+  return supported_extensions;
+}
+
+bool Capabilities::DeviceHasAllExtensions(
+    const vk::PhysicalDevice& device,
+    const std::vector<std::string>& extensions) {
+  const auto supported_extensions = GetDeviceExtensions(device);
 
   for (const auto& ext : extensions) {
     if (!supported_extensions.contains(ext)) {
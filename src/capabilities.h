@@ -26,6 +26,9 @@ class Capabilities {
   static bool InstanceHasAllExtensions(
       const std::vector<std::string>& extensions);
 
+  static std::set<std::string> GetDeviceExtensions(
+      const vk::PhysicalDevice& device);
+
   static bool DeviceHasAllExtensions(
       const vk::PhysicalDevice& device,
       const std::vector<std::string>& extensions);
@@ -1,13 +1,17 @@
 #include "context.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstddef>
 #include <memory>
 #include <optional>
 #include <queue>
+#include <thread>
 
 #include "capabilities.h"
 #include "fml/concurrent_message_loop.h"
+#include "fml/cpu_affinity.h"
 #include "fml/logging.h"
 #include "vk.h"
 #include "vulkan/vulkan_handles.hpp"
@@ -20,6 +24,16 @@ static const std::vector<std::string> kRequiredDeviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 };
 
+static const std::vector<std::string> kOptionalDeviceExtensions = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_KHR_PRESENT_ID_EXTENSION_NAME,
+    VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+};
+
+// Without VK_EXT_memory_budget, only this fraction of a heap is considered
+// usable. The rest is left for other processes and driver internal use.
+static constexpr vk::DeviceSize kFallbackHeapBudgetPercent = 80u;
+
 static constexpr auto kAllCapabilitiesQueue = vk::QueueFlagBits::eGraphics |
                                               vk::QueueFlagBits::eCompute |
                                               vk::QueueFlagBits::eTransfer;
@@ -49,6 +63,22 @@ static vk::PhysicalDevice PickPhysicalDevice(const vk::Instance& instance) {
                                               kRequiredDeviceExtensions)) {
       return {};
     }
+    if (physical_device.getProperties().apiVersion < VK_API_VERSION_1_3) {
+      FML_LOG(ERROR) << "Device doesn't support Vulkan 1.3.";
+      return {};
+    }
+    const auto features = physical_device.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features,
+        vk::PhysicalDeviceVulkan13Features>();
+    if (!features.get<vk::PhysicalDeviceVulkan12Features>()
+             .timelineSemaphore) {
+      FML_LOG(ERROR) << "Device doesn't support timeline semaphores.";
+      return {};
+    }
+    if (!features.get<vk::PhysicalDeviceVulkan13Features>().synchronization2) {
+      FML_LOG(ERROR) << "Device doesn't support synchronization2.";
+      return {};
+    }
     if (!PickQueue(physical_device, kAllCapabilitiesQueue).has_value()) {
       return {};
     }
@@ -57,16 +87,89 @@ static vk::PhysicalDevice PickPhysicalDevice(const vk::Instance& instance) {
   return {};
 }
 
-static vk::UniqueDevice CreateDevice(const vk::PhysicalDevice& device,
-                                     const QueueIndexVK& queue_index) {
+static std::set<std::string> PickDeviceExtensions(
+    const vk::PhysicalDevice& device) {
+  std::set<std::string> extensions(kRequiredDeviceExtensions.begin(),
+                                   kRequiredDeviceExtensions.end());
+  const auto supported = Capabilities::GetDeviceExtensions(device);
+  for (const auto& ext : kOptionalDeviceExtensions) {
+    if (supported.contains(ext)) {
+      extensions.insert(ext);
+    }
+  }
+  return extensions;
+}
+
+static bool HasPresentWaitFeatures(const vk::PhysicalDevice& device,
+                                   const std::set<std::string>& extensions) {
+  if (!extensions.contains(VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+      !extensions.contains(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    return false;
+  }
+  const auto features =
+      device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                          vk::PhysicalDevicePresentIdFeaturesKHR,
+                          vk::PhysicalDevicePresentWaitFeaturesKHR>();
+  return features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+         features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+}
+
+static bool HasBindlessTextureFeatures(
+    const vk::PhysicalDeviceVulkan12Features& features) {
+  return features.runtimeDescriptorArray &&
+         features.shaderSampledImageArrayNonUniformIndexing &&
+         features.descriptorBindingPartiallyBound &&
+         features.descriptorBindingSampledImageUpdateAfterBind &&
+         features.descriptorBindingUpdateUnusedWhilePending;
+}
+
+static vk::PhysicalDeviceFeatures PickFeatures(
+    const vk::PhysicalDevice& device) {
+  const auto supported = device.getFeatures();
+
+  vk::PhysicalDeviceFeatures features;
+  features.multiDrawIndirect = supported.multiDrawIndirect;
+  features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+  return features;
+}
+
+static vk::PhysicalDeviceVulkan12Features PickVulkan12Features(
+    const vk::PhysicalDevice& device) {
+  const auto supported =
+      device
+          .getFeatures2<vk::PhysicalDeviceFeatures2,
+                        vk::PhysicalDeviceVulkan12Features>()
+          .get<vk::PhysicalDeviceVulkan12Features>();
+
+  vk::PhysicalDeviceVulkan12Features features;
+  features.timelineSemaphore = true;
+  if (HasBindlessTextureFeatures(supported)) {
+    features.runtimeDescriptorArray = true;
+    features.shaderSampledImageArrayNonUniformIndexing = true;
+    features.descriptorBindingPartiallyBound = true;
+    features.descriptorBindingSampledImageUpdateAfterBind = true;
+    features.descriptorBindingUpdateUnusedWhilePending = true;
+  }
+  features.drawIndirectCount = supported.drawIndirectCount;
+  return features;
+}
+
+static vk::UniqueDevice CreateDevice(
+    const vk::PhysicalDevice& device,
+    const QueueIndexVK& queue_index,
+    const std::set<std::string>& extensions,
+    const vk::PhysicalDeviceFeatures& features,
+    vk::PhysicalDeviceVulkan12Features features_12,
+    vk::PhysicalDeviceVulkan13Features features_13,
+    bool present_wait) {
   vk::DeviceCreateInfo device_info;
 
-  std::vector<const char*> required_extensions;
-  required_extensions.reserve(kRequiredDeviceExtensions.size());
-  for (const auto& ext : kRequiredDeviceExtensions) {
-    required_extensions.push_back(ext.c_str());
+  std::vector<const char*> enabled_extensions;
+  enabled_extensions.reserve(extensions.size());
+  for (const auto& ext : extensions) {
+    enabled_extensions.push_back(ext.c_str());
   }
-  device_info.setPEnabledExtensionNames(required_extensions);
+  device_info.setPEnabledExtensionNames(enabled_extensions);
 
   std::array<float, 1u> queue_priorities = {1.0f};
   vk::DeviceQueueCreateInfo queue_info;
@@ -77,18 +180,47 @@ static vk::UniqueDevice CreateDevice(const vk::PhysicalDevice& device,
 
   device_info.setQueueCreateInfos(queue_info);
 
-  vk::PhysicalDeviceFeatures device_features;
+  features_12.pNext = &features_13;
+
+  vk::PhysicalDevicePresentIdFeaturesKHR present_id_features;
+  present_id_features.presentId = true;
+  vk::PhysicalDevicePresentWaitFeaturesKHR present_wait_features;
+  present_wait_features.presentWait = true;
+  if (present_wait) {
+    features_13.pNext = &present_id_features;
+    present_id_features.pNext = &present_wait_features;
+  }
+
+  vk::PhysicalDeviceFeatures2 device_features;
+  device_features.features = features;
+  device_features.pNext = &features_12;
 
-  device_info.setPEnabledFeatures(&device_features);
+  device_info.pNext = &device_features;
 
   return device.createDeviceUnique(device_info).value;
 }
 
+size_t Context::PickWorkerCount(const ContextSettings& settings) {
+  if (settings.worker_count > 0u) {
+    return settings.worker_count;
+  }
+  size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  if (settings.pin_to_performance_cores) {
+    if (const auto efficiency_cores = fml::EfficiencyCoreCount();
+        efficiency_cores.has_value() && efficiency_cores.value() < cores) {
+      cores -= efficiency_cores.value();
+    }
+  }
+  // Leave a core for the render thread.
+  return std::max<size_t>(cores - 1u, 1u);
+}
+
 std::shared_ptr<Context> Context::Make(
     PFN_vkGetInstanceProcAddr proc_address_callback,
-    const std::set<std::string>& additional_instance_extensions) {
-  auto context = std::shared_ptr<Context>(
-      new Context(proc_address_callback, additional_instance_extensions));
+    const std::set<std::string>& additional_instance_extensions,
+    const ContextSettings& settings) {
+  auto context = std::shared_ptr<Context>(new Context(
+      proc_address_callback, additional_instance_extensions, settings));
   if (!context->IsValid()) {
     return nullptr;
   }
@@ -96,7 +228,8 @@ std::shared_ptr<Context> Context::Make(
 }
 
 Context::Context(PFN_vkGetInstanceProcAddr proc_address_callback,
-                 const std::set<std::string>& additional_instance_extensions) {
+                 const std::set<std::string>& additional_instance_extensions,
+                 const ContextSettings& settings) {
   if (!proc_address_callback) {
     FML_LOG(ERROR) << "Invalid proc. address callback.";
     return;
@@ -163,21 +296,79 @@ Context::Context(PFN_vkGetInstanceProcAddr proc_address_callback,
   }
   queue_index_ = queue_index.value();
 
-  device_ = CreateDevice(physical_device_, queue_index_);
+  device_extensions_ = PickDeviceExtensions(physical_device_);
+
+  // Present wait is only useful with present IDs so both or neither are
+  // enabled.
+  supports_present_wait_ =
+      HasPresentWaitFeatures(physical_device_, device_extensions_);
+  if (!supports_present_wait_) {
+    device_extensions_.erase(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    device_extensions_.erase(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  }
+
+  features_ = PickFeatures(physical_device_);
+  features_12_ = PickVulkan12Features(physical_device_);
+
+  // Render graph barriers are recorded with synchronization2 and passes draw
+  // with dynamic rendering.
+  vk::PhysicalDeviceVulkan13Features features_13;
+  features_13.synchronization2 = true;
+  features_13.dynamicRendering = true;
+
+  device_ = CreateDevice(physical_device_, queue_index_, device_extensions_,
+                         features_, features_12_, features_13,
+                         supports_present_wait_);
   if (!device_) {
     return;
   }
 
   queue_ = device_->getQueue(queue_index_.family, queue_index_.index);
 
-  concurrent_message_loop_ = fml::ConcurrentMessageLoop::Create(4u);
+  concurrent_message_loop_ =
+      fml::ConcurrentMessageLoop::Create(PickWorkerCount(settings));
 
   concurrent_task_runner_ = concurrent_message_loop_->GetTaskRunner();
 
+  render_thread_ = std::make_unique<fml::Thread>(
+      fml::Thread::SetCurrentThreadConfig,
+      fml::Thread::ThreadConfig("io.render",
+                                fml::Thread::ThreadPriority::kRaster));
+
+  if (settings.pin_to_performance_cores) {
+    const auto pin = []() {
+      fml::RequestAffinity(fml::CpuAffinity::kPerformance);
+    };
+    concurrent_message_loop_->PostTaskToAllWorkers(pin);
+    render_thread_->GetTaskRunner()->PostTask(pin);
+  }
+
+  {
+    vk::SemaphoreTypeCreateInfo timeline_type_info;
+    timeline_type_info.semaphoreType = vk::SemaphoreType::eTimeline;
+    timeline_type_info.initialValue = last_submitted_timeline_value_;
+    vk::SemaphoreCreateInfo timeline_info;
+    timeline_info.pNext = &timeline_type_info;
+    auto [result, timeline] = device_->createSemaphoreUnique(timeline_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    timeline_ = std::move(timeline);
+  }
+
+  deletion_queue_ = std::make_unique<DeletionQueue>(concurrent_task_runner_);
+
   is_valid_ = true;
 }
 
-Context::~Context() = default;
+Context::~Context() {
+  if (device_) {
+    [[maybe_unused]] auto result = device_->waitIdle();
+  }
+  if (deletion_queue_) {
+    deletion_queue_->Drain();
+  }
+}
 
 bool Context::IsValid() const {
   return is_valid_;
@@ -199,6 +390,86 @@ const vk::Device& Context::GetDevice() const {
   return *device_;
 }
 
+bool Context::HasDeviceExtension(const std::string& ext) const {
+  return device_extensions_.contains(ext);
+}
+
+const vk::PhysicalDeviceFeatures& Context::GetFeatures() const {
+  return features_;
+}
+
+const vk::PhysicalDeviceVulkan12Features& Context::GetVulkan12Features()
+    const {
+  return features_12_;
+}
+
+bool Context::SupportsBindlessTextures() const {
+  return HasBindlessTextureFeatures(features_12_);
+}
+
+bool Context::SupportsPresentWait() const {
+  return supports_present_wait_;
+}
+
+bool Context::SupportsIndirectDrawCount() const {
+  return features_.multiDrawIndirect && features_.drawIndirectFirstInstance &&
+         features_12_.drawIndirectCount;
+}
+
+std::optional<uint32_t> Context::FindMemoryTypeIndex(
+    uint32_t memory_type_bits,
+    vk::MemoryPropertyFlags properties) const {
+  const auto memory_properties = physical_device_.getMemoryProperties();
+  for (uint32_t i = 0u; i < memory_properties.memoryTypeCount; i++) {
+    if (!(memory_type_bits & (1u << i))) {
+      continue;
+    }
+    if ((memory_properties.memoryTypes[i].propertyFlags & properties) !=
+        properties) {
+      continue;
+    }
+    return i;
+  }
+  return std::nullopt;
+}
+
+vk::MemoryPropertyFlags Context::GetMemoryTypeProperties(
+    uint32_t memory_type_index) const {
+  const auto memory_properties = physical_device_.getMemoryProperties();
+  if (memory_type_index >= memory_properties.memoryTypeCount) {
+    return {};
+  }
+  return memory_properties.memoryTypes[memory_type_index].propertyFlags;
+}
+
+std::vector<HeapBudgetVK> Context::GetHeapBudgets() const {
+  std::vector<HeapBudgetVK> budgets;
+  if (HasDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    const auto chain = physical_device_.getMemoryProperties2<
+        vk::PhysicalDeviceMemoryProperties2,
+        vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    const auto& props =
+        chain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+    const auto& budget =
+        chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    for (uint32_t i = 0u; i < props.memoryHeapCount; i++) {
+      budgets.push_back(HeapBudgetVK{
+          .usage = budget.heapUsage[i],
+          .budget = budget.heapBudget[i],
+      });
+    }
+    return budgets;
+  }
+  const auto props = physical_device_.getMemoryProperties();
+  for (uint32_t i = 0u; i < props.memoryHeapCount; i++) {
+    budgets.push_back(HeapBudgetVK{
+        .usage = 0u,
+        .budget = props.memoryHeaps[i].size * kFallbackHeapBudgetPercent / 100u,
+    });
+  }
+  return budgets;
+}
+
 const QueueIndexVK& Context::GetQueueIndex() const {
   return queue_index_;
 }
@@ -212,4 +483,74 @@ Context::GetConcurrentTaskRunner() const {
   return concurrent_task_runner_;
 }
 
+size_t Context::GetWorkerCount() const {
+  return concurrent_message_loop_->GetWorkerCount();
+}
+
+fml::RefPtr<fml::TaskRunner> Context::GetRenderTaskRunner() const {
+  return render_thread_->GetTaskRunner();
+}
+
+std::optional<uint64_t> Context::Submit(const vk::SubmitInfo& submit_info,
+                                        vk::Fence fence) {
+  FML_DCHECK(submit_info.pNext == nullptr);
+
+  std::scoped_lock lock(queue_mutex_);
+
+  signal_semaphores_.assign(
+      submit_info.pSignalSemaphores,
+      submit_info.pSignalSemaphores + submit_info.signalSemaphoreCount);
+  signal_semaphores_.push_back(*timeline_);
+  // Values for binary semaphores are ignored.
+  signal_values_.assign(signal_semaphores_.size(), 0u);
+
+  const auto timeline_value = last_submitted_timeline_value_ + 1u;
+  signal_values_.back() = timeline_value;
+
+  vk::TimelineSemaphoreSubmitInfo timeline_info;
+  timeline_info.setSignalSemaphoreValues(signal_values_);
+
+  auto info = submit_info;
+  info.setSignalSemaphores(signal_semaphores_);
+  info.pNext = &timeline_info;
+
+  if (queue_.submit(info, fence) != vk::Result::eSuccess) {
+    return std::nullopt;
+  }
+  last_submitted_timeline_value_ = timeline_value;
+  return timeline_value;
+}
+
+vk::Result Context::Present(const vk::PresentInfoKHR& present_info) {
+  std::scoped_lock lock(queue_mutex_);
+  return queue_.presentKHR(present_info);
+}
+
+uint64_t Context::GetLastSubmittedTimelineValue() const {
+  std::scoped_lock lock(queue_mutex_);
+  return last_submitted_timeline_value_;
+}
+
+uint64_t Context::GetCompletedTimelineValue() const {
+  auto [result, value] = device_->getSemaphoreCounterValue(*timeline_);
+  if (result != vk::Result::eSuccess) {
+    return 0u;
+  }
+  return value;
+}
+
+bool Context::WaitForTimelineValue(uint64_t timeline_value) const {
+  using namespace std::chrono_literals;
+  static constexpr auto kTimeoutNS = std::chrono::nanoseconds(10s);
+  vk::SemaphoreWaitInfo wait_info;
+  wait_info.setSemaphores(*timeline_);
+  wait_info.setValues(timeline_value);
+  return device_->waitSemaphores(wait_info, kTimeoutNS.count()) ==
+         vk::Result::eSuccess;
+}
+
+DeletionQueue& Context::GetDeletionQueue() const {
+  return *deletion_queue_;
+}
+
 }  // namespace one
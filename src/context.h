@@ -1,10 +1,16 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 #include "capabilities.h"
+#include "deletion_queue.h"
 #include "fml/concurrent_message_loop.h"
 #include "fml/macros.h"
+#include "fml/task_runner.h"
+#include "fml/thread.h"
 #include "vk.h"
 
 namespace one {
@@ -14,14 +20,33 @@ struct QueueIndexVK {
   uint32_t index = 0u;
 };
 
+struct HeapBudgetVK {
+  vk::DeviceSize usage = 0u;
+  vk::DeviceSize budget = 0u;
+};
+
+struct ContextSettings {
+  // The number of concurrent workers. Zero picks a count based on the core
+  // topology of the machine.
+  size_t worker_count = 0u;
+  // On CPUs with both performance and efficiency cores, keep the workers and
+  // the render thread on the performance cores.
+  bool pin_to_performance_cores = true;
+};
+
 class Context final : public std::enable_shared_from_this<Context> {
  public:
   static std::shared_ptr<Context> Make(
       PFN_vkGetInstanceProcAddr proc_address_callback,
-      const std::set<std::string>& additional_instance_extensions);
+      const std::set<std::string>& additional_instance_extensions,
+      const ContextSettings& settings = {});
 
   ~Context();
 
+  // The number of workers a context made with the settings runs. Unless set,
+  // one core is left for the render thread.
+  static size_t PickWorkerCount(const ContextSettings& settings);
+
   bool IsValid() const;
 
   const Capabilities& GetCapabilities() const;
@@ -32,26 +57,87 @@ class Context final : public std::enable_shared_from_this<Context> {
 
   const vk::Device& GetDevice() const;
 
+  bool HasDeviceExtension(const std::string& ext) const;
+
+  // The Vulkan 1.0 features enabled on the device.
+  const vk::PhysicalDeviceFeatures& GetFeatures() const;
+
+  // The Vulkan 1.2 features enabled on the device.
+  const vk::PhysicalDeviceVulkan12Features& GetVulkan12Features() const;
+
+  bool SupportsBindlessTextures() const;
+
+  // Whether VK_KHR_present_id and VK_KHR_present_wait are enabled.
+  bool SupportsPresentWait() const;
+
+  // Whether draws may be issued with vkCmdDrawIndexedIndirectCount, with a
+  // non-zero firstInstance.
+  bool SupportsIndirectDrawCount() const;
+
+  std::optional<uint32_t> FindMemoryTypeIndex(
+      uint32_t memory_type_bits,
+      vk::MemoryPropertyFlags properties) const;
+
+  vk::MemoryPropertyFlags GetMemoryTypeProperties(
+      uint32_t memory_type_index) const;
+
+  // If VK_EXT_memory_budget is unavailable, usage is reported as zero and the
+  // budget is derived from the heap size.
+  std::vector<HeapBudgetVK> GetHeapBudgets() const;
+
   const QueueIndexVK& GetQueueIndex() const;
 
   const vk::Queue& GetQueue() const;
 
+  // Submits to the queue and signals the timeline semaphore. The GPU is done
+  // with the submission once the returned timeline value is reached.
+  std::optional<uint64_t> Submit(const vk::SubmitInfo& submit_info,
+                                 vk::Fence fence = {});
+
+  vk::Result Present(const vk::PresentInfoKHR& present_info);
+
+  uint64_t GetLastSubmittedTimelineValue() const;
+
+  uint64_t GetCompletedTimelineValue() const;
+
+  bool WaitForTimelineValue(uint64_t timeline_value) const;
+
+  DeletionQueue& GetDeletionQueue() const;
+
   const std::shared_ptr<fml::ConcurrentTaskRunner>& GetConcurrentTaskRunner()
       const;
 
+  size_t GetWorkerCount() const;
+
+  // A dedicated thread for recording and submitting frames.
+  fml::RefPtr<fml::TaskRunner> GetRenderTaskRunner() const;
+
  private:
   std::unique_ptr<Capabilities> caps_;
   vk::UniqueInstance instance_;
   QueueIndexVK queue_index_;
   vk::PhysicalDevice physical_device_;
+  std::set<std::string> device_extensions_;
+  vk::PhysicalDeviceFeatures features_;
+  vk::PhysicalDeviceVulkan12Features features_12_;
+  bool supports_present_wait_ = false;
   vk::UniqueDevice device_;
   vk::Queue queue_;
   std::shared_ptr<fml::ConcurrentMessageLoop> concurrent_message_loop_;
   std::shared_ptr<fml::ConcurrentTaskRunner> concurrent_task_runner_;
+  std::unique_ptr<fml::Thread> render_thread_;
+  vk::UniqueSemaphore timeline_;
+  mutable std::mutex queue_mutex_;
+  uint64_t last_submitted_timeline_value_ = 0u;
+  // Reused by every submission so submitting doesn't allocate.
+  std::vector<vk::Semaphore> signal_semaphores_;
+  std::vector<uint64_t> signal_values_;
+  std::unique_ptr<DeletionQueue> deletion_queue_;
   bool is_valid_ = false;
 
   Context(PFN_vkGetInstanceProcAddr proc_address_callback,
-          const std::set<std::string>& additional_instance_extensions);
+          const std::set<std::string>& additional_instance_extensions,
+          const ContextSettings& settings);
 
   FML_DISALLOW_COPY_AND_ASSIGN(Context);
 };
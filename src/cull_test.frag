@@ -0,0 +1,9 @@
+#version 450
+
+// Each draw adds one to the red channel of the target with additive blending.
+
+layout(location = 0) out vec4 color;
+
+void main() {
+  color = vec4(1.0 / 255.0, 0.0, 0.0, 0.0);
+}
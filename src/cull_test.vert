@@ -0,0 +1,13 @@
+#version 450
+
+// Draws a triangle covering only pixel gl_InstanceIndex % 256 of a 16x16
+// target for indices 0, 1 and 2. Tests use it to check which instances the
+// GPU culler draws.
+
+void main() {
+  const uint pixel = uint(gl_InstanceIndex) % 256u;
+  const vec2 corner = vec2(pixel % 16u, pixel / 16u);
+  // Legs of 1.5 pixels cover the center of the pixel and no other.
+  const vec2 offset = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+  gl_Position = vec4((corner + offset * 0.75) / 8.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,66 @@
+#include "deletion_queue.h"
+
+#include <vector>
+
+namespace one {
+
+DeletionQueue::DeletionQueue(
+    std::shared_ptr<fml::ConcurrentTaskRunner> task_runner)
+    : task_runner_(std::move(task_runner)) {}
+
+DeletionQueue::~DeletionQueue() {
+  Drain();
+}
+
+void DeletionQueue::EnqueueCallback(fml::closure callback,
+                                    uint64_t timeline_value) {
+  if (!callback) {
+    return;
+  }
+  std::scoped_lock lock(mutex_);
+  pending_.emplace(timeline_value, std::move(callback));
+}
+
+void DeletionQueue::Collect(uint64_t completed_timeline_value) {
+  std::vector<fml::closure> batch;
+  {
+    std::scoped_lock lock(mutex_);
+    const auto end = pending_.upper_bound(completed_timeline_value);
+    for (auto it = pending_.begin(); it != end; ++it) {
+      batch.emplace_back(std::move(it->second));
+    }
+    pending_.erase(pending_.begin(), end);
+  }
+  if (batch.empty()) {
+    return;
+  }
+  auto free_batch = fml::MakeCopyable([batch = std::move(batch)]() mutable {
+    for (const auto& deleter : batch) {
+      deleter();
+    }
+    batch.clear();
+  });
+  if (!task_runner_) {
+    free_batch();
+    return;
+  }
+  task_runner_->PostTask(free_batch);
+}
+
+void DeletionQueue::Drain() {
+  std::multimap<uint64_t, fml::closure> pending;
+  {
+    std::scoped_lock lock(mutex_);
+    std::swap(pending, pending_);
+  }
+  for (const auto& [timeline_value, deleter] : pending) {
+    deleter();
+  }
+}
+
+size_t DeletionQueue::GetPendingCount() const {
+  std::scoped_lock lock(mutex_);
+  return pending_.size();
+}
+
+}  // namespace one
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "fml/closure.h"
+#include "fml/concurrent_message_loop.h"
+#include "fml/macros.h"
+#include "fml/make_copyable.h"
+
+namespace one {
+
+// Holds on to resources till the GPU is done with the submissions that use
+// them. Each resource is tagged with the timeline value of the last submission
+// that uses it. Resources whose timeline values have been reached are freed in
+// batches on the concurrent task runner so the render thread never waits on
+// the driver to release them.
+class DeletionQueue {
+ public:
+  explicit DeletionQueue(
+      std::shared_ptr<fml::ConcurrentTaskRunner> task_runner);
+
+  // Frees all pending resources on the callers thread. The caller must ensure
+  // the GPU is idle.
+  ~DeletionQueue();
+
+  // The handle may be any of the vk::Unique* handle types or anything else
+  // whose destructor releases the resource.
+  template <class Handle>
+  void Enqueue(Handle handle, uint64_t timeline_value) {
+    EnqueueCallback(fml::MakeCopyable([handle = std::move(handle)]() mutable {
+                      [[maybe_unused]] auto released = std::move(handle);
+                    }),
+                    timeline_value);
+  }
+
+  // Invokes the callback once the timeline value has been reached.
+  void EnqueueCallback(fml::closure callback, uint64_t timeline_value);
+
+  void Collect(uint64_t completed_timeline_value);
+
+  // Frees all pending resources on the callers thread. The caller must ensure
+  // the GPU is idle.
+  void Drain();
+
+  size_t GetPendingCount() const;
+
+ private:
+  std::shared_ptr<fml::ConcurrentTaskRunner> task_runner_;
+  mutable std::mutex mutex_;
+  std::multimap<uint64_t, fml::closure> pending_;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(DeletionQueue);
+};
+
+}  // namespace one
@@ -0,0 +1,184 @@
+#include "frame_allocator.h"
+
+#include <algorithm>
+
+#include "context.h"
+#include "fml/logging.h"
+
+namespace one {
+
+static vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+  return (value + alignment - 1u) / alignment * alignment;
+}
+
+FrameAllocator::FrameAllocator(const std::shared_ptr<Context>& context,
+                               size_t frame_count,
+                               size_t host_block_size,
+                               vk::DeviceSize device_frame_size)
+    : context_(context) {
+  if (!context || frame_count == 0u || host_block_size == 0u ||
+      device_frame_size == 0u) {
+    return;
+  }
+
+  for (size_t i = 0; i < frame_count; i++) {
+    host_arenas_.emplace_back(std::make_unique<HostArena>(host_block_size));
+  }
+
+  const auto limits = context->GetPhysicalDevice().getProperties().limits;
+  min_alignment_ = std::max(limits.minUniformBufferOffsetAlignment,
+                            limits.minStorageBufferOffsetAlignment);
+  non_coherent_atom_size_ = limits.nonCoherentAtomSize;
+
+  // Each frame's slice starts at an offset that is valid for both dynamic
+  // offsets and flushes of non-coherent memory.
+  device_frame_size_ = AlignUp(
+      device_frame_size, std::max(min_alignment_, non_coherent_atom_size_));
+
+  const auto& device = context->GetDevice();
+
+  {
+    vk::BufferCreateInfo buffer_info;
+    buffer_info.size = device_frame_size_ * frame_count;
+    buffer_info.usage = vk::BufferUsageFlagBits::eUniformBuffer |
+                        vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eVertexBuffer |
+                        vk::BufferUsageFlagBits::eIndexBuffer |
+                        vk::BufferUsageFlagBits::eIndirectBuffer |
+                        vk::BufferUsageFlagBits::eTransferSrc;
+    buffer_info.sharingMode = vk::SharingMode::eExclusive;
+    auto [result, buffer] = device.createBufferUnique(buffer_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    buffer_ = std::move(buffer);
+  }
+
+  const auto requirements = device.getBufferMemoryRequirements(*buffer_);
+  // Device local memory the host can write to saves the GPU reading the data
+  // over the bus every time it's used. Fall back to any host visible memory.
+  std::optional<uint32_t> memory_type;
+  for (const auto& properties : {
+           vk::MemoryPropertyFlagBits::eDeviceLocal |
+               vk::MemoryPropertyFlagBits::eHostVisible |
+               vk::MemoryPropertyFlagBits::eHostCoherent,
+           vk::MemoryPropertyFlagBits::eHostVisible |
+               vk::MemoryPropertyFlagBits::eHostCoherent,
+           vk::MemoryPropertyFlags{vk::MemoryPropertyFlagBits::eHostVisible},
+       }) {
+    memory_type =
+        context->FindMemoryTypeIndex(requirements.memoryTypeBits, properties);
+    if (memory_type.has_value()) {
+      break;
+    }
+  }
+  if (!memory_type.has_value()) {
+    FML_LOG(ERROR) << "No host visible memory for frame allocations.";
+    return;
+  }
+  is_coherent_ = static_cast<bool>(
+      context->GetMemoryTypeProperties(memory_type.value()) &
+      vk::MemoryPropertyFlagBits::eHostCoherent);
+
+  {
+    vk::MemoryAllocateInfo allocate_info;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = memory_type.value();
+    auto [result, memory] = device.allocateMemoryUnique(allocate_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    memory_ = std::move(memory);
+  }
+
+  if (device.bindBufferMemory(*buffer_, *memory_, 0u) !=
+      vk::Result::eSuccess) {
+    return;
+  }
+
+  auto [map_result, mapping] = device.mapMemory(*memory_, 0u, VK_WHOLE_SIZE);
+  if (map_result != vk::Result::eSuccess) {
+    return;
+  }
+  mapping_ = static_cast<uint8_t*>(mapping);
+
+  is_valid_ = true;
+}
+
+FrameAllocator::~FrameAllocator() = default;
+
+bool FrameAllocator::IsValid() const {
+  return is_valid_;
+}
+
+size_t FrameAllocator::GetFrameCount() const {
+  return host_arenas_.size();
+}
+
+void FrameAllocator::BeginFrame(size_t frame_index) {
+  FML_DCHECK(frame_index < host_arenas_.size());
+  frame_index_ = frame_index;
+  device_offset_ = 0u;
+  host_arenas_[frame_index_]->Reset();
+}
+
+bool FrameAllocator::EndFrame() {
+  if (!IsValid()) {
+    return false;
+  }
+  if (is_coherent_ || device_offset_ == 0u) {
+    return true;
+  }
+  auto context = context_.lock();
+  if (!context) {
+    return false;
+  }
+  vk::MappedMemoryRange range;
+  range.memory = *memory_;
+  range.offset = device_frame_size_ * frame_index_;
+  range.size = std::min(AlignUp(device_offset_, non_coherent_atom_size_),
+                        device_frame_size_);
+  return context->GetDevice().flushMappedMemoryRanges(range) ==
+         vk::Result::eSuccess;
+}
+
+HostArena& FrameAllocator::GetHostArena() {
+  return *host_arenas_[frame_index_];
+}
+
+std::optional<TransientAllocation> FrameAllocator::AllocateDevice(
+    vk::DeviceSize size,
+    vk::DeviceSize alignment) {
+  if (!IsValid() || size == 0u || alignment == 0u) {
+    return std::nullopt;
+  }
+  // Slices are only aligned to the device's requirements, so the alignment
+  // applies to the offset in the buffer rather than in the slice.
+  const auto frame_offset = device_frame_size_ * frame_index_;
+  const auto offset =
+      AlignUp(frame_offset + device_offset_,
+              std::max(alignment, min_alignment_)) -
+      frame_offset;
+  if (offset + size > device_frame_size_) {
+    FML_LOG(ERROR) << "Frame allocator is out of device memory.";
+    return std::nullopt;
+  }
+  device_offset_ = offset + size;
+
+  TransientAllocation allocation;
+  allocation.buffer = *buffer_;
+  allocation.offset = frame_offset + offset;
+  allocation.size = size;
+  allocation.data = mapping_ + frame_offset + offset;
+  return allocation;
+}
+
+vk::DeviceSize FrameAllocator::GetDeviceFrameSize() const {
+  return device_frame_size_;
+}
+
+vk::DeviceSize FrameAllocator::GetDeviceUsedSize() const {
+  return device_offset_;
+}
+
+}  // namespace one
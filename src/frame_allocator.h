@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "fml/macros.h"
+#include "host_arena.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+// A sub-range of the frame allocator's buffer. Bind the buffer once as a
+// dynamic uniform or storage buffer and pass the offset as the dynamic
+// offset, or use the offset directly for vertex, index and indirect data.
+struct TransientAllocation {
+  vk::Buffer buffer;
+  vk::DeviceSize offset = 0u;
+  vk::DeviceSize size = 0u;
+  void* data = nullptr;
+};
+
+// Linear allocators for data that only lives for a frame. Each frame in
+// flight gets a host arena and a slice of a single persistently mapped
+// buffer. Starting a frame recycles everything allocated the last time the
+// frame was used, so after the first few frames nothing is allocated on the
+// heap. All Vulkan objects are created up front.
+class FrameAllocator {
+ public:
+  FrameAllocator(const std::shared_ptr<Context>& context,
+                 size_t frame_count,
+                 size_t host_block_size,
+                 vk::DeviceSize device_frame_size);
+
+  ~FrameAllocator();
+
+  bool IsValid() const;
+
+  size_t GetFrameCount() const;
+
+  // The GPU must be done with the submissions of the last frame that used
+  // the same index.
+  void BeginFrame(size_t frame_index);
+
+  // Makes writes to the device allocations of the frame visible to the GPU.
+  // Call before submitting work that uses them.
+  bool EndFrame();
+
+  HostArena& GetHostArena();
+
+  // Offsets are aligned to the requested alignment as well as the alignment
+  // the device requires for dynamic uniform and storage buffer offsets.
+  // Returns nothing if the frame's slice of the buffer is exhausted.
+  std::optional<TransientAllocation> AllocateDevice(
+      vk::DeviceSize size,
+      vk::DeviceSize alignment = 1u);
+
+  vk::DeviceSize GetDeviceFrameSize() const;
+
+  vk::DeviceSize GetDeviceUsedSize() const;
+
+ private:
+  std::weak_ptr<Context> context_;
+  std::vector<std::unique_ptr<HostArena>> host_arenas_;
+  vk::UniqueBuffer buffer_;
+  vk::UniqueDeviceMemory memory_;
+  uint8_t* mapping_ = nullptr;
+  bool is_coherent_ = false;
+  vk::DeviceSize device_frame_size_ = 0u;
+  vk::DeviceSize min_alignment_ = 1u;
+  vk::DeviceSize non_coherent_atom_size_ = 1u;
+  size_t frame_index_ = 0u;
+  vk::DeviceSize device_offset_ = 0u;
+  bool is_valid_ = false;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(FrameAllocator);
+};
+
+}  // namespace one
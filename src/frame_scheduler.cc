@@ -0,0 +1,152 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+#include "context.h"
+#include "fml/logging.h"
+#include "fml/synchronization/count_down_latch.h"
+
+namespace one {
+
+FrameScheduler::FrameScheduler(const std::shared_ptr<Context>& context)
+    : context_(context) {}
+
+FrameScheduler::~FrameScheduler() = default;
+
+void FrameScheduler::AddTarget(RenderTarget* target) {
+  if (!target || !target->IsValid()) {
+    return;
+  }
+  if (std::find(targets_.begin(), targets_.end(), target) != targets_.end()) {
+    return;
+  }
+  targets_.push_back(target);
+}
+
+void FrameScheduler::RemoveTarget(RenderTarget* target) {
+  targets_.erase(std::remove(targets_.begin(), targets_.end(), target),
+                 targets_.end());
+}
+
+size_t FrameScheduler::GetTargetCount() const {
+  return targets_.size();
+}
+
+const std::vector<vk::Result>& FrameScheduler::RenderFrame() {
+  results_.assign(targets_.size(), vk::Result::eNotReady);
+  auto context = context_.lock();
+  if (!context || targets_.empty()) {
+    return results_;
+  }
+
+  frames_.resize(targets_.size());
+  for (size_t i = 0; i < targets_.size(); i++) {
+    frames_[i] = targets_[i]->AcquireFrame();
+  }
+
+  // Targets have their own command pools and graphs so they can record in
+  // parallel. The last one is recorded on this thread.
+  recorded_.assign(targets_.size(), 0u);
+  {
+    fml::CountDownLatch latch(targets_.size() - 1u);
+    for (size_t i = 0; i + 1u < targets_.size(); i++) {
+      context->GetConcurrentTaskRunner()->PostTask([this, i, &latch]() {
+        RecordFrame(i);
+        latch.CountDown();
+      });
+    }
+    RecordFrame(targets_.size() - 1u);
+    latch.Wait();
+  }
+
+  command_buffers_.clear();
+  render_semaphores_.clear();
+  for (const auto& frame : frames_) {
+    if (!frame.has_value()) {
+      continue;
+    }
+    command_buffers_.push_back(frame->command_buffer);
+    if (frame->render_semaphore) {
+      render_semaphores_.push_back(frame->render_semaphore);
+    }
+  }
+  if (command_buffers_.empty()) {
+    return results_;
+  }
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffers_);
+  submit_info.setSignalSemaphores(render_semaphores_);
+  const auto timeline_value = context->Submit(submit_info);
+  if (!timeline_value.has_value()) {
+    FML_LOG(ERROR) << "Could not submit the frame.";
+    for (size_t i = 0; i < targets_.size(); i++) {
+      if (frames_[i].has_value()) {
+        targets_[i]->FrameDiscarded();
+      }
+    }
+    return results_;
+  }
+
+  swapchains_.clear();
+  image_indices_.clear();
+  present_ids_.clear();
+  presenting_targets_.clear();
+  for (size_t i = 0; i < targets_.size(); i++) {
+    const auto& frame = frames_[i];
+    if (!frame.has_value()) {
+      continue;
+    }
+    targets_[i]->FrameSubmitted(timeline_value.value());
+    if (recorded_[i]) {
+      results_[i] = vk::Result::eSuccess;
+    }
+    if (frame->swapchain) {
+      swapchains_.push_back(frame->swapchain);
+      image_indices_.push_back(frame->image_index);
+      present_ids_.push_back(frame->present_id);
+      presenting_targets_.push_back(i);
+    }
+  }
+  if (swapchains_.empty()) {
+    return results_;
+  }
+
+  present_results_.assign(swapchains_.size(), vk::Result::eSuccess);
+  vk::PresentInfoKHR present_info;
+  present_info.setWaitSemaphores(render_semaphores_);
+  present_info.setSwapchains(swapchains_);
+  present_info.setImageIndices(image_indices_);
+  present_info.pResults = present_results_.data();
+  vk::PresentIdKHR present_id;
+  if (std::any_of(present_ids_.begin(), present_ids_.end(),
+                  [](uint64_t id) { return id != 0u; })) {
+    present_id.setPresentIds(present_ids_);
+    present_info.pNext = &present_id;
+  }
+  // Failures are reported per swapchain.
+  context->Present(present_info);
+  for (size_t i = 0; i < presenting_targets_.size(); i++) {
+    const auto target = presenting_targets_[i];
+    if (recorded_[target]) {
+      results_[target] = present_results_[i];
+    }
+  }
+  return results_;
+}
+
+void FrameScheduler::RecordFrame(size_t index) {
+  if (!frames_[index].has_value()) {
+    return;
+  }
+  if (targets_[index]->RecordFrame()) {
+    recorded_[index] = 1u;
+    return;
+  }
+  // Acquired swapchain images must still be presented to be given back.
+  if (!targets_[index]->RecordReleaseFrame()) {
+    frames_[index].reset();
+  }
+}
+
+}  // namespace one
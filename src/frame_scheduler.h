@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "fml/macros.h"
+#include "render_target.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+// Renders a frame into many targets at once. Images are acquired from every
+// target, the frames are recorded in parallel on the concurrent task runner,
+// submitted together and all swapchains are presented with a single
+// vkQueuePresentKHR. Adding displays then adds recording work but not queue
+// round trips.
+class FrameScheduler {
+ public:
+  explicit FrameScheduler(const std::shared_ptr<Context>& context);
+
+  ~FrameScheduler();
+
+  // The target must be removed before it is destroyed.
+  void AddTarget(RenderTarget* target);
+
+  void RemoveTarget(RenderTarget* target);
+
+  size_t GetTargetCount() const;
+
+  // Returns the result of each target in the order they were added. Targets
+  // that present get the result of their present, others eSuccess once
+  // submitted. Targets whose frame could not be acquired or recorded get
+  // eNotReady. Swapchain images acquired for frames that failed to record
+  // are still presented, unchanged, so they aren't lost.
+  const std::vector<vk::Result>& RenderFrame();
+
+ private:
+  std::weak_ptr<Context> context_;
+  std::vector<RenderTarget*> targets_;
+  // Reused across frames.
+  std::vector<std::optional<RenderTarget::Frame>> frames_;
+  // Not a vector<bool> as targets record concurrently.
+  std::vector<uint8_t> recorded_;
+  std::vector<vk::Result> results_;
+  std::vector<vk::CommandBuffer> command_buffers_;
+  std::vector<vk::Semaphore> render_semaphores_;
+  std::vector<vk::SwapchainKHR> swapchains_;
+  std::vector<uint32_t> image_indices_;
+  std::vector<uint64_t> present_ids_;
+  std::vector<vk::Result> present_results_;
+  std::vector<size_t> presenting_targets_;
+
+  void RecordFrame(size_t index);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(FrameScheduler);
+};
+
+}  // namespace one
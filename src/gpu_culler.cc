@@ -0,0 +1,266 @@
+#include "gpu_culler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "context.h"
+#include "fml/logging.h"
+#include "glm/glm/geometric.hpp"
+
+namespace one {
+
+static constexpr uint32_t kWorkgroupSize = 64u;
+
+// Matches PushConstants in gpu_culling.comp.
+struct CullPushConstants {
+  glm::vec4 planes[6];
+  uint32_t instance_count = 0u;
+};
+
+static_assert(sizeof(CullInstance) == 32u);
+static_assert(sizeof(CullPushConstants) == 100u);
+
+std::unique_ptr<GPUCuller> GPUCuller::Make(
+    const std::shared_ptr<Context>& context,
+    uint32_t capacity) {
+  auto culler = std::unique_ptr<GPUCuller>(new GPUCuller(context, capacity));
+  if (!culler->IsValid()) {
+    return nullptr;
+  }
+  return culler;
+}
+
+CullFrustum GPUCuller::FrustumFromViewProjection(const glm::mat4& matrix) {
+  const auto row = [&](int index) {
+    return glm::vec4{matrix[0][index], matrix[1][index], matrix[2][index],
+                     matrix[3][index]};
+  };
+  CullFrustum frustum = {
+      row(3) + row(0),  // Left
+      row(3) - row(0),  // Right
+      row(3) + row(1),  // Top
+      row(3) - row(1),  // Bottom
+      row(2),           // Near
+      row(3) - row(2),  // Far
+  };
+  for (auto& plane : frustum) {
+    plane /= glm::length(glm::vec3{plane});
+  }
+  return frustum;
+}
+
+GPUCuller::GPUCuller(const std::shared_ptr<Context>& context,
+                     uint32_t capacity)
+    : context_(context), capacity_(capacity) {
+  if (!context || !context->SupportsIndirectDrawCount()) {
+    FML_LOG(ERROR) << "Device doesn't support indirect draw counts.";
+    return;
+  }
+  if (capacity_ == 0u ||
+      capacity_ > context->GetPhysicalDevice()
+                      .getProperties()
+                      .limits.maxDrawIndirectCount) {
+    FML_LOG(ERROR) << "Invalid culler capacity " << capacity_;
+    return;
+  }
+
+  if (!CreateBuffer(*context, instances_, sizeof(CullInstance) * capacity_,
+                    vk::BufferUsageFlagBits::eStorageBuffer, true) ||
+      !CreateBuffer(*context, draws_,
+                    sizeof(vk::DrawIndexedIndirectCommand) * capacity_,
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eIndirectBuffer,
+                    false) ||
+      !CreateBuffer(*context, draw_count_, sizeof(uint32_t),
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eIndirectBuffer |
+                        vk::BufferUsageFlagBits::eTransferDst,
+                    true)) {
+    FML_LOG(ERROR) << "Could not allocate culling buffers.";
+    return;
+  }
+
+  const auto& device = context->GetDevice();
+
+  {
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+      bindings[i].binding = i;
+      bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+      bindings[i].descriptorCount = 1u;
+      bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+    vk::DescriptorSetLayoutCreateInfo layout_info;
+    layout_info.setBindings(bindings);
+    auto [result, layout] = device.createDescriptorSetLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_layout_ = std::move(layout);
+  }
+
+  {
+    vk::DescriptorPoolSize pool_size;
+    pool_size.type = vk::DescriptorType::eStorageBuffer;
+    pool_size.descriptorCount = 3u;
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.maxSets = 1u;
+    pool_info.setPoolSizes(pool_size);
+    auto [pool_result, pool] = device.createDescriptorPoolUnique(pool_info);
+    if (pool_result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_pool_ = std::move(pool);
+
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info.descriptorPool = *descriptor_pool_;
+    set_info.setSetLayouts(*descriptor_set_layout_);
+    auto [sets_result, sets] = device.allocateDescriptorSets(set_info);
+    if (sets_result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_ = sets.front();
+
+    const std::array<vk::DescriptorBufferInfo, 3> buffer_infos = {
+        vk::DescriptorBufferInfo{*instances_.buffer, 0u, VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{*draws_.buffer, 0u, VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{*draw_count_.buffer, 0u, VK_WHOLE_SIZE},
+    };
+    std::array<vk::WriteDescriptorSet, 3> writes;
+    for (uint32_t i = 0; i < writes.size(); i++) {
+      writes[i].dstSet = descriptor_set_;
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1u;
+      writes[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+      writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+
+  {
+    vk::PushConstantRange push_constants;
+    push_constants.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constants.size = sizeof(CullPushConstants);
+
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setSetLayouts(*descriptor_set_layout_);
+    layout_info.setPushConstantRanges(push_constants);
+    auto [result, layout] = device.createPipelineLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    pipeline_layout_ = std::move(layout);
+  }
+
+  pipeline_ = CreateComputePipeline(device, *pipeline_layout_,
+                                    "gpu_culling.comp.spv");
+  if (!pipeline_) {
+    return;
+  }
+
+  is_valid_ = true;
+}
+
+GPUCuller::~GPUCuller() = default;
+
+bool GPUCuller::IsValid() const {
+  return is_valid_;
+}
+
+uint32_t GPUCuller::GetCapacity() const {
+  return capacity_;
+}
+
+bool GPUCuller::SetInstances(const CullInstance* instances, uint32_t count) {
+  if (!IsValid() || count > capacity_ || (count > 0u && !instances)) {
+    return false;
+  }
+  if (count > 0u) {
+    std::memcpy(instances_.mapping, instances, sizeof(CullInstance) * count);
+  }
+  instance_count_ = count;
+  return true;
+}
+
+uint32_t GPUCuller::GetInstanceCount() const {
+  return instance_count_;
+}
+
+void GPUCuller::SetFrustum(const CullFrustum& frustum) {
+  frustum_ = frustum;
+}
+
+GPUCuller::GraphResources GPUCuller::AddPasses(RenderGraph& graph) {
+  GraphResources resources;
+  resources.draws = graph.ImportBuffer("cull_draws");
+  resources.draw_count = graph.ImportBuffer("cull_draw_count");
+
+  graph
+      .AddPass("cull_reset",
+               [this](const vk::CommandBuffer& command_buffer) {
+                 command_buffer.fillBuffer(*draw_count_.buffer, 0u,
+                                           sizeof(uint32_t), 0u);
+               })
+      .Overwrite(resources.draw_count, RenderGraphUsage::kTransferDst);
+  graph
+      .AddPass("cull",
+               [this](const vk::CommandBuffer& command_buffer) {
+                 if (instance_count_ == 0u) {
+                   return;
+                 }
+                 CullPushConstants push_constants;
+                 std::copy(frustum_.begin(), frustum_.end(),
+                           push_constants.planes);
+                 push_constants.instance_count = instance_count_;
+                 command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                             *pipeline_);
+                 command_buffer.bindDescriptorSets(
+                     vk::PipelineBindPoint::eCompute, *pipeline_layout_, 0u,
+                     descriptor_set_, {});
+                 command_buffer.pushConstants<CullPushConstants>(
+                     *pipeline_layout_, vk::ShaderStageFlagBits::eCompute,
+                     0u, push_constants);
+                 command_buffer.dispatch(
+                     (instance_count_ + kWorkgroupSize - 1u) / kWorkgroupSize,
+                     1u, 1u);
+
+                 // For GetVisibleCount.
+                 vk::MemoryBarrier2 barrier;
+                 barrier.srcStageMask =
+                     vk::PipelineStageFlagBits2::eComputeShader;
+                 barrier.srcAccessMask =
+                     vk::AccessFlagBits2::eShaderStorageWrite;
+                 barrier.dstStageMask = vk::PipelineStageFlagBits2::eHost;
+                 barrier.dstAccessMask = vk::AccessFlagBits2::eHostRead;
+                 vk::DependencyInfo dependency_info;
+                 dependency_info.setMemoryBarriers(barrier);
+                 command_buffer.pipelineBarrier2(dependency_info);
+               })
+      .Write(resources.draw_count, RenderGraphUsage::kStorage)
+      .Overwrite(resources.draws, RenderGraphUsage::kStorage);
+  return resources;
+}
+
+void GPUCuller::SetGraphResources(RenderGraph& graph,
+                                  const GraphResources& resources) const {
+  graph.SetImportedBuffer(resources.draws, *draws_.buffer);
+  graph.SetImportedBuffer(resources.draw_count, *draw_count_.buffer);
+}
+
+void GPUCuller::RecordDraws(const vk::CommandBuffer& command_buffer) const {
+  if (instance_count_ == 0u) {
+    return;
+  }
+  command_buffer.drawIndexedIndirectCount(
+      *draws_.buffer, 0u, *draw_count_.buffer, 0u, instance_count_,
+      sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+uint32_t GPUCuller::GetVisibleCount() const {
+  if (!IsValid()) {
+    return 0u;
+  }
+  return *static_cast<const uint32_t*>(draw_count_.mapping);
+}
+
+}  // namespace one
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include "fml/macros.h"
+#include "glm/glm/ext/matrix_float4x4.hpp"
+#include "glm/glm/ext/vector_float3.hpp"
+#include "glm/glm/ext/vector_float4.hpp"
+#include "render_graph.h"
+#include "vk.h"
+#include "vk_utils.h"
+
+namespace one {
+
+class Context;
+
+// An instance to cull and the mesh to draw it with. Matches Instance in
+// gpu_culling.comp.
+struct CullInstance {
+  // The bounding sphere.
+  glm::vec3 center = {};
+  float radius = 0.0f;
+  uint32_t index_count = 0u;
+  uint32_t first_index = 0u;
+  int32_t vertex_offset = 0;
+  uint32_t padding = 0u;
+};
+
+// Planes facing into the frustum with normalized normals.
+using CullFrustum = std::array<glm::vec4, 6>;
+
+// Culls instances on the GPU. The instances live in a GPU buffer and a
+// compute pass tests each against the frustum, appending an indexed draw for
+// every survivor. The draws are issued with a single
+// vkCmdDrawIndexedIndirectCount so the CPU cost of a frame does not depend on
+// the number of instances.
+//
+// Each draw sets firstInstance to the index of its instance so vertex shaders
+// can look it up with gl_InstanceIndex.
+//
+// The draws are overwritten every frame, so use a culler per frame in flight.
+class GPUCuller {
+ public:
+  struct GraphResources {
+    RenderGraphResource draws = 0u;
+    RenderGraphResource draw_count = 0u;
+  };
+
+  static std::unique_ptr<GPUCuller> Make(
+      const std::shared_ptr<Context>& context,
+      uint32_t capacity);
+
+  // The frustum of a view projection matrix with a [0, 1] depth range. For 2D
+  // views, pass an orthographic projection of the view rectangle.
+  static CullFrustum FrustumFromViewProjection(const glm::mat4& matrix);
+
+  ~GPUCuller();
+
+  bool IsValid() const;
+
+  uint32_t GetCapacity() const;
+
+  // Replaces all instances. The GPU must be done with earlier culls.
+  bool SetInstances(const CullInstance* instances, uint32_t count);
+
+  uint32_t GetInstanceCount() const;
+
+  void SetFrustum(const CullFrustum& frustum);
+
+  // Adds passes that cull into the draws buffer. Passes that draw must read
+  // both resources with RenderGraphUsage::kIndirectBuffer.
+  GraphResources AddPasses(RenderGraph& graph);
+
+  // Binds the culler's buffers once the graph has been compiled.
+  void SetGraphResources(RenderGraph& graph,
+                         const GraphResources& resources) const;
+
+  // Draws the survivors of the last cull. The pipeline and the index and
+  // vertex buffers must already be bound.
+  void RecordDraws(const vk::CommandBuffer& command_buffer) const;
+
+  // The number of survivors of the last cull. Only valid once the GPU is done
+  // with it.
+  uint32_t GetVisibleCount() const;
+
+ private:
+  std::weak_ptr<Context> context_;
+  uint32_t capacity_ = 0u;
+  uint32_t instance_count_ = 0u;
+  CullFrustum frustum_ = {};
+  BufferVK instances_;
+  BufferVK draws_;
+  BufferVK draw_count_;
+  vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+  vk::UniqueDescriptorPool descriptor_pool_;
+  vk::DescriptorSet descriptor_set_;
+  vk::UniquePipelineLayout pipeline_layout_;
+  vk::UniquePipeline pipeline_;
+  bool is_valid_ = false;
+
+  GPUCuller(const std::shared_ptr<Context>& context, uint32_t capacity);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(GPUCuller);
+};
+
+}  // namespace one
@@ -0,0 +1,423 @@
+#include "gpu_jpeg_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "context.h"
+#include "fml/logging.h"
+#include "fml/make_copyable.h"
+#include "jpeg_parser.h"
+#include "render_graph.h"
+#include "vk_utils.h"
+
+namespace one {
+
+static constexpr vk::Format kDecodedFormat = vk::Format::eR8G8B8A8Unorm;
+static constexpr uint32_t kWorkgroupSize = 8u;
+static constexpr size_t kMaxComponents = 3u;
+static constexpr size_t kQuantTableCount = 4u;
+
+// Matches the layout of JPEGHeader in gpu_jpeg_decoder.glsl.
+struct ComponentHeader {
+  uint32_t blocks_x = 0u;
+  uint32_t blocks_y = 0u;
+  uint32_t width = 0u;
+  uint32_t height = 0u;
+  uint32_t h_sampling = 1u;
+  uint32_t v_sampling = 1u;
+  uint32_t quant_table = 0u;
+  uint32_t coefficient_offset = 0u;
+  uint32_t plane_offset = 0u;
+};
+
+struct Header {
+  uint32_t width = 0u;
+  uint32_t height = 0u;
+  uint32_t component_count = 0u;
+  uint32_t max_h_sampling = 1u;
+  uint32_t max_v_sampling = 1u;
+  ComponentHeader components[kMaxComponents];
+  uint32_t quant_tables[kQuantTableCount * JPEGParser::kBlockSize];
+};
+
+static_assert(sizeof(Header) ==
+              sizeof(uint32_t) * (5u + 9u * kMaxComponents +
+                                  kQuantTableCount * JPEGParser::kBlockSize));
+
+// Everything a decode needs till the GPU is done with it.
+struct DecodeResources {
+  BufferVK upload;
+  BufferVK planes;
+  vk::UniqueDescriptorPool descriptor_pool;
+  vk::UniqueCommandPool command_pool;
+  vk::UniqueCommandBuffer command_buffer;
+};
+
+static vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+  return (value + alignment - 1u) / alignment * alignment;
+}
+
+std::shared_ptr<GPUJPEGDecoder> GPUJPEGDecoder::Make(
+    const std::shared_ptr<Context>& context) {
+  auto decoder =
+      std::shared_ptr<GPUJPEGDecoder>(new GPUJPEGDecoder(context));
+  if (!decoder->IsValid()) {
+    return nullptr;
+  }
+  return decoder;
+}
+
+GPUJPEGDecoder::GPUJPEGDecoder(const std::shared_ptr<Context>& context)
+    : context_(context) {
+  if (!context) {
+    return;
+  }
+
+  const auto format_properties =
+      context->GetPhysicalDevice().getFormatProperties(kDecodedFormat);
+  if (!(format_properties.optimalTilingFeatures &
+        vk::FormatFeatureFlagBits::eStorageImage)) {
+    FML_LOG(ERROR) << "Device can't write decoded images from shaders.";
+    return;
+  }
+
+  const auto& device = context->GetDevice();
+
+  {
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+      bindings[i].binding = i;
+      bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+      bindings[i].descriptorCount = 1u;
+      bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+    bindings.back().descriptorType = vk::DescriptorType::eStorageImage;
+
+    vk::DescriptorSetLayoutCreateInfo layout_info;
+    layout_info.setBindings(bindings);
+    auto [result, layout] = device.createDescriptorSetLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_layout_ = std::move(layout);
+  }
+
+  {
+    vk::PushConstantRange push_constants;
+    push_constants.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constants.size = sizeof(uint32_t);
+
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setSetLayouts(*descriptor_set_layout_);
+    layout_info.setPushConstantRanges(push_constants);
+    auto [result, layout] = device.createPipelineLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    pipeline_layout_ = std::move(layout);
+  }
+
+  idct_pipeline_ =
+      CreateComputePipeline(device, *pipeline_layout_, "jpeg_idct.comp.spv");
+  color_pipeline_ =
+      CreateComputePipeline(device, *pipeline_layout_, "jpeg_color.comp.spv");
+  if (!idct_pipeline_ || !color_pipeline_) {
+    return;
+  }
+
+  is_valid_ = true;
+}
+
+GPUJPEGDecoder::~GPUJPEGDecoder() = default;
+
+bool GPUJPEGDecoder::IsValid() const {
+  return is_valid_;
+}
+
+std::optional<EntropyDecodedJPEG> GPUJPEGDecoder::EntropyDecode(
+    const fml::Mapping& jpeg) {
+  JPEGParser parser(jpeg);
+  if (!parser.IsValid()) {
+    FML_LOG(ERROR) << "Not a baseline JPEG.";
+    return std::nullopt;
+  }
+
+  EntropyDecodedJPEG decoded;
+  decoded.size = parser.GetSize();
+  decoded.components = parser.GetComponents();
+  decoded.max_h_sampling = parser.GetMaxHSampling();
+  decoded.max_v_sampling = parser.GetMaxVSampling();
+  for (size_t table = 0; table < kQuantTableCount; table++) {
+    decoded.quant_tables[table] = parser.GetQuantTable(table);
+  }
+  decoded.coefficients.resize(parser.GetCoefficientCount());
+  if (!parser.DecodeCoefficients(decoded.coefficients.data())) {
+    return std::nullopt;
+  }
+  return decoded;
+}
+
+std::optional<DecodedImageVK> GPUJPEGDecoder::Decode(
+    const fml::Mapping& jpeg) {
+  auto decoded = EntropyDecode(jpeg);
+  if (!decoded.has_value()) {
+    return std::nullopt;
+  }
+  return Decode(decoded.value());
+}
+
+std::optional<DecodedImageVK> GPUJPEGDecoder::Decode(
+    const EntropyDecodedJPEG& jpeg) {
+  auto context = context_.lock();
+  if (!context || !IsValid()) {
+    return std::nullopt;
+  }
+
+  const auto& device = context->GetDevice();
+  const auto& components = jpeg.components;
+  const auto size = jpeg.size;
+  if (components.size() > kMaxComponents) {
+    return std::nullopt;
+  }
+
+  Header header;
+  header.width = size.x;
+  header.height = size.y;
+  header.component_count = static_cast<uint32_t>(components.size());
+  header.max_h_sampling = jpeg.max_h_sampling;
+  header.max_v_sampling = jpeg.max_v_sampling;
+  vk::DeviceSize plane_words = 0u;
+  for (size_t i = 0; i < components.size(); i++) {
+    const auto& component = components[i];
+    auto& component_header = header.components[i];
+    component_header.blocks_x = component.blocks_x;
+    component_header.blocks_y = component.blocks_y;
+    component_header.width = component.width;
+    component_header.height = component.height;
+    component_header.h_sampling = component.h_sampling;
+    component_header.v_sampling = component.v_sampling;
+    component_header.quant_table = component.quant_table;
+    component_header.coefficient_offset =
+        static_cast<uint32_t>(component.coefficient_offset);
+    component_header.plane_offset = static_cast<uint32_t>(plane_words);
+    plane_words += static_cast<vk::DeviceSize>(component.blocks_x) *
+                   component.blocks_y * JPEGParser::kBlockSize / 4u;
+  }
+  for (size_t table = 0; table < kQuantTableCount; table++) {
+    const auto& values = jpeg.quant_tables[table];
+    std::copy(values.begin(), values.end(),
+              header.quant_tables + table * JPEGParser::kBlockSize);
+  }
+
+  auto resources = std::make_unique<DecodeResources>();
+
+  // The header and coefficients share a host visible buffer.
+  const auto coefficients_offset = AlignUp(
+      sizeof(Header),
+      context->GetPhysicalDevice().getProperties().limits
+          .minStorageBufferOffsetAlignment);
+  const auto coefficients_size = jpeg.coefficients.size() * sizeof(int16_t);
+  if (!CreateBuffer(*context, resources->upload,
+                    coefficients_offset + coefficients_size,
+                    vk::BufferUsageFlagBits::eStorageBuffer, true) ||
+      !CreateBuffer(*context, resources->planes, plane_words * 4u,
+                    vk::BufferUsageFlagBits::eStorageBuffer, false)) {
+    return std::nullopt;
+  }
+  auto* bytes = static_cast<uint8_t*>(resources->upload.mapping);
+  std::memcpy(bytes, &header, sizeof(header));
+  std::memcpy(bytes + coefficients_offset, jpeg.coefficients.data(),
+              coefficients_size);
+
+  DecodedImageVK decoded;
+  decoded.size = size;
+  {
+    ImageVK image;
+    if (!CreateImage(*context, image, kDecodedFormat,
+                     vk::Extent2D{static_cast<uint32_t>(size.x),
+                                  static_cast<uint32_t>(size.y)},
+                     vk::ImageUsageFlagBits::eStorage |
+                         vk::ImageUsageFlagBits::eSampled |
+                         vk::ImageUsageFlagBits::eTransferSrc)) {
+      return std::nullopt;
+    }
+    decoded.image = std::move(image.image);
+    decoded.memory = std::move(image.memory);
+    decoded.image_view = std::move(image.view);
+  }
+
+  vk::DescriptorSet descriptor_set;
+  {
+    const std::array<vk::DescriptorPoolSize, 2> pool_sizes = {
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 3u},
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageImage, 1u},
+    };
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.maxSets = 1u;
+    pool_info.setPoolSizes(pool_sizes);
+    auto [pool_result, pool] = device.createDescriptorPoolUnique(pool_info);
+    if (pool_result != vk::Result::eSuccess) {
+      return std::nullopt;
+    }
+    resources->descriptor_pool = std::move(pool);
+
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info.descriptorPool = *resources->descriptor_pool;
+    set_info.setSetLayouts(*descriptor_set_layout_);
+    auto [sets_result, sets] = device.allocateDescriptorSets(set_info);
+    if (sets_result != vk::Result::eSuccess) {
+      return std::nullopt;
+    }
+    descriptor_set = sets.front();
+
+    const std::array<vk::DescriptorBufferInfo, 3> buffer_infos = {
+        vk::DescriptorBufferInfo{*resources->upload.buffer, 0u,
+                                 sizeof(Header)},
+        vk::DescriptorBufferInfo{*resources->upload.buffer,
+                                 coefficients_offset, coefficients_size},
+        vk::DescriptorBufferInfo{*resources->planes.buffer, 0u,
+                                 VK_WHOLE_SIZE},
+    };
+    vk::DescriptorImageInfo image_info;
+    image_info.imageView = *decoded.image_view;
+    image_info.imageLayout = vk::ImageLayout::eGeneral;
+
+    std::array<vk::WriteDescriptorSet, 4> writes;
+    for (uint32_t i = 0; i < writes.size(); i++) {
+      writes[i].dstSet = descriptor_set;
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1u;
+      if (i < buffer_infos.size()) {
+        writes[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        writes[i].pBufferInfo = &buffer_infos[i];
+      } else {
+        writes[i].descriptorType = vk::DescriptorType::eStorageImage;
+        writes[i].pImageInfo = &image_info;
+      }
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+
+  {
+    // Decodes may happen on any thread so each gets its own pool.
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    pool_info.queueFamilyIndex = context->GetQueueIndex().family;
+    auto [pool_result, pool] = device.createCommandPoolUnique(pool_info);
+    if (pool_result != vk::Result::eSuccess) {
+      return std::nullopt;
+    }
+    resources->command_pool = std::move(pool);
+
+    vk::CommandBufferAllocateInfo command_buffer_info;
+    command_buffer_info.commandPool = *resources->command_pool;
+    command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+    command_buffer_info.commandBufferCount = 1u;
+    auto [command_buffers_result, command_buffers] =
+        device.allocateCommandBuffersUnique(command_buffer_info);
+    if (command_buffers_result != vk::Result::eSuccess) {
+      return std::nullopt;
+    }
+    resources->command_buffer = std::move(command_buffers.front());
+  }
+
+  RenderGraph graph(context);
+  const auto planes = graph.ImportBuffer("planes");
+  const auto image = graph.ImportImage(
+      "image",
+      RenderGraphImageDesc{kDecodedFormat,
+                           vk::Extent2D{header.width, header.height}},
+      vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
+  graph
+      .AddPass("idct",
+               [&](const vk::CommandBuffer& command_buffer) {
+                 command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                             *idct_pipeline_);
+                 command_buffer.bindDescriptorSets(
+                     vk::PipelineBindPoint::eCompute, *pipeline_layout_, 0u,
+                     descriptor_set, {});
+                 for (uint32_t i = 0; i < components.size(); i++) {
+                   command_buffer.pushConstants<uint32_t>(
+                       *pipeline_layout_, vk::ShaderStageFlagBits::eCompute,
+                       0u, i);
+                   command_buffer.dispatch(components[i].blocks_x,
+                                           components[i].blocks_y, 1u);
+                 }
+               })
+      .Overwrite(planes, RenderGraphUsage::kStorage);
+  graph
+      .AddPass("color",
+               [&](const vk::CommandBuffer& command_buffer) {
+                 command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                             *color_pipeline_);
+                 command_buffer.bindDescriptorSets(
+                     vk::PipelineBindPoint::eCompute, *pipeline_layout_, 0u,
+                     descriptor_set, {});
+                 command_buffer.dispatch(
+                     (header.width + kWorkgroupSize - 1u) / kWorkgroupSize,
+                     (header.height + kWorkgroupSize - 1u) / kWorkgroupSize,
+                     1u);
+               })
+      .Read(planes, RenderGraphUsage::kStorage)
+      .Overwrite(image, RenderGraphUsage::kStorage);
+  if (!graph.Compile()) {
+    return std::nullopt;
+  }
+  graph.SetImportedBuffer(planes, *resources->planes.buffer);
+  graph.SetImportedImage(image, *decoded.image, *decoded.image_view);
+
+  const auto& command_buffer = *resources->command_buffer;
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  if (command_buffer.begin(begin_info) != vk::Result::eSuccess) {
+    return std::nullopt;
+  }
+  if (!graph.Execute(command_buffer)) {
+    return std::nullopt;
+  }
+  if (command_buffer.end() != vk::Result::eSuccess) {
+    return std::nullopt;
+  }
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  const auto timeline_value = context->Submit(submit_info);
+  if (!timeline_value.has_value()) {
+    return std::nullopt;
+  }
+  decoded.timeline_value = timeline_value.value();
+  context->GetDeletionQueue().Enqueue(std::move(resources),
+                                      timeline_value.value());
+  return decoded;
+}
+
+void GPUJPEGDecoder::DecodeAsync(
+    std::shared_ptr<fml::Mapping> jpeg,
+    fml::RefPtr<fml::TaskRunner> submit_task_runner,
+    Callback callback) {
+  auto context = context_.lock();
+  if (!context || !jpeg || !submit_task_runner || !callback) {
+    return;
+  }
+  // The worker only holds the decoder weakly and never touches the context,
+  // so the last reference to either is never released there.
+  context->GetConcurrentTaskRunner()->PostTask(fml::MakeCopyable(
+      [weak = weak_from_this(), jpeg = std::move(jpeg),
+       submit_task_runner = std::move(submit_task_runner),
+       callback = std::move(callback)]() mutable {
+        auto decoded = EntropyDecode(*jpeg);
+        submit_task_runner->PostTask(fml::MakeCopyable(
+            [weak = std::move(weak), decoded = std::move(decoded),
+             callback = std::move(callback)]() {
+              auto decoder = weak.lock();
+              if (!decoder || !decoded.has_value()) {
+                callback(std::nullopt);
+                return;
+              }
+              callback(decoder->Decode(decoded.value()));
+            }));
+      }));
+}
+
+}  // namespace one
@@ -0,0 +1,43 @@
+// Resources shared by the GPU JPEG decoder stages. Must match the layout in
+// gpu_jpeg_decoder.cc.
+
+struct JPEGComponent {
+  uint blocks_x;
+  uint blocks_y;
+  uint width;
+  uint height;
+  uint h_sampling;
+  uint v_sampling;
+  uint quant_table;
+  // In coefficients.
+  uint coefficient_offset;
+  // In words of four samples.
+  uint plane_offset;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer JPEGHeader {
+  uint width;
+  uint height;
+  uint component_count;
+  uint max_h_sampling;
+  uint max_v_sampling;
+  JPEGComponent components[3];
+  // Four tables in natural order.
+  uint quant_tables[256];
+}
+header;
+
+// Two signed 16-bit coefficients per word, the first in the low half.
+layout(std430, set = 0, binding = 1) readonly buffer JPEGCoefficients {
+  uint coefficients[];
+};
+
+// Component samples after the inverse DCT. Each component plane is its blocks
+// laid out row major, four 8-bit samples per word.
+layout(std430, set = 0, binding = 2) buffer JPEGPlanes {
+  uint planes[];
+};
+
+uint GetPlaneStride(JPEGComponent component) {
+  return component.blocks_x * 8u;
+}
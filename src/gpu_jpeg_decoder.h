@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "fml/macros.h"
+#include "fml/mapping.h"
+#include "fml/task_runner.h"
+#include "glm/glm/ext/vector_int2.hpp"
+#include "jpeg_parser.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+// An RGBA8 image in the shader read only layout. It may not be used till the
+// GPU reaches the timeline value.
+struct DecodedImageVK {
+  vk::UniqueImage image;
+  vk::UniqueDeviceMemory memory;
+  vk::UniqueImageView image_view;
+  glm::ivec2 size;
+  uint64_t timeline_value = 0u;
+};
+
+// The CPU half of a decode, the quantized coefficients of every block.
+struct EntropyDecodedJPEG {
+  glm::ivec2 size;
+  std::vector<JPEGComponent> components;
+  uint32_t max_h_sampling = 1u;
+  uint32_t max_v_sampling = 1u;
+  std::array<std::array<uint16_t, JPEGParser::kBlockSize>, 4> quant_tables;
+  std::vector<int16_t> coefficients;
+};
+
+// Decodes baseline JPEGs with the work split between the CPU and GPU. The
+// Huffman coded data is decoded on the CPU and uploaded to a host visible
+// buffer. Compute shaders then dequantize the coefficients, run the inverse
+// DCT, upsample chroma and convert to RGB, writing into the destination image.
+//
+// Images the parser doesn't support (progressive ones for instance) must be
+// decoded with ImageDecoder instead.
+class GPUJPEGDecoder final
+    : public std::enable_shared_from_this<GPUJPEGDecoder> {
+ public:
+  using Callback = std::function<void(std::optional<DecodedImageVK> image)>;
+
+  static std::shared_ptr<GPUJPEGDecoder> Make(
+      const std::shared_ptr<Context>& context);
+
+  ~GPUJPEGDecoder();
+
+  bool IsValid() const;
+
+  // Doesn't use the context, so it may run on any thread.
+  static std::optional<EntropyDecodedJPEG> EntropyDecode(
+      const fml::Mapping& jpeg);
+
+  // Uploads the coefficients and submits the rest to the GPU. This holds the
+  // context while it runs, so it must not run on one of the context's own
+  // threads. Releasing the last reference there would join the thread from
+  // itself.
+  std::optional<DecodedImageVK> Decode(const EntropyDecodedJPEG& jpeg);
+
+  // Both halves on the calling thread.
+  std::optional<DecodedImageVK> Decode(const fml::Mapping& jpeg);
+
+  // Entropy decodes on a concurrent worker, then submits and invokes the
+  // callback on the submit task runner, which must not be one of the
+  // context's threads.
+  void DecodeAsync(std::shared_ptr<fml::Mapping> jpeg,
+                   fml::RefPtr<fml::TaskRunner> submit_task_runner,
+                   Callback callback);
+
+ private:
+  std::weak_ptr<Context> context_;
+  vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+  vk::UniquePipelineLayout pipeline_layout_;
+  vk::UniquePipeline idct_pipeline_;
+  vk::UniquePipeline color_pipeline_;
+  bool is_valid_ = false;
+
+  explicit GPUJPEGDecoder(const std::shared_ptr<Context>& context);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(GPUJPEGDecoder);
+};
+
+}  // namespace one
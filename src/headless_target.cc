@@ -0,0 +1,251 @@
+#include "headless_target.h"
+
+#include "context.h"
+#include "fml/logging.h"
+
+namespace one {
+
+static constexpr size_t kFrameHostBlockSize = 64u * 1024u;
+static constexpr vk::DeviceSize kFrameDeviceSize = 1024u * 1024u;
+
+HeadlessTarget::HeadlessTarget(const std::shared_ptr<Context>& context,
+                               vk::Extent2D extent,
+                               vk::Format format,
+                               size_t image_count)
+    : context_(context), extent_(extent), format_(format) {
+  if (!context || image_count == 0u || extent.width == 0u ||
+      extent.height == 0u) {
+    return;
+  }
+
+  const auto& device = context->GetDevice();
+
+  {
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    pool_info.queueFamilyIndex = context->GetQueueIndex().family;
+    auto [result, pool] = device.createCommandPoolUnique(pool_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    command_pool_ = std::move(pool);
+  }
+
+  slots_.resize(image_count);
+  for (auto& slot : slots_) {
+    vk::ImageCreateInfo image_info;
+    image_info.imageType = vk::ImageType::e2D;
+    image_info.format = format_;
+    image_info.extent = vk::Extent3D{extent_.width, extent_.height, 1u};
+    image_info.mipLevels = 1u;
+    image_info.arrayLayers = 1u;
+    image_info.samples = vk::SampleCountFlagBits::e1;
+    image_info.tiling = vk::ImageTiling::eOptimal;
+    image_info.usage = vk::ImageUsageFlagBits::eTransferDst |
+                       vk::ImageUsageFlagBits::eColorAttachment |
+                       vk::ImageUsageFlagBits::eTransferSrc;
+    image_info.initialLayout = vk::ImageLayout::eUndefined;
+    auto [image_result, image] = device.createImageUnique(image_info);
+    if (image_result != vk::Result::eSuccess) {
+      return;
+    }
+    slot.image = std::move(image);
+
+    const auto requirements = device.getImageMemoryRequirements(*slot.image);
+    const auto memory_type = context->FindMemoryTypeIndex(
+        requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if (!memory_type.has_value()) {
+      return;
+    }
+    vk::MemoryAllocateInfo allocate_info;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = memory_type.value();
+    auto [memory_result, memory] = device.allocateMemoryUnique(allocate_info);
+    if (memory_result != vk::Result::eSuccess) {
+      return;
+    }
+    slot.memory = std::move(memory);
+    if (device.bindImageMemory(*slot.image, *slot.memory, 0u) !=
+        vk::Result::eSuccess) {
+      return;
+    }
+
+    vk::CommandBufferAllocateInfo command_buffer_info;
+    command_buffer_info.commandPool = *command_pool_;
+    command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+    command_buffer_info.commandBufferCount = 1u;
+    auto [command_buffers_result, command_buffers] =
+        device.allocateCommandBuffersUnique(command_buffer_info);
+    if (command_buffers_result != vk::Result::eSuccess) {
+      return;
+    }
+    slot.command_buffer = std::move(command_buffers.front());
+  }
+
+  render_graph_ = std::make_unique<RenderGraph>(context);
+  target_image_ = render_graph_->ImportImage(
+      "target", RenderGraphImageDesc{format_, extent_},
+      vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferSrcOptimal);
+  render_graph_
+      ->AddPass("clear",
+                [this](const vk::CommandBuffer& command_buffer) {
+                  vk::ImageSubresourceRange range;
+                  range.aspectMask = vk::ImageAspectFlagBits::eColor;
+                  range.levelCount = 1u;
+                  range.layerCount = 1u;
+                  command_buffer.clearColorImage(
+                      render_graph_->GetImage(target_image_),
+                      vk::ImageLayout::eTransferDstOptimal,
+                      vk::ClearColorValue{}, range);
+                })
+      .Overwrite(target_image_, RenderGraphUsage::kTransferDst);
+  if (!render_graph_->Compile()) {
+    return;
+  }
+
+  frame_allocator_ = std::make_unique<FrameAllocator>(
+      context, slots_.size(), kFrameHostBlockSize, kFrameDeviceSize);
+  if (!frame_allocator_->IsValid()) {
+    return;
+  }
+
+  is_valid_ = true;
+}
+
+HeadlessTarget::~HeadlessTarget() {
+  if (auto context = context_.lock()) {
+    for (const auto& slot : slots_) {
+      context->WaitForTimelineValue(slot.last_timeline_value);
+    }
+  }
+}
+
+bool HeadlessTarget::IsValid() const {
+  return is_valid_;
+}
+
+vk::Extent2D HeadlessTarget::GetExtent() const {
+  return extent_;
+}
+
+FrameAllocator& HeadlessTarget::GetFrameAllocator() {
+  return *frame_allocator_;
+}
+
+bool HeadlessTarget::SetCaptureCallback(Readback::Callback callback) {
+  if (!callback) {
+    capture_callback_ = nullptr;
+    return true;
+  }
+  if (!Readback::IsSupportedFormat(format_)) {
+    FML_LOG(ERROR) << "Headless images cannot be captured.";
+    return false;
+  }
+  if (!readback_) {
+    auto context = context_.lock();
+    if (!context) {
+      return false;
+    }
+    readback_ = Readback::Make(context, slots_.size() + 1u,
+                               extent_.width * extent_.height * 4u);
+    if (!readback_) {
+      return false;
+    }
+  }
+  capture_callback_ = std::move(callback);
+  return true;
+}
+
+bool HeadlessTarget::FlushCaptures() {
+  return !readback_ || readback_->Flush();
+}
+
+std::optional<RenderTarget::Frame> HeadlessTarget::AcquireFrame() {
+  auto context = context_.lock();
+  if (!context || !IsValid()) {
+    return std::nullopt;
+  }
+
+  frame_count_++;
+  const auto slot_index = frame_count_ % slots_.size();
+  const auto& slot = slots_[slot_index];
+
+  // Without a presentation engine, the image is free once the GPU is done
+  // with the last frame rendered into it.
+  if (!context->WaitForTimelineValue(slot.last_timeline_value)) {
+    return std::nullopt;
+  }
+
+  frame_allocator_->BeginFrame(slot_index);
+
+  context->GetDeletionQueue().Collect(context->GetCompletedTimelineValue());
+
+  acquired_slot_ = slot_index;
+
+  Frame frame;
+  frame.command_buffer = *slot.command_buffer;
+  frame.image_index = static_cast<uint32_t>(slot_index);
+  return frame;
+}
+
+bool HeadlessTarget::RecordFrame() {
+  const auto& slot = slots_[acquired_slot_];
+  const auto& command_buffer = *slot.command_buffer;
+
+  if (command_buffer.reset() != vk::Result::eSuccess) {
+    return false;
+  }
+
+  {
+    vk::CommandBufferBeginInfo begin_info;
+    begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    if (command_buffer.begin(begin_info) != vk::Result::eSuccess) {
+      return false;
+    }
+  }
+
+  render_graph_->SetImportedImage(target_image_, *slot.image);
+  if (!render_graph_->Execute(command_buffer)) {
+    return false;
+  }
+
+  if (capture_callback_) {
+    readback_->Record(command_buffer, *slot.image,
+                      vk::ImageLayout::eTransferSrcOptimal, extent_, format_,
+                      capture_callback_);
+  }
+
+  if (command_buffer.end() != vk::Result::eSuccess ||
+      !frame_allocator_->EndFrame()) {
+    if (readback_) {
+      readback_->Discard();
+    }
+    return false;
+  }
+
+  return true;
+}
+
+bool HeadlessTarget::RecordReleaseFrame() {
+  // Nothing waits on headless images, so the frame is simply dropped.
+  if (readback_) {
+    readback_->Discard();
+  }
+  return false;
+}
+
+void HeadlessTarget::FrameSubmitted(uint64_t timeline_value) {
+  slots_[acquired_slot_].last_timeline_value = timeline_value;
+  if (readback_) {
+    readback_->Submitted(timeline_value);
+    readback_->Poll();
+  }
+}
+
+void HeadlessTarget::FrameDiscarded() {
+  if (readback_) {
+    readback_->Discard();
+  }
+}
+
+}  // namespace one
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "fml/macros.h"
+#include "frame_allocator.h"
+#include "readback.h"
+#include "render_graph.h"
+#include "render_target.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+// Renders into a ring of images instead of a surface. Frames are only seen
+// through the capture callback. Useful for offscreen displays and for tests
+// that have no window.
+class HeadlessTarget final : public RenderTarget {
+ public:
+  HeadlessTarget(const std::shared_ptr<Context>& context,
+                 vk::Extent2D extent,
+                 vk::Format format = vk::Format::eR8G8B8A8Unorm,
+                 size_t image_count = 2u);
+
+  ~HeadlessTarget() override;
+
+  // |RenderTarget|
+  bool IsValid() const override;
+
+  vk::Extent2D GetExtent() const;
+
+  // Captures every frame rendered while the callback is set.
+  bool SetCaptureCallback(Readback::Callback callback);
+
+  // Waits till all captured frames have been handed to the callback.
+  bool FlushCaptures();
+
+  // Transient allocations for the frame being rendered.
+  FrameAllocator& GetFrameAllocator();
+
+  // |RenderTarget|
+  std::optional<Frame> AcquireFrame() override;
+
+  // |RenderTarget|
+  bool RecordFrame() override;
+
+  // |RenderTarget|
+  bool RecordReleaseFrame() override;
+
+  // |RenderTarget|
+  void FrameSubmitted(uint64_t timeline_value) override;
+
+  // |RenderTarget|
+  void FrameDiscarded() override;
+
+ private:
+  struct FrameSlot {
+    vk::UniqueImage image;
+    vk::UniqueDeviceMemory memory;
+    vk::UniqueCommandBuffer command_buffer;
+    uint64_t last_timeline_value = 0u;
+  };
+
+  std::weak_ptr<Context> context_;
+  vk::Extent2D extent_;
+  vk::Format format_ = vk::Format::eUndefined;
+  vk::UniqueCommandPool command_pool_;
+  std::vector<FrameSlot> slots_;
+  std::unique_ptr<FrameAllocator> frame_allocator_;
+  std::unique_ptr<RenderGraph> render_graph_;
+  RenderGraphResource target_image_ = 0u;
+  std::shared_ptr<Readback> readback_;
+  Readback::Callback capture_callback_;
+  size_t frame_count_ = 0u;
+  size_t acquired_slot_ = 0u;
+  bool is_valid_ = false;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(HeadlessTarget);
+};
+
+}  // namespace one
@@ -0,0 +1,57 @@
+#include "host_arena.h"
+
+#include <algorithm>
+
+namespace one {
+
+static uintptr_t AlignUp(uintptr_t value, size_t alignment) {
+  return (value + alignment - 1u) & ~(static_cast<uintptr_t>(alignment) - 1u);
+}
+
+HostArena::HostArena(size_t block_size) : block_size_(block_size) {}
+
+HostArena::~HostArena() = default;
+
+void* HostArena::Allocate(size_t size, size_t alignment) {
+  if (size == 0u || alignment == 0u || (alignment & (alignment - 1u)) != 0u) {
+    return nullptr;
+  }
+
+  while (current_block_ < blocks_.size()) {
+    const auto& block = blocks_[current_block_];
+    const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+    const auto begin = AlignUp(base + offset_, alignment);
+    if (begin + size <= base + block.size) {
+      used_size_ += begin + size - (base + offset_);
+      offset_ = begin + size - base;
+      return reinterpret_cast<void*>(begin);
+    }
+    current_block_++;
+    offset_ = 0u;
+  }
+
+  Block block;
+  block.size = std::max(block_size_, size + alignment);
+  block.data = std::make_unique<uint8_t[]>(block.size);
+  block_allocation_count_++;
+  blocks_.emplace_back(std::move(block));
+  current_block_ = blocks_.size() - 1u;
+  offset_ = 0u;
+  return Allocate(size, alignment);
+}
+
+void HostArena::Reset() {
+  current_block_ = 0u;
+  offset_ = 0u;
+  used_size_ = 0u;
+}
+
+size_t HostArena::GetUsedSize() const {
+  return used_size_;
+}
+
+size_t HostArena::GetBlockAllocationCount() const {
+  return block_allocation_count_;
+}
+
+}  // namespace one
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "fml/macros.h"
+
+namespace one {
+
+// A bump allocator for data that lives no longer than a frame. Memory is
+// handed out from large blocks and reclaimed all at once when the arena is
+// reset. Blocks are kept around across resets so that frames with similar
+// allocation patterns don't touch the heap at all after the first.
+class HostArena {
+ public:
+  explicit HostArena(size_t block_size);
+
+  ~HostArena();
+
+  void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  // Objects allocated in the arena are never destructed.
+  template <class T>
+  T* Allocate(size_t count = 1u) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  void Reset();
+
+  size_t GetUsedSize() const;
+
+  // The number of times the arena had to go to the heap for more memory.
+  size_t GetBlockAllocationCount() const;
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0u;
+  };
+
+  const size_t block_size_;
+  std::vector<Block> blocks_;
+  size_t current_block_ = 0u;
+  size_t offset_ = 0u;
+  size_t used_size_ = 0u;
+  size_t block_allocation_count_ = 0u;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(HostArena);
+};
+
+}  // namespace one
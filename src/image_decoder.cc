@@ -1,13 +1,38 @@
 #include "image_decoder.h"
 #include <memory>
 #include "fml/mapping.h"
+#include "jpeg_parser.h"
+#include "parallel_jpeg_decoder.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 namespace one {
 
+// Smaller images decode quickly enough that splitting them up isn't worth it.
+static constexpr int64_t kMinConcurrentDecodePixels = 4 * 1024 * 1024;
+
 ImageDecoder::ImageDecoder(const fml::Mapping& source) {
+  DecodeSerially(source);
+}
+
+ImageDecoder::ImageDecoder(const fml::Mapping& source,
+                           fml::ConcurrentTaskRunner& task_runner) {
+  JPEGParser parser(source);
+  const auto size = parser.GetSize();
+  if (parser.IsValid() && static_cast<int64_t>(size.x) * size.y >=
+                              kMinConcurrentDecodePixels) {
+    if (auto decoded = DecodeJPEGConcurrently(parser, task_runner)) {
+      decoded_ = std::move(decoded);
+      size_ = size;
+      is_valid_ = true;
+      return;
+    }
+  }
+  DecodeSerially(source);
+}
+
+void ImageDecoder::DecodeSerially(const fml::Mapping& source) {
   int x = 0;
   int y = 0;
   int channels = 0;
@@ -40,4 +65,8 @@ glm::ivec2 ImageDecoder::GetSize() const {
   return size_;
 }
 
+const fml::Mapping* ImageDecoder::GetPixels() const {
+  return decoded_.get();
+}
+
 }  // namespace one
@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "fml/concurrent_message_loop.h"
 #include "fml/macros.h"
 #include "fml/mapping.h"
 #include "glm/glm/ext/vector_int2.hpp"
@@ -12,17 +13,28 @@ class ImageDecoder {
  public:
   ImageDecoder(const fml::Mapping& source);
 
+  // Large baseline JPEGs are split up and decoded on the task runner's
+  // workers. Everything else is decoded serially. Must not be called on one of
+  // the task runner's workers.
+  ImageDecoder(const fml::Mapping& source,
+               fml::ConcurrentTaskRunner& task_runner);
+
   ~ImageDecoder();
 
   bool IsValid() const;
 
   glm::ivec2 GetSize() const;
 
+  // Tightly packed RGBA8 pixels.
+  const fml::Mapping* GetPixels() const;
+
  private:
   std::unique_ptr<fml::Mapping> decoded_;
   glm::ivec2 size_;
   bool is_valid_ = false;
 
+  void DecodeSerially(const fml::Mapping& source);
+
   FML_DISALLOW_COPY_AND_ASSIGN(ImageDecoder);
 };
 
@@ -0,0 +1,84 @@
+#include "image_encoder.h"
+
+#include <vector>
+
+#include "fml/logging.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace one {
+
+static constexpr int kBytesPerPixel = 4;
+
+static bool IsValidPixels(const fml::Mapping& pixels, glm::ivec2 size) {
+  return size.x > 0 && size.y > 0 &&
+         pixels.GetSize() >=
+             static_cast<size_t>(size.x * size.y * kBytesPerPixel);
+}
+
+static void AppendToVector(void* context, void* data, int size) {
+  auto encoded = static_cast<std::vector<uint8_t>*>(context);
+  auto bytes = static_cast<const uint8_t*>(data);
+  encoded->insert(encoded->end(), bytes, bytes + size);
+}
+
+static std::unique_ptr<fml::Mapping> WrapVector(
+    std::unique_ptr<std::vector<uint8_t>> vector) {
+  auto encoded = vector.release();
+  return std::make_unique<fml::NonOwnedMapping>(
+      encoded->data(), encoded->size(),
+      [encoded](const uint8_t* data, size_t size) { delete encoded; });
+}
+
+std::unique_ptr<fml::Mapping> EncodePNG(const fml::Mapping& pixels,
+                                        glm::ivec2 size) {
+  if (!IsValidPixels(pixels, size)) {
+    FML_LOG(ERROR) << "Invalid pixels to encode.";
+    return nullptr;
+  }
+
+  auto png = std::make_unique<std::vector<uint8_t>>();
+  const auto result = ::stbi_write_png_to_func(
+      AppendToVector, png.get(), size.x, size.y, kBytesPerPixel,
+      pixels.GetMapping(), size.x * kBytesPerPixel);
+  if (result == 0) {
+    FML_LOG(ERROR) << "Could not encode PNG.";
+    return nullptr;
+  }
+  return WrapVector(std::move(png));
+}
+
+std::unique_ptr<fml::Mapping> EncodeJPEG(const fml::Mapping& pixels,
+                                         glm::ivec2 size,
+                                         int quality) {
+  if (!IsValidPixels(pixels, size)) {
+    FML_LOG(ERROR) << "Invalid pixels to encode.";
+    return nullptr;
+  }
+
+  auto jpeg = std::make_unique<std::vector<uint8_t>>();
+  const auto result =
+      ::stbi_write_jpg_to_func(AppendToVector, jpeg.get(), size.x, size.y,
+                               kBytesPerPixel, pixels.GetMapping(), quality);
+  if (result == 0) {
+    FML_LOG(ERROR) << "Could not encode JPEG.";
+    return nullptr;
+  }
+  return WrapVector(std::move(jpeg));
+}
+
+void EncodePNGAsync(
+    const std::shared_ptr<fml::ConcurrentTaskRunner>& task_runner,
+    std::shared_ptr<fml::Mapping> pixels,
+    glm::ivec2 size,
+    std::function<void(std::unique_ptr<fml::Mapping> png)> callback) {
+  if (!task_runner || !pixels || !callback) {
+    return;
+  }
+  task_runner->PostTask([pixels, size, callback]() {
+    callback(EncodePNG(*pixels, size));
+  });
+}
+
+}  // namespace one
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "fml/concurrent_message_loop.h"
+#include "fml/mapping.h"
+#include "glm/glm/ext/vector_int2.hpp"
+
+namespace one {
+
+// The pixels must be tightly packed RGBA8.
+std::unique_ptr<fml::Mapping> EncodePNG(const fml::Mapping& pixels,
+                                        glm::ivec2 size);
+
+// Encodes a baseline JPEG. The alpha channel is dropped. Quality is in
+// [1, 100].
+std::unique_ptr<fml::Mapping> EncodeJPEG(const fml::Mapping& pixels,
+                                         glm::ivec2 size,
+                                         int quality = 90);
+
+// Encodes on the task runner. The callback is invoked on the task runner with
+// nullptr if the pixels could not be encoded.
+void EncodePNGAsync(
+    const std::shared_ptr<fml::ConcurrentTaskRunner>& task_runner,
+    std::shared_ptr<fml::Mapping> pixels,
+    glm::ivec2 size,
+    std::function<void(std::unique_ptr<fml::Mapping> png)> callback);
+
+}  // namespace one
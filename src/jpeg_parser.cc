@@ -0,0 +1,515 @@
+#include "jpeg_parser.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "fml/logging.h"
+
+namespace one {
+
+// Maps the zig-zag order of coefficients in the stream to natural order.
+static constexpr std::array<uint8_t, JPEGParser::kBlockSize> kZigZag = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static constexpr uint8_t kMarkerSOI = 0xD8;
+static constexpr uint8_t kMarkerEOI = 0xD9;
+static constexpr uint8_t kMarkerSOF0 = 0xC0;
+static constexpr uint8_t kMarkerSOF1 = 0xC1;
+static constexpr uint8_t kMarkerDHT = 0xC4;
+static constexpr uint8_t kMarkerDQT = 0xDB;
+static constexpr uint8_t kMarkerDRI = 0xDD;
+static constexpr uint8_t kMarkerSOS = 0xDA;
+static constexpr uint8_t kMarkerRST0 = 0xD0;
+static constexpr uint8_t kMarkerRST7 = 0xD7;
+
+static uint16_t ReadU16(const uint8_t* data) {
+  return static_cast<uint16_t>((data[0] << 8u) | data[1]);
+}
+
+static bool IsRestartMarker(uint8_t marker) {
+  return marker >= kMarkerRST0 && marker <= kMarkerRST7;
+}
+
+static uint32_t DivideRoundingUp(uint32_t value, uint32_t divisor) {
+  return (value + divisor - 1u) / divisor;
+}
+
+// Reads the entropy coded data most significant bit first. Stuffed zero bytes
+// are skipped. Once a marker is reached, zeros are returned till the reader is
+// restarted past it.
+class JPEGParser::BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  void Fill() {
+    while (count_ <= 56u) {
+      uint8_t byte = 0u;
+      if (position_ < size_ && !at_marker_) {
+        byte = data_[position_];
+        if (byte == 0xFF) {
+          const uint8_t next =
+              position_ + 1u < size_ ? data_[position_ + 1u] : 0xFF;
+          if (next == 0x00) {
+            position_ += 2u;
+          } else {
+            at_marker_ = true;
+            byte = 0u;
+          }
+        } else {
+          position_++;
+        }
+      }
+      buffer_ |= static_cast<uint64_t>(byte) << (56u - count_);
+      count_ += 8u;
+    }
+  }
+
+  uint32_t Peek(uint32_t bits) const {
+    return static_cast<uint32_t>(buffer_ >> (64u - bits));
+  }
+
+  void Skip(uint32_t bits) {
+    buffer_ <<= bits;
+    count_ -= bits;
+  }
+
+  uint32_t Get(uint32_t bits) {
+    if (bits == 0u) {
+      return 0u;
+    }
+    const auto value = Peek(bits);
+    Skip(bits);
+    return value;
+  }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0u;
+  size_t position_ = 0u;
+  uint64_t buffer_ = 0u;
+  uint32_t count_ = 0u;
+  bool at_marker_ = false;
+};
+
+JPEGParser::JPEGParser(const fml::Mapping& source) {
+  const auto* data = source.GetMapping();
+  const auto size = source.GetSize();
+  if (data == nullptr || size < 4u || data[0] != 0xFF ||
+      data[1] != kMarkerSOI) {
+    return;
+  }
+
+  bool has_frame = false;
+  size_t offset = 2u;
+  while (offset + 4u <= size) {
+    if (data[offset] != 0xFF) {
+      return;
+    }
+    const auto marker = data[offset + 1u];
+    if (marker == 0xFF) {
+      // Fill byte.
+      offset++;
+      continue;
+    }
+    if (marker == kMarkerEOI) {
+      break;
+    }
+    const auto length = ReadU16(data + offset + 2u);
+    if (length < 2u || offset + 2u + length > size) {
+      return;
+    }
+    const auto* segment = data + offset + 4u;
+    const size_t segment_size = length - 2u;
+    offset += 2u + length;
+
+    switch (marker) {
+      case kMarkerSOF0:
+      case kMarkerSOF1:
+        if (has_frame || !ReadFrame(segment, segment_size)) {
+          return;
+        }
+        has_frame = true;
+        break;
+      case kMarkerDHT:
+        if (!ReadHuffmanTables(segment, segment_size)) {
+          return;
+        }
+        break;
+      case kMarkerDQT:
+        if (!ReadQuantTables(segment, segment_size)) {
+          return;
+        }
+        break;
+      case kMarkerDRI:
+        if (segment_size < 2u) {
+          return;
+        }
+        restart_interval_ = ReadU16(segment);
+        break;
+      case kMarkerSOS: {
+        if (!has_frame || scan_data_ != nullptr ||
+            !ReadScan(segment, segment_size)) {
+          return;
+        }
+        // The entropy coded data runs till the first marker that isn't a
+        // restart marker.
+        scan_data_ = data + offset;
+        segment_offsets_.push_back(0u);
+        while (offset + 1u < size &&
+               !(data[offset] == 0xFF && data[offset + 1u] != 0x00 &&
+                 !IsRestartMarker(data[offset + 1u]))) {
+          if (data[offset] == 0xFF && IsRestartMarker(data[offset + 1u])) {
+            segment_offsets_.push_back(data + offset + 2u - scan_data_);
+            offset++;
+          }
+          offset++;
+        }
+        scan_size_ = data + offset - scan_data_;
+        break;
+      }
+      default:
+        // Other start of frame markers are progressive, lossless or
+        // arithmetic coded.
+        if (marker >= 0xC2 && marker <= 0xCF && marker != kMarkerDHT &&
+            marker != 0xC8 && marker != 0xCC) {
+          return;
+        }
+        // Application data, comments and the like.
+        break;
+    }
+  }
+
+  if (!has_frame || scan_data_ == nullptr) {
+    return;
+  }
+  const size_t mcu_count = static_cast<size_t>(mcus_x_) * mcus_y_;
+  const size_t segment_count =
+      restart_interval_ > 0u
+          ? (mcu_count + restart_interval_ - 1u) / restart_interval_
+          : 1u;
+  if (segment_offsets_.size() != segment_count) {
+    FML_LOG(ERROR) << "Missing or extra JPEG restart markers.";
+    return;
+  }
+  for (const auto& component : components_) {
+    if (!dc_tables_[component.dc_table].is_valid ||
+        !ac_tables_[component.ac_table].is_valid) {
+      return;
+    }
+  }
+  is_valid_ = true;
+}
+
+JPEGParser::~JPEGParser() = default;
+
+bool JPEGParser::ReadFrame(const uint8_t* data, size_t size) {
+  if (size < 6u) {
+    return false;
+  }
+  const auto precision = data[0];
+  const auto height = ReadU16(data + 1u);
+  const auto width = ReadU16(data + 3u);
+  const auto component_count = data[5];
+  if (precision != 8u || width == 0u || height == 0u ||
+      (component_count != 1u && component_count != 3u) ||
+      size < 6u + component_count * 3u) {
+    return false;
+  }
+
+  for (size_t i = 0; i < component_count; i++) {
+    const auto* spec = data + 6u + i * 3u;
+    JPEGComponent component;
+    component.id = spec[0];
+    component.h_sampling = spec[1] >> 4u;
+    component.v_sampling = spec[1] & 0xFu;
+    component.quant_table = spec[2];
+    if (component.h_sampling < 1u || component.h_sampling > 4u ||
+        component.v_sampling < 1u || component.v_sampling > 4u ||
+        component.quant_table > 3u) {
+      return false;
+    }
+    // Scans with a single component aren't interleaved so the sampling
+    // factors don't matter.
+    if (component_count == 1u) {
+      component.h_sampling = 1u;
+      component.v_sampling = 1u;
+    }
+    max_h_sampling_ = std::max(max_h_sampling_, component.h_sampling);
+    max_v_sampling_ = std::max(max_v_sampling_, component.v_sampling);
+    components_.push_back(component);
+  }
+
+  size_ = {width, height};
+  mcus_x_ = DivideRoundingUp(width, 8u * max_h_sampling_);
+  mcus_y_ = DivideRoundingUp(height, 8u * max_v_sampling_);
+  for (auto& component : components_) {
+    component.width =
+        DivideRoundingUp(width * component.h_sampling, max_h_sampling_);
+    component.height =
+        DivideRoundingUp(height * component.v_sampling, max_v_sampling_);
+    component.blocks_x = mcus_x_ * component.h_sampling;
+    component.blocks_y = mcus_y_ * component.v_sampling;
+    component.coefficient_offset = coefficient_count_;
+    coefficient_count_ += static_cast<size_t>(component.blocks_x) *
+                          component.blocks_y * kBlockSize;
+  }
+  return true;
+}
+
+bool JPEGParser::ReadHuffmanTables(const uint8_t* data, size_t size) {
+  size_t offset = 0u;
+  while (offset < size) {
+    if (offset + 17u > size) {
+      return false;
+    }
+    const auto table_class = data[offset] >> 4u;
+    const auto table_index = data[offset] & 0xFu;
+    if (table_class > 1u || table_index > 3u) {
+      return false;
+    }
+    const auto* counts = data + offset + 1u;
+    size_t symbol_count = 0u;
+    for (size_t i = 0; i < 16u; i++) {
+      symbol_count += counts[i];
+    }
+    if (symbol_count > 256u || offset + 17u + symbol_count > size) {
+      return false;
+    }
+
+    auto& table = table_class == 0u ? dc_tables_[table_index]
+                                    : ac_tables_[table_index];
+    table = {};
+    std::memcpy(table.symbols.data(), data + offset + 17u, symbol_count);
+
+    // Codes are canonical: consecutive within a length and shifted left when
+    // moving to the next length.
+    int32_t code = 0;
+    int32_t index = 0;
+    for (uint32_t length = 1u; length <= 16u; length++) {
+      const auto count = counts[length - 1u];
+      table.value_offset[length] = index - code;
+      for (uint32_t i = 0; i < count; i++) {
+        if (code >= (1 << length)) {
+          return false;
+        }
+        if (length <= kLookupBits) {
+          const auto shift = kLookupBits - length;
+          const auto first = static_cast<uint32_t>(code) << shift;
+          for (uint32_t j = 0; j < (1u << shift); j++) {
+            table.lookup[first + j] = static_cast<uint16_t>(
+                (length << 8u) | table.symbols[index]);
+          }
+        }
+        code++;
+        index++;
+      }
+      table.max_code[length] = count > 0u ? code - 1 : -1;
+      code <<= 1;
+    }
+    table.is_valid = true;
+    offset += 17u + symbol_count;
+  }
+  return true;
+}
+
+bool JPEGParser::ReadQuantTables(const uint8_t* data, size_t size) {
+  size_t offset = 0u;
+  while (offset < size) {
+    const auto value_size = (data[offset] >> 4u) == 0u ? 1u : 2u;
+    const auto table_index = data[offset] & 0xFu;
+    if (table_index > 3u || offset + 1u + kBlockSize * value_size > size) {
+      return false;
+    }
+    const auto* values = data + offset + 1u;
+    auto& table = quant_tables_[table_index];
+    for (size_t i = 0; i < kBlockSize; i++) {
+      table[kZigZag[i]] =
+          value_size == 1u ? values[i] : ReadU16(values + i * 2u);
+    }
+    offset += 1u + kBlockSize * value_size;
+  }
+  return true;
+}
+
+bool JPEGParser::ReadScan(const uint8_t* data, size_t size) {
+  // Only a single scan with all components interleaved is supported.
+  if (size < 1u || data[0] != components_.size() ||
+      size < 4u + components_.size() * 2u) {
+    return false;
+  }
+  for (size_t i = 0; i < components_.size(); i++) {
+    const auto* spec = data + 1u + i * 2u;
+    auto component = std::find_if(
+        components_.begin(), components_.end(),
+        [&](const auto& other) { return other.id == spec[0]; });
+    if (component == components_.end()) {
+      return false;
+    }
+    component->dc_table = spec[1] >> 4u;
+    component->ac_table = spec[1] & 0xFu;
+    if (component->dc_table > 3u || component->ac_table > 3u) {
+      return false;
+    }
+  }
+  // Spectral selection and successive approximation must cover everything.
+  const auto* selection = data + 1u + components_.size() * 2u;
+  return selection[0] == 0u && selection[1] == 63u && selection[2] == 0u;
+}
+
+bool JPEGParser::IsValid() const {
+  return is_valid_;
+}
+
+glm::ivec2 JPEGParser::GetSize() const {
+  return size_;
+}
+
+const std::vector<JPEGComponent>& JPEGParser::GetComponents() const {
+  return components_;
+}
+
+uint32_t JPEGParser::GetMaxHSampling() const {
+  return max_h_sampling_;
+}
+
+uint32_t JPEGParser::GetMaxVSampling() const {
+  return max_v_sampling_;
+}
+
+const std::array<uint16_t, JPEGParser::kBlockSize>& JPEGParser::GetQuantTable(
+    size_t index) const {
+  return quant_tables_.at(index);
+}
+
+size_t JPEGParser::GetCoefficientCount() const {
+  return coefficient_count_;
+}
+
+int32_t JPEGParser::DecodeHuffman(BitReader& reader,
+                                  const HuffmanTable& table) {
+  reader.Fill();
+  if (const auto entry = table.lookup[reader.Peek(kLookupBits)]; entry != 0u) {
+    reader.Skip(entry >> 8u);
+    return entry & 0xFFu;
+  }
+  for (uint32_t length = kLookupBits + 1u; length <= 16u; length++) {
+    const auto code = static_cast<int32_t>(reader.Peek(length));
+    if (code <= table.max_code[length]) {
+      reader.Skip(length);
+      return table.symbols[(table.value_offset[length] + code) & 0xFF];
+    }
+  }
+  return -1;
+}
+
+// Sign extends a value of the given number of bits as described in F.2.2.1.
+static int32_t Extend(uint32_t value, uint32_t bits) {
+  if (bits == 0u) {
+    return 0;
+  }
+  if (value < (1u << (bits - 1u))) {
+    return static_cast<int32_t>(value) - static_cast<int32_t>(1u << bits) + 1;
+  }
+  return static_cast<int32_t>(value);
+}
+
+bool JPEGParser::DecodeMCUs(BitReader& reader,
+                            size_t first_mcu,
+                            size_t mcu_count,
+                            int16_t* coefficients) const {
+  std::array<int32_t, 3> dc_predictions = {};
+  for (size_t mcu = first_mcu; mcu < first_mcu + mcu_count; mcu++) {
+    const auto mcu_x = static_cast<uint32_t>(mcu % mcus_x_);
+    const auto mcu_y = static_cast<uint32_t>(mcu / mcus_x_);
+    for (size_t c = 0; c < components_.size(); c++) {
+      const auto& component = components_[c];
+      const auto& dc_table = dc_tables_[component.dc_table];
+      const auto& ac_table = ac_tables_[component.ac_table];
+      for (uint32_t v = 0; v < component.v_sampling; v++) {
+        for (uint32_t h = 0; h < component.h_sampling; h++) {
+          const size_t block_x = mcu_x * component.h_sampling + h;
+          const size_t block_y = mcu_y * component.v_sampling + v;
+          auto* block =
+              coefficients + component.coefficient_offset +
+              (block_y * component.blocks_x + block_x) * kBlockSize;
+          std::memset(block, 0, kBlockSize * sizeof(int16_t));
+
+          const auto dc_bits = DecodeHuffman(reader, dc_table);
+          if (dc_bits < 0 || dc_bits > 16) {
+            return false;
+          }
+          dc_predictions[c] += Extend(reader.Get(dc_bits), dc_bits);
+          block[0] = static_cast<int16_t>(dc_predictions[c]);
+
+          for (uint32_t k = 1u; k < kBlockSize;) {
+            const auto symbol = DecodeHuffman(reader, ac_table);
+            if (symbol < 0) {
+              return false;
+            }
+            const uint32_t run = symbol >> 4u;
+            const uint32_t bits = symbol & 0xFu;
+            if (bits == 0u) {
+              if (run != 15u) {
+                // End of block.
+                break;
+              }
+              k += 16u;
+              continue;
+            }
+            k += run;
+            if (k >= kBlockSize) {
+              return false;
+            }
+            reader.Fill();
+            block[kZigZag[k]] =
+                static_cast<int16_t>(Extend(reader.Get(bits), bits));
+            k++;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+size_t JPEGParser::GetSegmentCount() const {
+  return segment_offsets_.size();
+}
+
+bool JPEGParser::DecodeCoefficients(int16_t* coefficients) const {
+  for (size_t segment = 0; segment < GetSegmentCount(); segment++) {
+    if (!DecodeSegment(segment, coefficients)) {
+      return false;
+    }
+  }
+  return IsValid();
+}
+
+bool JPEGParser::DecodeSegment(size_t segment, int16_t* coefficients) const {
+  if (!IsValid() || coefficients == nullptr ||
+      segment >= segment_offsets_.size()) {
+    return false;
+  }
+  const size_t mcu_count = static_cast<size_t>(mcus_x_) * mcus_y_;
+  const size_t interval =
+      restart_interval_ > 0u ? restart_interval_ : mcu_count;
+  const size_t first_mcu = segment * interval;
+  const auto begin = segment_offsets_[segment];
+  const auto end = segment + 1u < segment_offsets_.size()
+                       ? segment_offsets_[segment + 1u]
+                       : scan_size_;
+  // The reader stops at the restart marker ending the segment.
+  BitReader reader(scan_data_ + begin, end - begin);
+  if (!DecodeMCUs(reader, first_mcu, std::min(interval, mcu_count - first_mcu),
+                  coefficients)) {
+    FML_LOG(ERROR) << "Corrupt JPEG entropy coded data.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace one
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "fml/macros.h"
+#include "fml/mapping.h"
+#include "glm/glm/ext/vector_int2.hpp"
+
+namespace one {
+
+struct JPEGComponent {
+  uint8_t id = 0u;
+  uint32_t h_sampling = 1u;
+  uint32_t v_sampling = 1u;
+  uint32_t quant_table = 0u;
+  uint32_t dc_table = 0u;
+  uint32_t ac_table = 0u;
+  // The size of the component in samples.
+  uint32_t width = 0u;
+  uint32_t height = 0u;
+  // The blocks of the component padded out to whole MCUs.
+  uint32_t blocks_x = 0u;
+  uint32_t blocks_y = 0u;
+  // Where the coefficients of the component's first block start.
+  size_t coefficient_offset = 0u;
+};
+
+// Parses baseline (sequential, Huffman coded, 8-bit) JPEGs with one or three
+// components and decodes the entropy coded data into quantized DCT
+// coefficients. Dequantization, the inverse DCT and color conversion are left
+// to the caller. Progressive and arithmetic coded images are not supported.
+//
+// The source must outlive the parser.
+class JPEGParser {
+ public:
+  static constexpr size_t kBlockSize = 64u;
+
+  explicit JPEGParser(const fml::Mapping& source);
+
+  ~JPEGParser();
+
+  bool IsValid() const;
+
+  glm::ivec2 GetSize() const;
+
+  const std::vector<JPEGComponent>& GetComponents() const;
+
+  uint32_t GetMaxHSampling() const;
+
+  uint32_t GetMaxVSampling() const;
+
+  // Quantization table values in natural (not zig-zag) order.
+  const std::array<uint16_t, kBlockSize>& GetQuantTable(size_t index) const;
+
+  size_t GetCoefficientCount() const;
+
+  // Decodes the quantized coefficients of every block in natural order. The
+  // blocks of each component are stored row major starting at the component's
+  // coefficient offset. The output must have room for GetCoefficientCount()
+  // coefficients.
+  bool DecodeCoefficients(int16_t* coefficients) const;
+
+  // The entropy coded data is split into segments at restart markers. Each
+  // segment decodes independently of the others so segments may be decoded
+  // concurrently. Images without restart intervals have a single segment.
+  size_t GetSegmentCount() const;
+
+  // Decodes the blocks of one segment to where DecodeCoefficients would.
+  bool DecodeSegment(size_t segment, int16_t* coefficients) const;
+
+ private:
+  static constexpr uint32_t kLookupBits = 9u;
+
+  struct HuffmanTable {
+    std::array<uint8_t, 256> symbols = {};
+    // The largest code of each length or -1 if there are none.
+    std::array<int32_t, 17> max_code = {};
+    std::array<int32_t, 17> value_offset = {};
+    // (length << 8) | symbol for codes that fit in the lookup bits, zero
+    // otherwise.
+    std::array<uint16_t, 1u << kLookupBits> lookup = {};
+    bool is_valid = false;
+  };
+
+  class BitReader;
+
+  glm::ivec2 size_;
+  std::vector<JPEGComponent> components_;
+  std::array<std::array<uint16_t, kBlockSize>, 4> quant_tables_ = {};
+  std::array<HuffmanTable, 4> dc_tables_;
+  std::array<HuffmanTable, 4> ac_tables_;
+  uint32_t max_h_sampling_ = 1u;
+  uint32_t max_v_sampling_ = 1u;
+  uint32_t mcus_x_ = 0u;
+  uint32_t mcus_y_ = 0u;
+  uint32_t restart_interval_ = 0u;
+  size_t coefficient_count_ = 0u;
+  const uint8_t* scan_data_ = nullptr;
+  size_t scan_size_ = 0u;
+  // Where each segment starts in the scan data.
+  std::vector<size_t> segment_offsets_;
+  bool is_valid_ = false;
+
+  bool ReadFrame(const uint8_t* data, size_t size);
+
+  bool ReadHuffmanTables(const uint8_t* data, size_t size);
+
+  bool ReadQuantTables(const uint8_t* data, size_t size);
+
+  bool ReadScan(const uint8_t* data, size_t size);
+
+  static int32_t DecodeHuffman(BitReader& reader, const HuffmanTable& table);
+
+  // Decodes the MCUs in [first_mcu, first_mcu + mcu_count) which must start a
+  // segment.
+  bool DecodeMCUs(BitReader& reader,
+                  size_t first_mcu,
+                  size_t mcu_count,
+                  int16_t* coefficients) const;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(JPEGParser);
+};
+
+}  // namespace one
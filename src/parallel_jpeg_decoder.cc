@@ -0,0 +1,229 @@
+#include "parallel_jpeg_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+#include "fml/logging.h"
+#include "fml/synchronization/count_down_latch.h"
+
+namespace one {
+
+static constexpr size_t kBytesPerPixel = 4u;
+
+// Splits [0, count) into a range for the calling thread and one for each
+// worker of the task runner, and calls function(begin, end) for each
+// concurrently. The calling thread takes the first range.
+template <class Function>
+static void ParallelFor(fml::ConcurrentTaskRunner& task_runner,
+                        size_t count,
+                        const Function& function) {
+  const size_t task_count =
+      std::min<size_t>(count, task_runner.GetWorkerCount() + 1u);
+  if (task_count <= 1u) {
+    function(0u, count);
+    return;
+  }
+  fml::CountDownLatch latch(task_count - 1u);
+  for (size_t task = 1u; task < task_count; task++) {
+    task_runner.PostTask([&, task]() {
+      function(count * task / task_count, count * (task + 1u) / task_count);
+      latch.CountDown();
+    });
+  }
+  function(0u, count / task_count);
+  latch.Wait();
+}
+
+// The 1D IDCT basis including the normalization of each pass, indexed by
+// [position][frequency].
+static std::array<std::array<float, 8>, 8> MakeIDCTBasis() {
+  std::array<std::array<float, 8>, 8> basis = {};
+  for (size_t position = 0; position < 8u; position++) {
+    for (size_t frequency = 0; frequency < 8u; frequency++) {
+      const float scale = frequency == 0u ? std::sqrt(0.125f) : 0.5f;
+      basis[position][frequency] =
+          scale * std::cos((2.0f * position + 1.0f) * frequency *
+                           std::numbers::pi_v<float> / 16.0f);
+    }
+  }
+  return basis;
+}
+
+static void InverseTransformBlock(const int16_t* coefficients,
+                                  const std::array<uint16_t, 64>& quant_table,
+                                  uint8_t* samples,
+                                  size_t stride) {
+  static const auto kBasis = MakeIDCTBasis();
+
+  std::array<float, 64> block;
+  bool has_ac = false;
+  for (size_t i = 0; i < 64u; i++) {
+    block[i] = static_cast<float>(coefficients[i]) * quant_table[i];
+    has_ac = has_ac || (i > 0u && coefficients[i] != 0);
+  }
+
+  if (!has_ac) {
+    // Flat blocks are common and need no transform.
+    const auto value = static_cast<uint8_t>(
+        std::clamp(std::round(block[0] / 8.0f + 128.0f), 0.0f, 255.0f));
+    for (size_t y = 0; y < 8u; y++) {
+      std::fill_n(samples + y * stride, 8u, value);
+    }
+    return;
+  }
+
+  std::array<float, 64> rows;
+  for (size_t v = 0; v < 8u; v++) {
+    for (size_t x = 0; x < 8u; x++) {
+      float sum = 0.0f;
+      for (size_t u = 0; u < 8u; u++) {
+        sum += kBasis[x][u] * block[v * 8u + u];
+      }
+      rows[v * 8u + x] = sum;
+    }
+  }
+  for (size_t y = 0; y < 8u; y++) {
+    for (size_t x = 0; x < 8u; x++) {
+      float sum = 0.0f;
+      for (size_t v = 0; v < 8u; v++) {
+        sum += kBasis[y][v] * rows[v * 8u + x];
+      }
+      samples[y * stride + x] = static_cast<uint8_t>(
+          std::clamp(std::round(sum + 128.0f), 0.0f, 255.0f));
+    }
+  }
+}
+
+// Matches UpsampleComponent in jpeg_color.comp.
+static float UpsampleComponent(const JPEGComponent& component,
+                               const uint8_t* plane,
+                               float scale_x,
+                               float scale_y,
+                               uint32_t x,
+                               uint32_t y) {
+  const size_t stride = component.blocks_x * 8u;
+  const float position_x =
+      std::clamp((x + 0.5f) * scale_x - 0.5f, 0.0f,
+                 static_cast<float>(component.width - 1u));
+  const float position_y =
+      std::clamp((y + 0.5f) * scale_y - 0.5f, 0.0f,
+                 static_cast<float>(component.height - 1u));
+  const auto x0 = static_cast<uint32_t>(position_x);
+  const auto y0 = static_cast<uint32_t>(position_y);
+  const auto x1 = std::min(x0 + 1u, component.width - 1u);
+  const auto y1 = std::min(y0 + 1u, component.height - 1u);
+  const float fx = position_x - x0;
+  const float fy = position_y - y0;
+  const auto sample = [&](uint32_t sx, uint32_t sy) {
+    return static_cast<float>(plane[sy * stride + sx]);
+  };
+  const float top = sample(x0, y0) + (sample(x1, y0) - sample(x0, y0)) * fx;
+  const float bottom =
+      sample(x0, y1) + (sample(x1, y1) - sample(x0, y1)) * fx;
+  return top + (bottom - top) * fy;
+}
+
+static uint8_t ToByte(float value) {
+  return static_cast<uint8_t>(std::clamp(std::round(value), 0.0f, 255.0f));
+}
+
+std::unique_ptr<fml::Mapping> DecodeJPEGConcurrently(
+    const JPEGParser& parser,
+    fml::ConcurrentTaskRunner& task_runner) {
+  if (!parser.IsValid()) {
+    return nullptr;
+  }
+
+  // Without restart intervals there is a single segment and the entropy
+  // decoding is done on this thread.
+  std::vector<int16_t> coefficients(parser.GetCoefficientCount());
+  std::atomic<bool> decoded = true;
+  ParallelFor(task_runner, parser.GetSegmentCount(),
+              [&](size_t begin, size_t end) {
+                for (size_t segment = begin; segment < end; segment++) {
+                  if (!parser.DecodeSegment(segment, coefficients.data())) {
+                    decoded = false;
+                    return;
+                  }
+                }
+              });
+  if (!decoded) {
+    return nullptr;
+  }
+
+  const auto& components = parser.GetComponents();
+  std::vector<std::vector<uint8_t>> planes(components.size());
+  for (size_t i = 0; i < components.size(); i++) {
+    planes[i].resize(components[i].blocks_x * components[i].blocks_y * 64u);
+  }
+
+  // Each MCU row covers the same rows of the image in every component.
+  const uint32_t mcu_rows =
+      components.front().blocks_y / components.front().v_sampling;
+  ParallelFor(task_runner, mcu_rows, [&](size_t begin, size_t end) {
+    for (size_t c = 0; c < components.size(); c++) {
+      const auto& component = components[c];
+      const auto& quant_table = parser.GetQuantTable(component.quant_table);
+      const size_t stride = component.blocks_x * 8u;
+      for (size_t block_y = begin * component.v_sampling;
+           block_y < end * component.v_sampling; block_y++) {
+        for (size_t block_x = 0; block_x < component.blocks_x; block_x++) {
+          const auto block = block_y * component.blocks_x + block_x;
+          InverseTransformBlock(
+              coefficients.data() + component.coefficient_offset +
+                  block * JPEGParser::kBlockSize,
+              quant_table, planes[c].data() + block_y * 8u * stride +
+                               block_x * 8u,
+              stride);
+        }
+      }
+    }
+  });
+
+  const auto size = parser.GetSize();
+  auto pixels = std::make_unique<std::vector<uint8_t>>(
+      static_cast<size_t>(size.x) * size.y * kBytesPerPixel);
+  const bool is_color = components.size() == 3u;
+  std::vector<std::array<float, 2>> scales;
+  for (const auto& component : components) {
+    scales.push_back(
+        {static_cast<float>(component.h_sampling) / parser.GetMaxHSampling(),
+         static_cast<float>(component.v_sampling) /
+             parser.GetMaxVSampling()});
+  }
+  const auto upsample = [&](size_t c, uint32_t x, uint32_t y) {
+    return UpsampleComponent(components[c], planes[c].data(), scales[c][0],
+                             scales[c][1], x, y);
+  };
+  ParallelFor(task_runner, size.y, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; y++) {
+      auto* row = pixels->data() + y * size.x * kBytesPerPixel;
+      for (uint32_t x = 0; x < static_cast<uint32_t>(size.x); x++) {
+        const auto sample_y = static_cast<uint32_t>(y);
+        const float luma = upsample(0u, x, sample_y);
+        auto* pixel = row + x * kBytesPerPixel;
+        if (is_color) {
+          const float cb = upsample(1u, x, sample_y) - 128.0f;
+          const float cr = upsample(2u, x, sample_y) - 128.0f;
+          pixel[0] = ToByte(luma + 1.402f * cr);
+          pixel[1] = ToByte(luma - 0.344136f * cb - 0.714136f * cr);
+          pixel[2] = ToByte(luma + 1.772f * cb);
+        } else {
+          pixel[0] = pixel[1] = pixel[2] = ToByte(luma);
+        }
+        pixel[3] = 255u;
+      }
+    }
+  });
+
+  auto released = pixels.release();
+  return std::make_unique<fml::NonOwnedMapping>(
+      released->data(), released->size(),
+      [released](const uint8_t* data, size_t size) { delete released; });
+}
+
+}  // namespace one
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <memory>
+
+#include "fml/concurrent_message_loop.h"
+#include "fml/mapping.h"
+#include "jpeg_parser.h"
+
+namespace one {
+
+// Decodes a baseline JPEG to tightly packed RGBA8 pixels using many threads.
+// The segments between restart markers are entropy decoded concurrently, then
+// the inverse DCT and color conversion run in horizontal strips of MCU rows.
+// Images without restart intervals are entropy decoded serially.
+//
+// Returns nullptr if the image can't be decoded. The caller waits for the
+// workers so it must not be one of the task runner's own workers.
+std::unique_ptr<fml::Mapping> DecodeJPEGConcurrently(
+    const JPEGParser& parser,
+    fml::ConcurrentTaskRunner& task_runner);
+
+}  // namespace one
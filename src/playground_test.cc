@@ -1,11 +1,13 @@
 #include "playground_test.h"
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 
 #include "GLFW/glfw3.h"
 #include "context.h"
 #include "fml/logging.h"
+#include "fml/synchronization/waitable_event.h"
 #include "swapchain.h"
 #include "vulkan/vulkan_core.h"
 #include "vulkan/vulkan_enums.hpp"
@@ -45,8 +47,7 @@ PlaygroundTest::PlaygroundTest() {
       (PFN_vkGetInstanceProcAddr)::glfwGetInstanceProcAddress(
           nullptr, "vkGetInstanceProcAddr");
 
-  context_ = Context::Make(vk_get_instance_proc_addr_,
-                           GetAdditionalRequiredInstanceExtensions());
+  context_ = MakeContext({});
   if (!context_) {
     return;
   }
@@ -76,6 +77,76 @@ bool PlaygroundTest::IsValid() const {
   return is_valid_;
 }
 
+const std::shared_ptr<Context>& PlaygroundTest::GetContext() const {
+  return context_;
+}
+
+std::shared_ptr<Context> PlaygroundTest::MakeContext(
+    const ContextSettings& settings) const {
+  return Context::Make(vk_get_instance_proc_addr_,
+                       GetAdditionalRequiredInstanceExtensions(), settings);
+}
+
+Swapchain& PlaygroundTest::GetSwapchain() const {
+  return *swapchain_;
+}
+
+std::unique_ptr<Swapchain> PlaygroundTest::MakeWindowSwapchain(
+    PresentPolicy policy) {
+  if (!IsValid()) {
+    return nullptr;
+  }
+  ::glfwDefaultWindowHints();
+  ::glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  auto window = ::glfwCreateWindow(640, 480, "Just One", nullptr, nullptr);
+  if (!window) {
+    FML_LOG(ERROR) << "Unable to create glfw window";
+    return nullptr;
+  }
+  test_windows_.emplace_back(window);
+
+  VkSurfaceKHR surface = {};
+  if (const auto result = ::glfwCreateWindowSurface(
+          context_->GetInstance(), window, nullptr, &surface);
+      result != VK_SUCCESS) {
+    FML_LOG(ERROR) << "Could not create surface: "
+                   << vk::to_string(vk::Result(result));
+    return nullptr;
+  }
+  auto swapchain = std::make_unique<Swapchain>(
+      context_, vk::UniqueSurfaceKHR{surface, context_->GetInstance()},
+      policy);
+  if (!swapchain->IsValid()) {
+    return nullptr;
+  }
+  return swapchain;
+}
+
+vk::CommandBuffer PlaygroundTest::MakeCommandBuffer() {
+  if (!IsValid()) {
+    return {};
+  }
+  const auto& device = context_->GetDevice();
+  vk::CommandPoolCreateInfo pool_info;
+  pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+  pool_info.queueFamilyIndex = context_->GetQueueIndex().family;
+  auto [pool_result, pool] = device.createCommandPoolUnique(pool_info);
+  if (pool_result != vk::Result::eSuccess) {
+    return {};
+  }
+  vk::CommandBufferAllocateInfo command_buffer_info;
+  command_buffer_info.commandPool = *pool;
+  command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+  command_buffer_info.commandBufferCount = 1u;
+  auto [command_buffers_result, command_buffers] =
+      device.allocateCommandBuffers(command_buffer_info);
+  if (command_buffers_result != vk::Result::eSuccess) {
+    return {};
+  }
+  command_pools_.push_back(std::move(pool));
+  return command_buffers.front();
+}
+
 static void PlaygroundKeyCallback(GLFWwindow* window,
                                   int key,
                                   int scancode,
@@ -95,17 +166,28 @@ bool PlaygroundTest::OpenPlaygroundHere() {
   ::glfwSetWindowUserPointer(window_.get(), this);
   ::glfwSetKeyCallback(window_.get(), &PlaygroundKeyCallback);
 
-  while (true) {
-    ::glfwPollEvents();
-    if (::glfwWindowShouldClose(window_.get())) {
-      return true;
-    }
-    if (!swapchain_->Render()) {
-      return false;
+  // Frames are rendered on the render thread while this thread handles window
+  // events, which GLFW only allows on the main thread.
+  std::atomic_bool stop = false;
+  std::atomic_bool failed = false;
+  fml::AutoResetWaitableEvent stopped;
+  context_->GetRenderTaskRunner()->PostTask([&]() {
+    while (!stop) {
+      if (!swapchain_->Render()) {
+        failed = true;
+        break;
+      }
     }
+    stopped.Signal();
+  });
+
+  while (!failed && !::glfwWindowShouldClose(window_.get())) {
+    ::glfwWaitEventsTimeout(0.1);
   }
+  stop = true;
+  stopped.Wait();
 
-  return false;
+  return !failed;
 }
 
 }  // namespace one::testing
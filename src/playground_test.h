@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "context.h"
 #include "fml/macros.h"
 #include "fml/unique_object.h"
@@ -24,6 +27,22 @@ class PlaygroundTest : public ::testing::Test {
 
   bool IsValid() const;
 
+  const std::shared_ptr<Context>& GetContext() const;
+
+  // Another context on the same instance extensions as the playground's.
+  std::shared_ptr<Context> MakeContext(const ContextSettings& settings) const;
+
+  // The swapchain of the playground window.
+  Swapchain& GetSwapchain() const;
+
+  // A swapchain for a new window that is closed at the end of the test.
+  std::unique_ptr<Swapchain> MakeWindowSwapchain(
+      PresentPolicy policy = PresentPolicy::kLowLatency);
+
+  // A primary command buffer from a pool that lasts till the end of the test.
+  // It may be recorded again once the GPU is done with it. Null on failure.
+  vk::CommandBuffer MakeCommandBuffer();
+
  private:
   struct UniqueGLFWWindowTraits {
     static GLFWwindow* InvalidValue() { return nullptr; }
@@ -35,10 +54,15 @@ class PlaygroundTest : public ::testing::Test {
     static void Free(GLFWwindow* window) { glfwDestroyWindow(window); }
   };
 
-  fml::UniqueObject<GLFWwindow*, UniqueGLFWWindowTraits> window_;
+  using UniqueGLFWWindow =
+      fml::UniqueObject<GLFWwindow*, UniqueGLFWWindowTraits>;
+
+  UniqueGLFWWindow window_;
+  std::vector<UniqueGLFWWindow> test_windows_;
   PFN_vkGetInstanceProcAddr vk_get_instance_proc_addr_ = {};
   std::shared_ptr<Context> context_;
   std::unique_ptr<Swapchain> swapchain_;
+  std::vector<vk::UniqueCommandPool> command_pools_;
   bool is_valid_ = false;
 
   FML_DISALLOW_COPY_AND_ASSIGN(PlaygroundTest);
@@ -0,0 +1,449 @@
+#include "readback.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "context.h"
+#include "fml/logging.h"
+
+namespace one {
+
+struct Readback::Slot {
+  enum class State {
+    kFree,
+    kRecorded,
+    kSubmitting,
+    kSubmitted,
+    kCopying,
+  };
+
+  vk::UniqueBuffer buffer;
+  vk::UniqueDeviceMemory memory;
+  vk::UniqueCommandBuffer command_buffer;
+  const uint8_t* mapping = nullptr;
+  bool is_coherent = false;
+  State state = State::kFree;
+  uint64_t timeline_value = 0u;
+  vk::Extent2D extent;
+  vk::Format format = vk::Format::eUndefined;
+  Callback callback;
+};
+
+static constexpr vk::DeviceSize kBytesPerPixel = 4u;
+
+std::shared_ptr<Readback> Readback::Make(
+    const std::shared_ptr<Context>& context,
+    size_t slot_count,
+    vk::DeviceSize slot_size) {
+  auto readback = std::shared_ptr<Readback>(
+      new Readback(context, slot_count, slot_size));
+  if (!readback->IsValid()) {
+    return nullptr;
+  }
+  return readback;
+}
+
+Readback::Readback(const std::shared_ptr<Context>& context,
+                   size_t slot_count,
+                   vk::DeviceSize slot_size)
+    : context_(context), slot_size_(slot_size) {
+  if (!context || slot_count == 0u || slot_size == 0u) {
+    return;
+  }
+
+  const auto& device = context->GetDevice();
+
+  {
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info.flags = vk::CommandPoolCreateFlagBits::eTransient |
+                      vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    pool_info.queueFamilyIndex = context->GetQueueIndex().family;
+    auto [result, pool] = device.createCommandPoolUnique(pool_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    command_pool_ = std::move(pool);
+  }
+
+  vk::CommandBufferAllocateInfo command_buffer_info;
+  command_buffer_info.commandPool = *command_pool_;
+  command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+  command_buffer_info.commandBufferCount = static_cast<uint32_t>(slot_count);
+  auto [command_buffers_result, command_buffers] =
+      device.allocateCommandBuffersUnique(command_buffer_info);
+  if (command_buffers_result != vk::Result::eSuccess) {
+    return;
+  }
+
+  for (size_t i = 0; i < slot_count; i++) {
+    auto slot = std::make_unique<Slot>();
+    slot->command_buffer = std::move(command_buffers[i]);
+
+    vk::BufferCreateInfo buffer_info;
+    buffer_info.size = slot_size;
+    buffer_info.usage = vk::BufferUsageFlagBits::eTransferDst;
+    buffer_info.sharingMode = vk::SharingMode::eExclusive;
+    auto [buffer_result, buffer] = device.createBufferUnique(buffer_info);
+    if (buffer_result != vk::Result::eSuccess) {
+      return;
+    }
+    slot->buffer = std::move(buffer);
+
+    const auto requirements =
+        device.getBufferMemoryRequirements(*slot->buffer);
+    // Cached memory makes reading the pixels on the CPU much faster.
+    auto memory_type = context->FindMemoryTypeIndex(
+        requirements.memoryTypeBits,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCached);
+    if (!memory_type.has_value()) {
+      memory_type = context->FindMemoryTypeIndex(
+          requirements.memoryTypeBits,
+          vk::MemoryPropertyFlagBits::eHostVisible |
+              vk::MemoryPropertyFlagBits::eHostCoherent);
+    }
+    if (!memory_type.has_value()) {
+      FML_LOG(ERROR) << "No host visible memory for readback.";
+      return;
+    }
+
+    vk::MemoryAllocateInfo allocate_info;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = memory_type.value();
+    auto [memory_result, memory] = device.allocateMemoryUnique(allocate_info);
+    if (memory_result != vk::Result::eSuccess) {
+      return;
+    }
+    slot->memory = std::move(memory);
+    slot->is_coherent = static_cast<bool>(
+        context->GetMemoryTypeProperties(memory_type.value()) &
+        vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    if (device.bindBufferMemory(*slot->buffer, *slot->memory, 0u) !=
+        vk::Result::eSuccess) {
+      return;
+    }
+
+    auto [map_result, mapping] =
+        device.mapMemory(*slot->memory, 0u, VK_WHOLE_SIZE);
+    if (map_result != vk::Result::eSuccess) {
+      return;
+    }
+    slot->mapping = static_cast<const uint8_t*>(mapping);
+
+    slots_.emplace_back(std::move(slot));
+  }
+
+  is_valid_ = true;
+}
+
+Readback::~Readback() {
+  auto context = context_.lock();
+  if (!context) {
+    return;
+  }
+  // Pending copies are dropped but the GPU must be done with the buffers.
+  uint64_t timeline_value = 0u;
+  for (const auto& slot : slots_) {
+    timeline_value = std::max(timeline_value, slot->timeline_value);
+  }
+  context->WaitForTimelineValue(timeline_value);
+}
+
+bool Readback::IsValid() const {
+  return is_valid_;
+}
+
+bool Readback::IsSupportedFormat(vk::Format format) {
+  switch (format) {
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Readback::Slot* Readback::AcquireSlotLocked(vk::Extent2D extent,
+                                            vk::Format format) {
+  if (!IsSupportedFormat(format)) {
+    FML_LOG(ERROR) << "Unsupported readback format: " << vk::to_string(format);
+    return nullptr;
+  }
+  if (extent.width * extent.height * kBytesPerPixel > slot_size_) {
+    FML_LOG(ERROR) << "Image too large for readback.";
+    return nullptr;
+  }
+  for (const auto& slot : slots_) {
+    if (slot->state == Slot::State::kFree) {
+      slot->extent = extent;
+      slot->format = format;
+      return slot.get();
+    }
+  }
+  return nullptr;
+}
+
+void Readback::RecordLocked(Slot& slot,
+                            const vk::CommandBuffer& command_buffer,
+                            const vk::Image& image,
+                            vk::ImageLayout layout,
+                            Callback callback) {
+  vk::ImageSubresourceRange range;
+  range.aspectMask = vk::ImageAspectFlagBits::eColor;
+  range.baseMipLevel = 0u;
+  range.levelCount = 1u;
+  range.baseArrayLayer = 0u;
+  range.layerCount = 1u;
+
+  vk::ImageMemoryBarrier to_transfer;
+  to_transfer.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+  to_transfer.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+  to_transfer.oldLayout = layout;
+  to_transfer.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+  to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_transfer.image = image;
+  to_transfer.subresourceRange = range;
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+                                 vk::PipelineStageFlagBits::eTransfer, {}, {},
+                                 {}, to_transfer);
+
+  vk::BufferImageCopy region;
+  region.bufferOffset = 0u;
+  region.bufferRowLength = 0u;
+  region.bufferImageHeight = 0u;
+  region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  region.imageSubresource.mipLevel = 0u;
+  region.imageSubresource.baseArrayLayer = 0u;
+  region.imageSubresource.layerCount = 1u;
+  region.imageExtent = vk::Extent3D{slot.extent.width, slot.extent.height, 1u};
+  command_buffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal,
+                                   *slot.buffer, region);
+
+  vk::ImageMemoryBarrier to_original;
+  to_original.srcAccessMask = {};
+  to_original.dstAccessMask =
+      vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+  to_original.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+  to_original.newLayout = layout;
+  to_original.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_original.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_original.image = image;
+  to_original.subresourceRange = range;
+
+  vk::BufferMemoryBarrier to_host;
+  to_host.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  to_host.dstAccessMask = vk::AccessFlagBits::eHostRead;
+  to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_host.buffer = *slot.buffer;
+  to_host.offset = 0u;
+  to_host.size = VK_WHOLE_SIZE;
+
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                 vk::PipelineStageFlagBits::eAllCommands |
+                                     vk::PipelineStageFlagBits::eHost,
+                                 {}, {}, to_host, to_original);
+
+  slot.callback = std::move(callback);
+  slot.state = Slot::State::kRecorded;
+}
+
+bool Readback::Record(const vk::CommandBuffer& command_buffer,
+                      const vk::Image& image,
+                      vk::ImageLayout layout,
+                      vk::Extent2D extent,
+                      vk::Format format,
+                      Callback callback) {
+  if (!IsValid() || layout == vk::ImageLayout::eUndefined) {
+    return false;
+  }
+  std::scoped_lock lock(slots_mutex_);
+  auto slot = AcquireSlotLocked(extent, format);
+  if (!slot) {
+    return false;
+  }
+  RecordLocked(*slot, command_buffer, image, layout, std::move(callback));
+  return true;
+}
+
+void Readback::Submitted(uint64_t timeline_value) {
+  std::scoped_lock lock(slots_mutex_);
+  for (const auto& slot : slots_) {
+    if (slot->state == Slot::State::kRecorded) {
+      slot->state = Slot::State::kSubmitted;
+      slot->timeline_value = timeline_value;
+    }
+  }
+}
+
+void Readback::Discard() {
+  std::scoped_lock lock(slots_mutex_);
+  for (const auto& slot : slots_) {
+    if (slot->state == Slot::State::kRecorded) {
+      slot->callback = nullptr;
+      slot->state = Slot::State::kFree;
+    }
+  }
+}
+
+bool Readback::Capture(const vk::Image& image,
+                       vk::ImageLayout layout,
+                       vk::Extent2D extent,
+                       vk::Format format,
+                       Callback callback) {
+  auto context = context_.lock();
+  if (!context || !IsValid() || layout == vk::ImageLayout::eUndefined) {
+    return false;
+  }
+
+  std::unique_lock lock(slots_mutex_);
+  auto slot = AcquireSlotLocked(extent, format);
+  if (!slot) {
+    return false;
+  }
+
+  const auto& command_buffer = *slot->command_buffer;
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  if (command_buffer.begin(begin_info) != vk::Result::eSuccess) {
+    return false;
+  }
+  RecordLocked(*slot, command_buffer, image, layout, std::move(callback));
+  if (command_buffer.end() != vk::Result::eSuccess) {
+    slot->state = Slot::State::kFree;
+    return false;
+  }
+  // Don't let a concurrent call to Submitted claim this slot.
+  slot->state = Slot::State::kSubmitting;
+  lock.unlock();
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  const auto timeline_value = context->Submit(submit_info);
+
+  lock.lock();
+  if (!timeline_value.has_value()) {
+    slot->state = Slot::State::kFree;
+    return false;
+  }
+  slot->state = Slot::State::kSubmitted;
+  slot->timeline_value = timeline_value.value();
+  return true;
+}
+
+void Readback::Poll() {
+  auto context = context_.lock();
+  if (!context || !IsValid()) {
+    return;
+  }
+  const auto completed_value = context->GetCompletedTimelineValue();
+  std::scoped_lock lock(slots_mutex_);
+  for (const auto& slot : slots_) {
+    if (slot->state != Slot::State::kSubmitted ||
+        slot->timeline_value > completed_value) {
+      continue;
+    }
+    slot->state = Slot::State::kCopying;
+    if (!slot->is_coherent) {
+      vk::MappedMemoryRange range;
+      range.memory = *slot->memory;
+      range.offset = 0u;
+      range.size = VK_WHOLE_SIZE;
+      [[maybe_unused]] auto result =
+          context->GetDevice().invalidateMappedMemoryRanges(range);
+    }
+    // The copy must not lock the context. Releasing the last reference on
+    // one of its workers would join the worker from itself.
+    context->GetConcurrentTaskRunner()->PostTask(
+        [readback = shared_from_this(), slot = slot.get()]() {
+          readback->CopyOut(slot);
+        });
+  }
+}
+
+void Readback::CopyOut(Slot* slot) {
+  const auto size =
+      slot->extent.width * slot->extent.height * kBytesPerPixel;
+
+  auto pixels = static_cast<uint8_t*>(::malloc(size));
+  FML_CHECK(pixels);
+  switch (slot->format) {
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+      for (size_t i = 0; i < size; i += kBytesPerPixel) {
+        pixels[i + 0] = slot->mapping[i + 2];
+        pixels[i + 1] = slot->mapping[i + 1];
+        pixels[i + 2] = slot->mapping[i + 0];
+        pixels[i + 3] = slot->mapping[i + 3];
+      }
+      break;
+    default:
+      ::memcpy(pixels, slot->mapping, size);
+      break;
+  }
+
+  auto callback = std::move(slot->callback);
+  const auto extent = slot->extent;
+
+  // The slot may be reused while the callback runs but Flush must wait for
+  // the callback too.
+  {
+    std::scoped_lock lock(slots_mutex_);
+    slot->callback = nullptr;
+    slot->state = Slot::State::kFree;
+    callbacks_in_flight_++;
+  }
+  slots_condition_.notify_all();
+
+  if (callback) {
+    callback(std::make_unique<fml::MallocMapping>(pixels, size), extent);
+  } else {
+    ::free(pixels);
+  }
+
+  {
+    std::scoped_lock lock(slots_mutex_);
+    callbacks_in_flight_--;
+  }
+  slots_condition_.notify_all();
+}
+
+bool Readback::Flush() {
+  auto context = context_.lock();
+  if (!context || !IsValid()) {
+    return false;
+  }
+  uint64_t timeline_value = 0u;
+  {
+    std::scoped_lock lock(slots_mutex_);
+    for (const auto& slot : slots_) {
+      if (slot->state == Slot::State::kSubmitted) {
+        timeline_value = std::max(timeline_value, slot->timeline_value);
+      }
+    }
+  }
+  if (!context->WaitForTimelineValue(timeline_value)) {
+    return false;
+  }
+  Poll();
+  std::unique_lock lock(slots_mutex_);
+  slots_condition_.wait(lock, [&]() {
+    if (callbacks_in_flight_ > 0u) {
+      return false;
+    }
+    for (const auto& slot : slots_) {
+      if (slot->state == Slot::State::kCopying) {
+        return false;
+      }
+    }
+    return true;
+  });
+  return true;
+}
+
+}  // namespace one
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fml/macros.h"
+#include "fml/mapping.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+// Copies images into a ring of host visible buffers. The pixels are handed
+// back a few frames later once the GPU is done with the copy so the queue is
+// never stalled waiting on the results. If all buffers in the ring are still
+// in flight, new copies are dropped instead.
+class Readback final : public std::enable_shared_from_this<Readback> {
+ public:
+  // Pixels are always tightly packed RGBA8. The callback is invoked on the
+  // concurrent task runner.
+  using Callback =
+      std::function<void(std::unique_ptr<fml::Mapping> pixels,
+                         vk::Extent2D extent)>;
+
+  static std::shared_ptr<Readback> Make(const std::shared_ptr<Context>& context,
+                                        size_t slot_count,
+                                        vk::DeviceSize slot_size);
+
+  ~Readback();
+
+  bool IsValid() const;
+
+  static bool IsSupportedFormat(vk::Format format);
+
+  // Records a copy of the image into the command buffer. The image must be in
+  // the given layout and is returned to it after the copy. Call Submitted once
+  // the command buffer has been submitted.
+  bool Record(const vk::CommandBuffer& command_buffer,
+              const vk::Image& image,
+              vk::ImageLayout layout,
+              vk::Extent2D extent,
+              vk::Format format,
+              Callback callback);
+
+  void Submitted(uint64_t timeline_value);
+
+  // Returns the copies recorded since the last call to Submitted to the ring.
+  // Call it if the command buffer they were recorded into won't be submitted.
+  void Discard();
+
+  // Copies the image in a submission of its own.
+  bool Capture(const vk::Image& image,
+               vk::ImageLayout layout,
+               vk::Extent2D extent,
+               vk::Format format,
+               Callback callback);
+
+  // Hands back the pixels of all copies the GPU has completed.
+  void Poll();
+
+  // Waits for all submitted copies and for their callbacks to be invoked.
+  bool Flush();
+
+ private:
+  struct Slot;
+
+  std::weak_ptr<Context> context_;
+  vk::DeviceSize slot_size_ = 0u;
+  vk::UniqueCommandPool command_pool_;
+  std::mutex slots_mutex_;
+  std::condition_variable slots_condition_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  // Callbacks of freed slots that haven't returned yet.
+  size_t callbacks_in_flight_ = 0u;
+  bool is_valid_ = false;
+
+  Readback(const std::shared_ptr<Context>& context,
+           size_t slot_count,
+           vk::DeviceSize slot_size);
+
+  Slot* AcquireSlotLocked(vk::Extent2D extent, vk::Format format);
+
+  void RecordLocked(Slot& slot,
+                    const vk::CommandBuffer& command_buffer,
+                    const vk::Image& image,
+                    vk::ImageLayout layout,
+                    Callback callback);
+
+  // Runs on a concurrent worker and must not lock the context. Poll has
+  // already invalidated the slot's memory.
+  void CopyOut(Slot* slot);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(Readback);
+};
+
+}  // namespace one
@@ -0,0 +1,688 @@
+#include "render_graph.h"
+
+#include <algorithm>
+
+#include "context.h"
+#include "fml/logging.h"
+
+namespace one {
+
+struct RenderGraph::Resource {
+  std::string name;
+  bool is_image = true;
+  bool is_imported = false;
+  RenderGraphImageDesc desc;
+  vk::ImageLayout initial_layout = vk::ImageLayout::eUndefined;
+  vk::ImageLayout final_layout = vk::ImageLayout::eUndefined;
+  vk::ImageUsageFlags usage;
+  vk::UniqueImage owned_image;
+  vk::UniqueImageView owned_image_view;
+  std::optional<size_t> memory_block;
+  vk::Image image;
+  vk::ImageView image_view;
+  vk::Buffer buffer;
+};
+
+// All uses of a resource by a single pass.
+struct PassAccess {
+  RenderGraphResource resource = 0u;
+  vk::PipelineStageFlags2 stages;
+  vk::AccessFlags2 read_access;
+  vk::AccessFlags2 write_access;
+  vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+  vk::ImageUsageFlags image_usage;
+  bool read = false;
+  bool write = false;
+  bool discard = false;
+};
+
+struct RenderGraph::Pass {
+  std::string name;
+  PassCallback callback;
+  std::vector<PassAccess> accesses;
+  bool has_side_effects = false;
+  bool is_live = false;
+};
+
+struct RenderGraph::Barrier {
+  RenderGraphResource resource = 0u;
+  vk::PipelineStageFlags2 src_stages;
+  vk::AccessFlags2 src_access;
+  vk::PipelineStageFlags2 dst_stages;
+  vk::AccessFlags2 dst_access;
+  vk::ImageLayout old_layout = vk::ImageLayout::eUndefined;
+  vk::ImageLayout new_layout = vk::ImageLayout::eUndefined;
+};
+
+struct RenderGraph::MemoryBlock {
+  vk::UniqueDeviceMemory memory;
+  vk::DeviceSize size = 0u;
+  uint32_t memory_type_bits = ~0u;
+  size_t last_use = 0u;
+  // In the order they are used in.
+  std::vector<RenderGraphResource> occupants;
+};
+
+struct UsageInfo {
+  vk::PipelineStageFlags2 stages;
+  vk::AccessFlags2 read_access;
+  vk::AccessFlags2 write_access;
+  vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+  vk::ImageUsageFlags image_usage;
+};
+
+static UsageInfo GetUsageInfo(RenderGraphUsage usage) {
+  using Stage = vk::PipelineStageFlagBits2;
+  using Access = vk::AccessFlagBits2;
+  using Layout = vk::ImageLayout;
+  using Usage = vk::ImageUsageFlagBits;
+  switch (usage) {
+    case RenderGraphUsage::kColorAttachment:
+      return {Stage::eColorAttachmentOutput, Access::eColorAttachmentRead,
+              Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal,
+              Usage::eColorAttachment};
+    case RenderGraphUsage::kDepthStencilAttachment:
+      return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+              Access::eDepthStencilAttachmentRead,
+              Access::eDepthStencilAttachmentWrite,
+              Layout::eDepthStencilAttachmentOptimal,
+              Usage::eDepthStencilAttachment};
+    case RenderGraphUsage::kSampled:
+      return {Stage::eFragmentShader | Stage::eComputeShader,
+              Access::eShaderSampledRead, {}, Layout::eShaderReadOnlyOptimal,
+              Usage::eSampled};
+    case RenderGraphUsage::kStorage:
+      return {Stage::eFragmentShader | Stage::eComputeShader,
+              Access::eShaderStorageRead, Access::eShaderStorageWrite,
+              Layout::eGeneral, Usage::eStorage};
+    case RenderGraphUsage::kUniformBuffer:
+      return {Stage::eVertexShader | Stage::eFragmentShader |
+                  Stage::eComputeShader,
+              Access::eUniformRead};
+    case RenderGraphUsage::kVertexBuffer:
+      return {Stage::eVertexAttributeInput, Access::eVertexAttributeRead};
+    case RenderGraphUsage::kIndexBuffer:
+      return {Stage::eIndexInput, Access::eIndexRead};
+    case RenderGraphUsage::kIndirectBuffer:
+      return {Stage::eDrawIndirect, Access::eIndirectCommandRead};
+    case RenderGraphUsage::kTransferSrc:
+      return {Stage::eTransfer, Access::eTransferRead, {},
+              Layout::eTransferSrcOptimal, Usage::eTransferSrc};
+    case RenderGraphUsage::kTransferDst:
+      return {Stage::eTransfer, {}, Access::eTransferWrite,
+              Layout::eTransferDstOptimal, Usage::eTransferDst};
+  }
+  FML_UNREACHABLE();
+}
+
+static vk::ImageAspectFlags GetAspectFlags(vk::Format format) {
+  switch (format) {
+    case vk::Format::eD16Unorm:
+    case vk::Format::eX8D24UnormPack32:
+    case vk::Format::eD32Sfloat:
+      return vk::ImageAspectFlagBits::eDepth;
+    case vk::Format::eS8Uint:
+      return vk::ImageAspectFlagBits::eStencil;
+    case vk::Format::eD16UnormS8Uint:
+    case vk::Format::eD24UnormS8Uint:
+    case vk::Format::eD32SfloatS8Uint:
+      return vk::ImageAspectFlagBits::eDepth |
+             vk::ImageAspectFlagBits::eStencil;
+    default:
+      return vk::ImageAspectFlagBits::eColor;
+  }
+}
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, size_t pass)
+    : graph_(graph), pass_(pass) {}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(
+    RenderGraphResource resource,
+    RenderGraphUsage usage) {
+  graph_.AddAccess(pass_, resource, usage, true, false, false);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(
+    RenderGraphResource resource,
+    RenderGraphUsage usage) {
+  graph_.AddAccess(pass_, resource, usage, false, true, false);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Overwrite(
+    RenderGraphResource resource,
+    RenderGraphUsage usage) {
+  graph_.AddAccess(pass_, resource, usage, false, true, true);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::HasSideEffects() {
+  graph_.passes_[pass_].has_side_effects = true;
+  return *this;
+}
+
+RenderGraph::RenderGraph(const std::shared_ptr<Context>& context)
+    : context_(context) {}
+
+RenderGraph::~RenderGraph() = default;
+
+RenderGraphResource RenderGraph::AddResource(Resource resource) {
+  FML_DCHECK(!is_compiled_);
+  resources_.emplace_back(std::move(resource));
+  return static_cast<RenderGraphResource>(resources_.size() - 1u);
+}
+
+RenderGraphResource RenderGraph::ImportImage(std::string name,
+                                             const RenderGraphImageDesc& desc,
+                                             vk::ImageLayout initial_layout,
+                                             vk::ImageLayout final_layout) {
+  Resource resource;
+  resource.name = std::move(name);
+  resource.is_imported = true;
+  resource.desc = desc;
+  resource.initial_layout = initial_layout;
+  resource.final_layout = final_layout;
+  return AddResource(std::move(resource));
+}
+
+RenderGraphResource RenderGraph::ImportBuffer(std::string name) {
+  Resource resource;
+  resource.name = std::move(name);
+  resource.is_image = false;
+  resource.is_imported = true;
+  return AddResource(std::move(resource));
+}
+
+RenderGraphResource RenderGraph::CreateImage(std::string name,
+                                             const RenderGraphImageDesc& desc) {
+  Resource resource;
+  resource.name = std::move(name);
+  resource.desc = desc;
+  return AddResource(std::move(resource));
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(std::string name,
+                                              PassCallback callback) {
+  FML_DCHECK(!is_compiled_);
+  Pass pass;
+  pass.name = std::move(name);
+  pass.callback = std::move(callback);
+  passes_.emplace_back(std::move(pass));
+  return PassBuilder(*this, passes_.size() - 1u);
+}
+
+void RenderGraph::AddAccess(size_t pass_index,
+                            RenderGraphResource resource,
+                            RenderGraphUsage usage,
+                            bool read,
+                            bool write,
+                            bool discard) {
+  FML_CHECK(resource < resources_.size());
+  auto& pass = passes_[pass_index];
+  auto access = std::find_if(
+      pass.accesses.begin(), pass.accesses.end(),
+      [&](const auto& other) { return other.resource == resource; });
+  const bool is_new = access == pass.accesses.end();
+  if (is_new) {
+    access = pass.accesses.emplace(pass.accesses.end());
+    access->resource = resource;
+  }
+
+  const auto info = GetUsageInfo(usage);
+  access->stages |= info.stages;
+  // Writes that keep the previous contents may also read them, e.g. loading
+  // an attachment or blending.
+  if (read || !discard) {
+    access->read_access |= info.read_access;
+  }
+  if (write) {
+    access->write_access |= info.write_access;
+  }
+  access->image_usage |= info.image_usage;
+  if (resources_[resource].is_image) {
+    FML_DCHECK(is_new || access->layout == info.layout)
+        << "A pass must use an image in a single layout.";
+    access->layout = info.layout;
+  }
+  access->discard = (is_new || access->discard) && discard;
+  access->read |= read;
+  access->write |= write;
+  if (access->read) {
+    access->discard = false;
+  }
+}
+
+bool RenderGraph::Compile() {
+  if (is_compiled_) {
+    return true;
+  }
+  auto context = context_.lock();
+  if (!context) {
+    return false;
+  }
+  CullPasses();
+  if (!AllocateTransientImages(context)) {
+    return false;
+  }
+  PlanBarriers();
+  is_compiled_ = true;
+  return true;
+}
+
+bool RenderGraph::IsCompiled() const {
+  return is_compiled_;
+}
+
+void RenderGraph::CullPasses() {
+  // Walk the passes backwards keeping track of which resources have contents
+  // that are still going to be used. Imported resources are used by whoever
+  // imported them once the graph is done.
+  std::vector<bool> needed(resources_.size());
+  for (size_t i = 0; i < resources_.size(); i++) {
+    needed[i] = resources_[i].is_imported;
+  }
+  for (auto pass = passes_.rbegin(); pass != passes_.rend(); ++pass) {
+    pass->is_live = pass->has_side_effects;
+    for (const auto& access : pass->accesses) {
+      if (access.write && needed[access.resource]) {
+        pass->is_live = true;
+      }
+    }
+    if (!pass->is_live) {
+      continue;
+    }
+    for (const auto& access : pass->accesses) {
+      if (access.discard) {
+        needed[access.resource] = false;
+      }
+    }
+    for (const auto& access : pass->accesses) {
+      if (access.read || (access.write && !access.discard)) {
+        needed[access.resource] = true;
+      }
+    }
+  }
+
+  live_passes_.clear();
+  for (size_t i = 0; i < passes_.size(); i++) {
+    if (passes_[i].is_live) {
+      live_passes_.push_back(i);
+    }
+  }
+}
+
+bool RenderGraph::AllocateTransientImages(
+    const std::shared_ptr<Context>& context) {
+  const auto& device = context->GetDevice();
+
+  // The range of live passes using each transient image. Images not used by
+  // any live pass are never created.
+  std::vector<std::optional<std::pair<size_t, size_t>>> lifetimes(
+      resources_.size());
+  std::vector<RenderGraphResource> transients;
+  for (size_t i = 0; i < live_passes_.size(); i++) {
+    for (const auto& access : passes_[live_passes_[i]].accesses) {
+      auto& resource = resources_[access.resource];
+      if (resource.is_imported) {
+        continue;
+      }
+      resource.usage |= access.image_usage;
+      auto& lifetime = lifetimes[access.resource];
+      if (!lifetime.has_value()) {
+        lifetime = {i, i};
+        transients.push_back(access.resource);
+      }
+      lifetime->second = i;
+    }
+  }
+
+  for (const auto transient : transients) {
+    auto& resource = resources_[transient];
+    const auto [first_use, last_use] = lifetimes[transient].value();
+
+    vk::ImageCreateInfo image_info;
+    image_info.imageType = vk::ImageType::e2D;
+    image_info.format = resource.desc.format;
+    image_info.extent = vk::Extent3D{resource.desc.extent.width,
+                                     resource.desc.extent.height, 1u};
+    image_info.mipLevels = 1u;
+    image_info.arrayLayers = 1u;
+    image_info.samples = vk::SampleCountFlagBits::e1;
+    image_info.tiling = vk::ImageTiling::eOptimal;
+    image_info.usage = resource.usage;
+    image_info.sharingMode = vk::SharingMode::eExclusive;
+    image_info.initialLayout = vk::ImageLayout::eUndefined;
+    auto [image_result, image] = device.createImageUnique(image_info);
+    if (image_result != vk::Result::eSuccess) {
+      FML_LOG(ERROR) << "Could not create transient image " << resource.name;
+      return false;
+    }
+    resource.owned_image = std::move(image);
+    resource.image = *resource.owned_image;
+
+    const auto requirements = device.getImageMemoryRequirements(resource.image);
+    unaliased_memory_size_ += requirements.size;
+
+    // Share memory with images that are done by the time this one is first
+    // used. Prefer the block that needs to grow the least.
+    std::optional<size_t> block_index;
+    vk::DeviceSize block_growth = 0u;
+    for (size_t i = 0; i < memory_blocks_.size(); i++) {
+      const auto& block = memory_blocks_[i];
+      if (block.last_use >= first_use ||
+          (block.memory_type_bits & requirements.memoryTypeBits) == 0u) {
+        continue;
+      }
+      const auto growth = std::max(block.size, requirements.size) - block.size;
+      if (!block_index.has_value() || growth < block_growth) {
+        block_index = i;
+        block_growth = growth;
+      }
+    }
+    if (!block_index.has_value()) {
+      block_index = memory_blocks_.size();
+      memory_blocks_.emplace_back();
+    }
+    auto& block = memory_blocks_[block_index.value()];
+    block.size = std::max(block.size, requirements.size);
+    block.memory_type_bits &= requirements.memoryTypeBits;
+    block.last_use = last_use;
+    block.occupants.push_back(transient);
+    resource.memory_block = block_index;
+  }
+
+  for (auto& block : memory_blocks_) {
+    const auto memory_type = context->FindMemoryTypeIndex(
+        block.memory_type_bits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if (!memory_type.has_value()) {
+      FML_LOG(ERROR) << "No device local memory for transient images.";
+      return false;
+    }
+    vk::MemoryAllocateInfo allocate_info;
+    allocate_info.allocationSize = block.size;
+    allocate_info.memoryTypeIndex = memory_type.value();
+    auto [memory_result, memory] = device.allocateMemoryUnique(allocate_info);
+    if (memory_result != vk::Result::eSuccess) {
+      return false;
+    }
+    block.memory = std::move(memory);
+
+    for (const auto occupant : block.occupants) {
+      auto& resource = resources_[occupant];
+      if (device.bindImageMemory(resource.image, *block.memory, 0u) !=
+          vk::Result::eSuccess) {
+        return false;
+      }
+
+      vk::ImageViewCreateInfo view_info;
+      view_info.image = resource.image;
+      view_info.viewType = vk::ImageViewType::e2D;
+      view_info.format = resource.desc.format;
+      view_info.subresourceRange.aspectMask =
+          GetAspectFlags(resource.desc.format);
+      view_info.subresourceRange.levelCount = 1u;
+      view_info.subresourceRange.layerCount = 1u;
+      auto [view_result, view] = device.createImageViewUnique(view_info);
+      if (view_result != vk::Result::eSuccess) {
+        return false;
+      }
+      resource.owned_image_view = std::move(view);
+      resource.image_view = *resource.owned_image_view;
+    }
+  }
+
+  return true;
+}
+
+void RenderGraph::PlanBarriers() {
+  struct State {
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    // The last write and the reads since.
+    vk::PipelineStageFlags2 write_stages;
+    vk::AccessFlags2 write_access;
+    vk::PipelineStageFlags2 read_stages;
+    // Where the last write has already been made visible.
+    vk::PipelineStageFlags2 visible_stages;
+    vk::AccessFlags2 visible_access;
+  };
+
+  // Every use of a transient image must be done before the next image placed
+  // in the same memory is first used. For the first image in a block, that
+  // is the last one from the previous execution of the graph.
+  std::vector<vk::PipelineStageFlags2> used_stages(resources_.size());
+  std::vector<vk::AccessFlags2> used_writes(resources_.size());
+  for (const auto pass : live_passes_) {
+    for (const auto& access : passes_[pass].accesses) {
+      used_stages[access.resource] |= access.stages;
+      used_writes[access.resource] |= access.write_access;
+    }
+  }
+
+  std::vector<State> states(resources_.size());
+  for (size_t i = 0; i < resources_.size(); i++) {
+    const auto& resource = resources_[i];
+    auto& state = states[i];
+    if (resource.is_imported) {
+      // Earlier submissions may still be writing to imported images in use.
+      // Host writes to imported buffers are visible once submitted.
+      state.layout = resource.initial_layout;
+      if (resource.is_image &&
+          resource.initial_layout != vk::ImageLayout::eUndefined) {
+        state.write_stages = vk::PipelineStageFlagBits2::eAllCommands;
+        state.write_access = vk::AccessFlagBits2::eMemoryWrite;
+      }
+    } else if (resource.memory_block.has_value()) {
+      const auto& occupants =
+          memory_blocks_[resource.memory_block.value()].occupants;
+      const auto position = std::find(occupants.begin(), occupants.end(), i);
+      const auto previous = position == occupants.begin()
+                                ? occupants.back()
+                                : *std::prev(position);
+      state.write_stages = used_stages[previous];
+      state.write_access = used_writes[previous];
+    }
+  }
+
+  barriers_.assign(live_passes_.size() + 1u, {});
+  for (size_t i = 0; i < live_passes_.size(); i++) {
+    for (const auto& access : passes_[live_passes_[i]].accesses) {
+      const auto& resource = resources_[access.resource];
+      auto& state = states[access.resource];
+      const auto dst_access = access.read_access | access.write_access;
+      const bool transition =
+          resource.is_image && state.layout != access.layout;
+
+      Barrier barrier;
+      barrier.resource = access.resource;
+      barrier.dst_stages = access.stages;
+      barrier.old_layout = state.layout;
+      barrier.new_layout = access.layout;
+
+      if (transition || access.write) {
+        // Everything since the last write must be done before the contents
+        // are modified or moved to another layout.
+        barrier.src_stages = state.write_stages | state.read_stages;
+        barrier.src_access = state.write_access;
+        barrier.dst_access = dst_access;
+        if (access.discard) {
+          barrier.old_layout = vk::ImageLayout::eUndefined;
+        }
+        if (transition || barrier.src_stages) {
+          barriers_[i].push_back(barrier);
+        }
+        // Layout transitions are writes made visible to the pass's stages.
+        state.layout = access.layout;
+        state.write_stages = access.stages;
+        state.write_access = access.write_access;
+        state.read_stages = {};
+        state.visible_stages = access.stages;
+        state.visible_access = dst_access;
+        continue;
+      }
+
+      const bool visible =
+          (state.visible_stages & access.stages) == access.stages &&
+          (state.visible_access & access.read_access) == access.read_access;
+      if (state.write_stages && !visible) {
+        barrier.src_stages = state.write_stages;
+        barrier.src_access = state.write_access;
+        barrier.dst_access = access.read_access;
+        barriers_[i].push_back(barrier);
+        state.visible_stages |= access.stages;
+        state.visible_access |= access.read_access;
+      }
+      state.read_stages |= access.stages;
+    }
+  }
+
+  // Move imported images to the layout expected after the graph. Later
+  // commands on the queue chain onto the transition through all commands.
+  for (size_t i = 0; i < resources_.size(); i++) {
+    const auto& resource = resources_[i];
+    const auto& state = states[i];
+    if (!resource.is_imported || !resource.is_image ||
+        resource.final_layout == vk::ImageLayout::eUndefined ||
+        resource.final_layout == state.layout) {
+      continue;
+    }
+    Barrier barrier;
+    barrier.resource = static_cast<RenderGraphResource>(i);
+    barrier.src_stages = state.write_stages | state.read_stages;
+    barrier.src_access = state.write_access;
+    barrier.dst_stages = vk::PipelineStageFlagBits2::eAllCommands;
+    barrier.old_layout = state.layout;
+    barrier.new_layout = resource.final_layout;
+    barriers_.back().push_back(barrier);
+  }
+}
+
+void RenderGraph::SetImportedImage(RenderGraphResource resource,
+                                   const vk::Image& image,
+                                   const vk::ImageView& image_view) {
+  FML_CHECK(resource < resources_.size());
+  auto& imported = resources_[resource];
+  FML_DCHECK(imported.is_imported && imported.is_image);
+  imported.image = image;
+  imported.image_view = image_view;
+}
+
+void RenderGraph::SetImportedBuffer(RenderGraphResource resource,
+                                    const vk::Buffer& buffer) {
+  FML_CHECK(resource < resources_.size());
+  auto& imported = resources_[resource];
+  FML_DCHECK(imported.is_imported && !imported.is_image);
+  imported.buffer = buffer;
+}
+
+vk::Image RenderGraph::GetImage(RenderGraphResource resource) const {
+  FML_CHECK(resource < resources_.size());
+  return resources_[resource].image;
+}
+
+vk::ImageView RenderGraph::GetImageView(RenderGraphResource resource) const {
+  FML_CHECK(resource < resources_.size());
+  return resources_[resource].image_view;
+}
+
+vk::Buffer RenderGraph::GetBuffer(RenderGraphResource resource) const {
+  FML_CHECK(resource < resources_.size());
+  return resources_[resource].buffer;
+}
+
+bool RenderGraph::Execute(const vk::CommandBuffer& command_buffer) {
+  if (!is_compiled_) {
+    FML_LOG(ERROR) << "Render graph must be compiled before it is executed.";
+    return false;
+  }
+  for (const auto& resource : resources_) {
+    if (resource.is_imported && !resource.image && !resource.buffer) {
+      FML_LOG(ERROR) << "Imported resource " << resource.name << " is unset.";
+      return false;
+    }
+  }
+  for (size_t i = 0; i < live_passes_.size(); i++) {
+    RecordBarriers(command_buffer, barriers_[i]);
+    const auto& pass = passes_[live_passes_[i]];
+    if (pass.callback) {
+      pass.callback(command_buffer);
+    }
+  }
+  RecordBarriers(command_buffer, barriers_.back());
+  return true;
+}
+
+void RenderGraph::RecordBarriers(const vk::CommandBuffer& command_buffer,
+                                 const std::vector<Barrier>& barriers) {
+  if (barriers.empty()) {
+    return;
+  }
+  // Reuses the storage from earlier executions.
+  image_barriers_.clear();
+  buffer_barriers_.clear();
+  for (const auto& barrier : barriers) {
+    const auto& resource = resources_[barrier.resource];
+    if (resource.is_image) {
+      auto& image_barrier = image_barriers_.emplace_back();
+      image_barrier.srcStageMask = barrier.src_stages;
+      image_barrier.srcAccessMask = barrier.src_access;
+      image_barrier.dstStageMask = barrier.dst_stages;
+      image_barrier.dstAccessMask = barrier.dst_access;
+      image_barrier.oldLayout = barrier.old_layout;
+      image_barrier.newLayout = barrier.new_layout;
+      image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      image_barrier.image = resource.image;
+      image_barrier.subresourceRange.aspectMask =
+          GetAspectFlags(resource.desc.format);
+      image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+      image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    } else {
+      auto& buffer_barrier = buffer_barriers_.emplace_back();
+      buffer_barrier.srcStageMask = barrier.src_stages;
+      buffer_barrier.srcAccessMask = barrier.src_access;
+      buffer_barrier.dstStageMask = barrier.dst_stages;
+      buffer_barrier.dstAccessMask = barrier.dst_access;
+      buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      buffer_barrier.buffer = resource.buffer;
+      buffer_barrier.offset = 0u;
+      buffer_barrier.size = VK_WHOLE_SIZE;
+    }
+  }
+  vk::DependencyInfo dependency_info;
+  dependency_info.setImageMemoryBarriers(image_barriers_);
+  dependency_info.setBufferMemoryBarriers(buffer_barriers_);
+  command_buffer.pipelineBarrier2(dependency_info);
+}
+
+bool RenderGraph::IsPassCulled(const std::string& name) const {
+  for (const auto& pass : passes_) {
+    if (pass.name == name) {
+      return !pass.is_live;
+    }
+  }
+  return true;
+}
+
+size_t RenderGraph::GetBarrierCount() const {
+  size_t count = 0u;
+  for (const auto& barriers : barriers_) {
+    count += barriers.size();
+  }
+  return count;
+}
+
+vk::DeviceSize RenderGraph::GetTransientMemorySize() const {
+  vk::DeviceSize size = 0u;
+  for (const auto& block : memory_blocks_) {
+    size += block.size;
+  }
+  return size;
+}
+
+vk::DeviceSize RenderGraph::GetUnaliasedTransientMemorySize() const {
+  return unaliased_memory_size_;
+}
+
+}  // namespace one
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "fml/macros.h"
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+using RenderGraphResource = uint32_t;
+
+enum class RenderGraphUsage {
+  kColorAttachment,
+  kDepthStencilAttachment,
+  kSampled,
+  kStorage,
+  kUniformBuffer,
+  kVertexBuffer,
+  kIndexBuffer,
+  kIndirectBuffer,
+  kTransferSrc,
+  kTransferDst,
+};
+
+struct RenderGraphImageDesc {
+  vk::Format format = vk::Format::eUndefined;
+  vk::Extent2D extent;
+};
+
+// Describes a frame as a list of passes and the images and buffers each of
+// them reads and writes. Compiling the graph culls passes whose results are
+// never used, works out the barriers and layout transitions between passes,
+// and places transient images whose lifetimes don't overlap in the same
+// memory.
+//
+// A graph is built and compiled once and then executed every frame. Imported
+// resources may be swapped out between executions, e.g. for the acquired
+// swapchain image.
+class RenderGraph {
+ public:
+  using PassCallback = std::function<void(const vk::CommandBuffer&)>;
+
+  class PassBuilder {
+   public:
+    // The pass reads the resource.
+    PassBuilder& Read(RenderGraphResource resource, RenderGraphUsage usage);
+
+    // The pass modifies the resource and so depends on its previous contents.
+    PassBuilder& Write(RenderGraphResource resource, RenderGraphUsage usage);
+
+    // The pass replaces all of the contents of the resource. Earlier writes
+    // are discarded.
+    PassBuilder& Overwrite(RenderGraphResource resource,
+                           RenderGraphUsage usage);
+
+    // The pass is never culled, even if nothing reads what it writes.
+    PassBuilder& HasSideEffects();
+
+   private:
+    friend class RenderGraph;
+
+    RenderGraph& graph_;
+    size_t pass_;
+
+    PassBuilder(RenderGraph& graph, size_t pass);
+  };
+
+  explicit RenderGraph(const std::shared_ptr<Context>& context);
+
+  ~RenderGraph();
+
+  // Imported images are owned outside the graph. Their contents are always
+  // considered used after the graph is executed.
+  RenderGraphResource ImportImage(std::string name,
+                                  const RenderGraphImageDesc& desc,
+                                  vk::ImageLayout initial_layout,
+                                  vk::ImageLayout final_layout);
+
+  RenderGraphResource ImportBuffer(std::string name);
+
+  // Transient images are created by the graph and only live while it is
+  // executed. Their contents are undefined before the first pass writes to
+  // them.
+  RenderGraphResource CreateImage(std::string name,
+                                  const RenderGraphImageDesc& desc);
+
+  PassBuilder AddPass(std::string name, PassCallback callback);
+
+  bool Compile();
+
+  bool IsCompiled() const;
+
+  void SetImportedImage(RenderGraphResource resource,
+                        const vk::Image& image,
+                        const vk::ImageView& image_view = {});
+
+  void SetImportedBuffer(RenderGraphResource resource,
+                         const vk::Buffer& buffer);
+
+  // Only valid while the graph is executed.
+  vk::Image GetImage(RenderGraphResource resource) const;
+
+  vk::ImageView GetImageView(RenderGraphResource resource) const;
+
+  vk::Buffer GetBuffer(RenderGraphResource resource) const;
+
+  // Records the barriers and passes. Imported images end in their final
+  // layout.
+  bool Execute(const vk::CommandBuffer& command_buffer);
+
+  bool IsPassCulled(const std::string& name) const;
+
+  size_t GetBarrierCount() const;
+
+  // The memory backing transient images, with and without aliasing.
+  vk::DeviceSize GetTransientMemorySize() const;
+
+  vk::DeviceSize GetUnaliasedTransientMemorySize() const;
+
+ private:
+  struct Resource;
+  struct Pass;
+  struct Barrier;
+  struct MemoryBlock;
+
+  std::weak_ptr<Context> context_;
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  std::vector<size_t> live_passes_;
+  // Barriers recorded before each live pass and after the last one.
+  std::vector<std::vector<Barrier>> barriers_;
+  std::vector<MemoryBlock> memory_blocks_;
+  std::vector<vk::ImageMemoryBarrier2> image_barriers_;
+  std::vector<vk::BufferMemoryBarrier2> buffer_barriers_;
+  vk::DeviceSize unaliased_memory_size_ = 0u;
+  bool is_compiled_ = false;
+
+  RenderGraphResource AddResource(Resource resource);
+
+  void AddAccess(size_t pass,
+                 RenderGraphResource resource,
+                 RenderGraphUsage usage,
+                 bool read,
+                 bool write,
+                 bool discard);
+
+  void CullPasses();
+
+  bool AllocateTransientImages(const std::shared_ptr<Context>& context);
+
+  void PlanBarriers();
+
+  void RecordBarriers(const vk::CommandBuffer& command_buffer,
+                      const std::vector<Barrier>& barriers);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(RenderGraph);
+};
+
+}  // namespace one
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <optional>
+
+#include "vk.h"
+
+namespace one {
+
+// Something frames are rendered into, either a swapchain or a headless ring
+// of images. Rendering a frame is split into phases so a FrameScheduler can
+// render many targets with one submission and one present.
+class RenderTarget {
+ public:
+  struct Frame {
+    vk::CommandBuffer command_buffer;
+    // Signaled by the submission for targets that present.
+    vk::Semaphore render_semaphore;
+    vk::SwapchainKHR swapchain;
+    uint32_t image_index = 0u;
+    // The VK_KHR_present_id ID to present with. Zero for none.
+    uint64_t present_id = 0u;
+  };
+
+  virtual ~RenderTarget() = default;
+
+  virtual bool IsValid() const = 0;
+
+  // Waits till the GPU is done with the next frame slot and acquires an image
+  // to render into.
+  virtual std::optional<Frame> AcquireFrame() = 0;
+
+  // Records the acquired frame into its command buffer. Different targets may
+  // record concurrently on different threads.
+  virtual bool RecordFrame() = 0;
+
+  // Recording the acquired frame failed. Targets that must hand the acquired
+  // image back, like swapchains, record a frame that only does that and
+  // return true. That frame is then submitted and presented as usual. Others
+  // return false and the frame is dropped.
+  virtual bool RecordReleaseFrame() = 0;
+
+  // The frame's command buffer has been submitted.
+  virtual void FrameSubmitted(uint64_t timeline_value) = 0;
+
+  // Submitting the frame's command buffer failed.
+  virtual void FrameDiscarded() = 0;
+};
+
+}  // namespace one
@@ -2,6 +2,7 @@
 #include <xatomic.h>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <memory>
 #include <optional>
@@ -18,7 +19,20 @@ namespace one {
 
 class Swapchain::Synchronizer {
  public:
-  Synchronizer(const vk::Device& device) {
+  Synchronizer(const vk::Device& device, const vk::CommandPool& pool) {
+    {
+      vk::CommandBufferAllocateInfo command_buffer_info;
+      command_buffer_info.commandPool = pool;
+      command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+      command_buffer_info.commandBufferCount = 1u;
+      auto [result, command_buffers] =
+          device.allocateCommandBuffersUnique(command_buffer_info);
+      if (result != vk::Result::eSuccess) {
+        return;
+      }
+      command_buffer_ = std::move(command_buffers.front());
+    }
+
     {
       vk::FenceCreateInfo fence_info;
       auto [result, acquire_fence] = device.createFenceUnique(fence_info);
@@ -43,12 +57,18 @@ class Swapchain::Synchronizer {
 
   bool IsValid() const { return is_valid_; }
 
+  const vk::CommandBuffer& GetCommandBuffer() const { return *command_buffer_; }
+
   const vk::Fence& GetAcquireFence() const { return *acquire_fence_; }
 
   const vk::Semaphore& GetPresentWaitSemaphore() const {
     return *present_wait_sema_;
   }
 
+  uint64_t GetLastTimelineValue() const { return last_timeline_value_; }
+
+  void SetLastTimelineValue(uint64_t value) { last_timeline_value_ = value; }
+
   bool WaitAndResetAcquireFence() const {
     using namespace std::chrono_literals;
     constexpr auto timeout_ns = std::chrono::nanoseconds(10s).count();
@@ -64,13 +84,18 @@ class Swapchain::Synchronizer {
   }
 
  private:
+  vk::UniqueCommandBuffer command_buffer_;
   vk::UniqueFence acquire_fence_;
   vk::UniqueSemaphore present_wait_sema_;
+  uint64_t last_timeline_value_ = 0u;
   bool is_valid_ = false;
 
   FML_DISALLOW_COPY_AND_ASSIGN(Synchronizer);
 };
 
+static constexpr size_t kFrameHostBlockSize = 64u * 1024u;
+static constexpr vk::DeviceSize kFrameDeviceSize = 1024u * 1024u;
+
 static std::optional<vk::SurfaceFormatKHR> PickSurfaceFormat(
     const std::vector<vk::SurfaceFormatKHR>& formats) {
   for (const auto& format : formats) {
@@ -111,23 +136,79 @@ constexpr vk::CompositeAlphaFlagBitsKHR Pick(
   return vk::CompositeAlphaFlagBitsKHR::eInherit;
 }
 
-static vk::PresentModeKHR Pick(
-    const std::vector<vk::PresentModeKHR>& supported_vec) {
-  std::set<vk::PresentModeKHR> supported;
-  for (const auto& mode : supported_vec) {
-    supported.insert(mode);
-  }
-  if (supported.contains(vk::PresentModeKHR::eMailbox)) {
-    return vk::PresentModeKHR::eMailbox;
+struct PresentPolicyInfo {
+  // In order of preference. FIFO is always supported so it comes last.
+  std::array<vk::PresentModeKHR, 4> present_modes;
+  // Images beyond the minimum the surface needs.
+  uint32_t extra_images = 0u;
+  // How many frames the CPU may run ahead of the display in FIFO modes when
+  // present wait is available. Zero leaves it unbounded.
+  uint64_t max_frames_ahead = 0u;
+};
+
+static PresentPolicyInfo GetPresentPolicyInfo(PresentPolicy policy) {
+  using Mode = vk::PresentModeKHR;
+  switch (policy) {
+    case PresentPolicy::kLowLatency:
+      // Never immediate, which tears.
+      return {{Mode::eMailbox, Mode::eFifo, Mode::eFifo, Mode::eFifo}, 1u, 1u};
+    case PresentPolicy::kThroughput:
+      return {{Mode::eImmediate, Mode::eMailbox, Mode::eFifoRelaxed,
+               Mode::eFifo},
+              2u,
+              0u};
+    case PresentPolicy::kPowerSaving:
+      return {{Mode::eFifo, Mode::eFifo, Mode::eFifo, Mode::eFifo}, 0u, 2u};
   }
-  if (supported.contains(VULKAN_HPP_NAMESPACE::PresentModeKHR::eFifo)) {
-    return vk::PresentModeKHR::eFifo;
+  FML_UNREACHABLE();
+}
+
+vk::PresentModeKHR Swapchain::PickPresentMode(
+    PresentPolicy policy,
+    const std::vector<vk::PresentModeKHR>& supported) {
+  for (const auto mode : GetPresentPolicyInfo(policy).present_modes) {
+    if (std::find(supported.begin(), supported.end(), mode) !=
+        supported.end()) {
+      return mode;
+    }
   }
   return vk::PresentModeKHR::eFifo;
 }
 
+uint32_t Swapchain::PickImageCount(PresentPolicy policy,
+                                   const vk::SurfaceCapabilitiesKHR& caps) {
+  const auto count =
+      caps.minImageCount + GetPresentPolicyInfo(policy).extra_images;
+  if (caps.maxImageCount == 0u) {
+    return count;
+  }
+  return std::min(count, caps.maxImageCount);
+}
+
+uint64_t Swapchain::PickMaxFramesAhead(PresentPolicy policy,
+                                       vk::PresentModeKHR mode) {
+  switch (mode) {
+    case vk::PresentModeKHR::eFifo:
+    case vk::PresentModeKHR::eFifoRelaxed:
+      return GetPresentPolicyInfo(policy).max_frames_ahead;
+    default:
+      // Mailbox and immediate don't queue frames. Waiting on the display
+      // would only tie the CPU to vblank.
+      return 0u;
+  }
+}
+
+uint64_t Swapchain::GetPresentWaitID(uint64_t frame,
+                                     uint64_t max_frames_ahead) {
+  if (max_frames_ahead == 0u || frame <= max_frames_ahead) {
+    return 0u;
+  }
+  return frame - max_frames_ahead;
+}
+
 Swapchain::Swapchain(const std::shared_ptr<Context>& context,
-                     vk::UniqueSurfaceKHR p_surface)
+                     vk::UniqueSurfaceKHR p_surface,
+                     PresentPolicy policy)
     : surface_(std::move(p_surface)), context_(context) {
   const auto [surface_caps_result, surface_caps] =
       context->GetPhysicalDevice().getSurfaceCapabilitiesKHR(*surface_);
@@ -161,23 +242,28 @@ Swapchain::Swapchain(const std::shared_ptr<Context>& context,
     return;
   }
 
+  // Capturing frames needs the images to be copied from.
+  supports_capture_ = static_cast<bool>(
+      surface_caps.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+
   vk::SwapchainCreateInfoKHR swapchain_info;
 
   swapchain_info.flags = {};
   swapchain_info.surface = surface_.get();
-  swapchain_info.minImageCount = std::clamp(
-      surface_caps.minImageCount + 1, surface_caps.minImageCount,
-      surface_caps.maxImageCount == 0u ? surface_caps.minImageCount + 1u
-                                       : surface_caps.maxImageCount);
+  swapchain_info.minImageCount = PickImageCount(policy, surface_caps);
   swapchain_info.imageFormat = surface_format->format;
   swapchain_info.imageColorSpace = surface_format->colorSpace;
   swapchain_info.imageExtent = surface_caps.currentExtent;
   swapchain_info.imageArrayLayers = 1u;
   swapchain_info.imageUsage = kSwapchainImageUsage;
+  if (supports_capture_) {
+    swapchain_info.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+  }
   swapchain_info.imageSharingMode = vk::SharingMode::eExclusive;
   swapchain_info.preTransform = Pick(surface_caps.supportedTransforms);
   swapchain_info.compositeAlpha = Pick(surface_caps.supportedCompositeAlpha);
-  swapchain_info.presentMode = Pick(surface_present_modes);
+  swapchain_info.presentMode =
+      PickPresentMode(policy, surface_present_modes);
   swapchain_info.clipped = false;
   swapchain_info.oldSwapchain = nullptr;
 
@@ -187,6 +273,24 @@ Swapchain::Swapchain(const std::shared_ptr<Context>& context,
     return;
   }
   swapchain_ = std::move(swapchain);
+  extent_ = swapchain_info.imageExtent;
+  format_ = swapchain_info.imageFormat;
+  present_mode_ = swapchain_info.presentMode;
+  if (context->SupportsPresentWait()) {
+    max_frames_ahead_ = PickMaxFramesAhead(policy, present_mode_);
+  }
+
+  {
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    pool_info.queueFamilyIndex = context->GetQueueIndex().family;
+    auto [result, pool] =
+        context->GetDevice().createCommandPoolUnique(pool_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    command_pool_ = std::move(pool);
+  }
 
   auto [images_result, images] =
       context->GetDevice().getSwapchainImagesKHR(*swapchain_);
@@ -197,7 +301,7 @@ Swapchain::Swapchain(const std::shared_ptr<Context>& context,
 
   for (const auto& image : images_) {
     synchronizers_.emplace_back(
-        std::make_unique<Synchronizer>(context->GetDevice()));
+        std::make_unique<Synchronizer>(context->GetDevice(), *command_pool_));
     if (!synchronizers_.back()->IsValid()) {
       return;
     }
@@ -205,61 +309,281 @@ Swapchain::Swapchain(const std::shared_ptr<Context>& context,
 
   FML_CHECK(synchronizers_.size() == images_.size());
 
+  render_graph_ = std::make_unique<RenderGraph>(context);
+  swapchain_image_ = render_graph_->ImportImage(
+      "swapchain", RenderGraphImageDesc{format_, extent_},
+      vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR);
+  render_graph_
+      ->AddPass("clear",
+                [this](const vk::CommandBuffer& command_buffer) {
+                  vk::ImageSubresourceRange range;
+                  range.aspectMask = vk::ImageAspectFlagBits::eColor;
+                  range.levelCount = 1u;
+                  range.layerCount = 1u;
+                  command_buffer.clearColorImage(
+                      render_graph_->GetImage(swapchain_image_),
+                      vk::ImageLayout::eTransferDstOptimal,
+                      vk::ClearColorValue{}, range);
+                })
+      .Overwrite(swapchain_image_, RenderGraphUsage::kTransferDst);
+  // Add the rendering passes here.
+  if (!render_graph_->Compile()) {
+    return;
+  }
+
+  frame_allocator_ = std::make_unique<FrameAllocator>(
+      context, synchronizers_.size(), kFrameHostBlockSize, kFrameDeviceSize);
+  if (!frame_allocator_->IsValid()) {
+    return;
+  }
+
   is_valid_ = true;
 }
 
-Swapchain::~Swapchain() = default;
+Swapchain::~Swapchain() {
+  if (auto context = context_.lock()) {
+    for (const auto& sync : synchronizers_) {
+      context->WaitForTimelineValue(sync->GetLastTimelineValue());
+    }
+  }
+}
 
 bool Swapchain::IsValid() const {
   return is_valid_;
 }
 
+vk::PresentModeKHR Swapchain::GetPresentMode() const {
+  return present_mode_;
+}
+
+uint64_t Swapchain::GetMaxFramesAhead() const {
+  return max_frames_ahead_;
+}
+
+FrameAllocator& Swapchain::GetFrameAllocator() {
+  return *frame_allocator_;
+}
+
+bool Swapchain::SetCaptureCallback(Readback::Callback callback) {
+  if (!callback) {
+    capture_callback_ = nullptr;
+    return true;
+  }
+  if (!supports_capture_ || !Readback::IsSupportedFormat(format_)) {
+    FML_LOG(ERROR) << "Swapchain images cannot be captured.";
+    return false;
+  }
+  if (!readback_) {
+    auto context = context_.lock();
+    if (!context) {
+      return false;
+    }
+    // One more buffer than the swapchain images so that capture keeps up as
+    // long as the callbacks are quicker than a frame.
+    readback_ = Readback::Make(context, images_.size() + 1u,
+                               extent_.width * extent_.height * 4u);
+    if (!readback_) {
+      return false;
+    }
+  }
+  capture_callback_ = std::move(callback);
+  return true;
+}
+
 bool Swapchain::Render() {
   auto context = context_.lock();
   if (!context) {
     return false;
   }
 
+  const auto frame = AcquireFrame();
+  if (!frame.has_value()) {
+    return false;
+  }
+  const auto recorded = RecordFrame();
+  if (!recorded && !RecordReleaseFrame()) {
+    return false;
+  }
+
+  {
+    vk::SubmitInfo submit_info;
+    submit_info.setCommandBuffers(frame->command_buffer);
+    submit_info.setSignalSemaphores(frame->render_semaphore);
+    const auto timeline_value = context->Submit(submit_info);
+    if (!timeline_value.has_value()) {
+      FrameDiscarded();
+      return false;
+    }
+    FrameSubmitted(timeline_value.value());
+  }
+
+  {
+    vk::PresentInfoKHR present_info;
+    present_info.setWaitSemaphores(frame->render_semaphore);
+    present_info.setSwapchains(frame->swapchain);
+    present_info.setImageIndices(frame->image_index);
+    vk::PresentIdKHR present_id;
+    if (frame->present_id != 0u) {
+      present_id.setPresentIds(frame->present_id);
+      present_info.pNext = &present_id;
+    }
+    if (context->Present(present_info) != vk::Result::eSuccess) {
+      return false;
+    }
+  }
+
+  return recorded;
+}
+
+std::optional<RenderTarget::Frame> Swapchain::AcquireFrame() {
+  auto context = context_.lock();
+  if (!context) {
+    return std::nullopt;
+  }
+
   const auto& device = context->GetDevice();
 
   frame_count_++;
 
-  const auto& sync = synchronizers_.at(frame_count_ % synchronizers_.size());
+  const auto frame_index = frame_count_ % synchronizers_.size();
+  const auto& sync = synchronizers_.at(frame_index);
+
+  // The GPU must be done with the last frame that used these synchronizers
+  // before they can be reused.
+  if (!context->WaitForTimelineValue(sync->GetLastTimelineValue())) {
+    return std::nullopt;
+  }
+
+  frame_allocator_->BeginFrame(frame_index);
+
+  context->GetDeletionQueue().Collect(context->GetCompletedTimelineValue());
 
   using namespace std::chrono_literals;
   static constexpr auto kTimeoutNS = std::chrono::nanoseconds(10s);
 
+  // Frames are presented with their frame count as the ID. Don't start on
+  // this one till the display has caught up.
+  if (const auto wait_id = GetPresentWaitID(frame_count_, max_frames_ahead_);
+      wait_id != 0u) {
+    const auto wait_result =
+        device.waitForPresentKHR(*swapchain_, wait_id, kTimeoutNS.count());
+    if (wait_result != vk::Result::eSuccess &&
+        wait_result != vk::Result::eTimeout) {
+      return std::nullopt;
+    }
+  }
+
   const auto [acquire_result, index] = device.acquireNextImageKHR(
       *swapchain_, kTimeoutNS.count(), {}, sync->GetAcquireFence());
   if (acquire_result != vk::Result::eSuccess) {
-    return false;
+    return std::nullopt;
   }
 
   if (!sync->WaitAndResetAcquireFence()) {
-    return false;
+    return std::nullopt;
+  }
+
+  acquired_frame_index_ = frame_index;
+  acquired_image_index_ = index;
+
+  Frame frame;
+  frame.command_buffer = sync->GetCommandBuffer();
+  frame.render_semaphore = sync->GetPresentWaitSemaphore();
+  frame.swapchain = *swapchain_;
+  frame.image_index = index;
+  if (context->SupportsPresentWait()) {
+    frame.present_id = frame_count_;
   }
+  return frame;
+}
 
-  // Do the rendering here.
+bool Swapchain::RecordFrame() {
+  const auto& sync = synchronizers_.at(acquired_frame_index_);
+  const auto& command_buffer = sync->GetCommandBuffer();
+  const auto& image = images_.at(acquired_image_index_);
+
+  if (command_buffer.reset() != vk::Result::eSuccess) {
+    return false;
+  }
 
   {
-    vk::SubmitInfo submit_info;
-    submit_info.setSignalSemaphores(sync->GetPresentWaitSemaphore());
-    if (context->GetQueue().submit(submit_info) != vk::Result::eSuccess) {
+    vk::CommandBufferBeginInfo begin_info;
+    begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    if (command_buffer.begin(begin_info) != vk::Result::eSuccess) {
       return false;
     }
   }
 
-  {
-    vk::PresentInfoKHR present_info;
-    present_info.setWaitSemaphores(sync->GetPresentWaitSemaphore());
-    present_info.setSwapchains(*swapchain_);
-    present_info.setImageIndices(index);
-    if (context->GetQueue().presentKHR(present_info) != vk::Result::eSuccess) {
-      return false;
+  render_graph_->SetImportedImage(swapchain_image_, image);
+  if (!render_graph_->Execute(command_buffer)) {
+    return false;
+  }
+
+  if (capture_callback_) {
+    readback_->Record(command_buffer, image, vk::ImageLayout::ePresentSrcKHR,
+                      extent_, format_, capture_callback_);
+  }
+
+  if (command_buffer.end() != vk::Result::eSuccess ||
+      !frame_allocator_->EndFrame()) {
+    if (readback_) {
+      readback_->Discard();
     }
+    return false;
   }
 
-  return false;
+  return true;
+}
+
+bool Swapchain::RecordReleaseFrame() {
+  if (readback_) {
+    readback_->Discard();
+  }
+
+  // The image can only be given back by presenting it, so present it as is.
+  const auto& command_buffer =
+      synchronizers_.at(acquired_frame_index_)->GetCommandBuffer();
+  if (command_buffer.reset() != vk::Result::eSuccess) {
+    return false;
+  }
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  if (command_buffer.begin(begin_info) != vk::Result::eSuccess) {
+    return false;
+  }
+
+  vk::ImageMemoryBarrier2 barrier;
+  barrier.oldLayout = vk::ImageLayout::eUndefined;
+  barrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = images_.at(acquired_image_index_);
+  barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+  barrier.subresourceRange.levelCount = 1u;
+  barrier.subresourceRange.layerCount = 1u;
+  vk::DependencyInfo dependency_info;
+  dependency_info.setImageMemoryBarriers(barrier);
+  command_buffer.pipelineBarrier2(dependency_info);
+
+  return command_buffer.end() == vk::Result::eSuccess;
+}
+
+void Swapchain::FrameSubmitted(uint64_t timeline_value) {
+  synchronizers_.at(acquired_frame_index_)->SetLastTimelineValue(
+      timeline_value);
+  if (readback_) {
+    readback_->Submitted(timeline_value);
+    readback_->Poll();
+  }
+}
+
+void Swapchain::FrameDiscarded() {
+  // The acquired image stays acquired. Submissions usually only fail once the
+  // device is lost, after which the swapchain must be recreated anyway.
+  if (readback_) {
+    readback_->Discard();
+  }
 }
 
 }  // namespace one
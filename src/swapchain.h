@@ -2,8 +2,13 @@
 
 #include <chrono>
 #include <memory>
+#include <vector>
 
 #include "fml/macros.h"
+#include "frame_allocator.h"
+#include "readback.h"
+#include "render_graph.h"
+#include "render_target.h"
 #include "vk.h"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
@@ -13,26 +18,100 @@ namespace one {
 
 class Context;
 
-class Swapchain {
+// Trades latency against frame rate and power. Each policy picks a present
+// mode and image count, and, where VK_KHR_present_wait is available, bounds
+// how far the CPU runs ahead of the display.
+enum class PresentPolicy {
+  // Mailbox, else FIFO with the CPU at most a frame ahead. Never tears.
+  kLowLatency,
+  // Immediate, else mailbox, with extra images and no bound.
+  kThroughput,
+  // FIFO with as few images as the surface allows.
+  kPowerSaving,
+};
+
+class Swapchain final : public RenderTarget {
  public:
   Swapchain(const std::shared_ptr<Context>& context,
-            vk::UniqueSurfaceKHR surface);
+            vk::UniqueSurfaceKHR surface,
+            PresentPolicy policy = PresentPolicy::kLowLatency);
+
+  ~Swapchain() override;
+
+  // |RenderTarget|
+  bool IsValid() const override;
+
+  // The first present mode the policy prefers that is supported.
+  static vk::PresentModeKHR PickPresentMode(
+      PresentPolicy policy,
+      const std::vector<vk::PresentModeKHR>& supported);
+
+  // The policy's extra images over the surface minimum, within its maximum.
+  static uint32_t PickImageCount(PresentPolicy policy,
+                                 const vk::SurfaceCapabilitiesKHR& caps);
+
+  // How far the CPU may run ahead of the display with present wait. Only
+  // FIFO modes are bounded, as mailbox and immediate don't queue frames.
+  static uint64_t PickMaxFramesAhead(PresentPolicy policy,
+                                     vk::PresentModeKHR mode);
+
+  // The present ID to wait for before acquiring the given frame, zero for
+  // none. Frames are numbered from one.
+  static uint64_t GetPresentWaitID(uint64_t frame, uint64_t max_frames_ahead);
 
-  ~Swapchain();
+  vk::PresentModeKHR GetPresentMode() const;
 
-  bool IsValid() const;
+  // Zero if present wait is unavailable or the policy doesn't bound it.
+  uint64_t GetMaxFramesAhead() const;
 
+  // Renders and presents a frame on its own. Use a FrameScheduler to render
+  // many targets at once.
   bool Render();
 
+  // |RenderTarget|
+  std::optional<Frame> AcquireFrame() override;
+
+  // |RenderTarget|
+  bool RecordFrame() override;
+
+  // |RenderTarget|
+  bool RecordReleaseFrame() override;
+
+  // |RenderTarget|
+  void FrameSubmitted(uint64_t timeline_value) override;
+
+  // |RenderTarget|
+  void FrameDiscarded() override;
+
+  // Captures every frame rendered while the callback is set. Frames are
+  // dropped if the capture can't keep up with rendering.
+  bool SetCaptureCallback(Readback::Callback callback);
+
+  // Transient allocations for the frame being rendered.
+  FrameAllocator& GetFrameAllocator();
+
  private:
   class Synchronizer;
 
   std::weak_ptr<Context> context_;
   vk::UniqueSurfaceKHR surface_;
   vk::UniqueSwapchainKHR swapchain_;
+  vk::UniqueCommandPool command_pool_;
+  vk::Extent2D extent_;
+  vk::Format format_ = vk::Format::eUndefined;
+  vk::PresentModeKHR present_mode_ = vk::PresentModeKHR::eFifo;
+  uint64_t max_frames_ahead_ = 0u;
+  bool supports_capture_ = false;
+  std::shared_ptr<Readback> readback_;
+  Readback::Callback capture_callback_;
   size_t frame_count_ = 0u;
   std::vector<std::unique_ptr<Synchronizer>> synchronizers_;
+  std::unique_ptr<FrameAllocator> frame_allocator_;
+  std::unique_ptr<RenderGraph> render_graph_;
+  RenderGraphResource swapchain_image_ = 0u;
   std::vector<vk::Image> images_;
+  size_t acquired_frame_index_ = 0u;
+  uint32_t acquired_image_index_ = 0u;
   bool is_valid_ = false;
 
   FML_DISALLOW_COPY_AND_ASSIGN(Swapchain);
@@ -0,0 +1,142 @@
+#include "texture_residency.h"
+
+#include <numeric>
+
+#include "fml/logging.h"
+
+namespace one {
+
+static vk::DeviceSize GetSizeOfMips(const TextureResidencyInfo& info,
+                                    uint32_t base_mip) {
+  if (base_mip >= info.mip_sizes.size()) {
+    return 0u;
+  }
+  return std::accumulate(info.mip_sizes.begin() + base_mip,
+                         info.mip_sizes.end(), vk::DeviceSize{0u});
+}
+
+TextureResidency::TextureResidency(StreamCallback stream_callback)
+    : stream_callback_(std::move(stream_callback)) {}
+
+TextureResidency::~TextureResidency() = default;
+
+void TextureResidency::SetBudgets(const std::vector<HeapBudgetVK>& budgets) {
+  budgets_.clear();
+  for (uint32_t heap = 0u; heap < budgets.size(); heap++) {
+    // The reported usage includes the textures tracked here.
+    const auto resident_size = GetResidentSize(heap);
+    const auto& budget = budgets[heap];
+    budgets_.push_back(HeapBudgetVK{
+        .usage = budget.usage > resident_size ? budget.usage - resident_size
+                                              : 0u,
+        .budget = budget.budget,
+    });
+  }
+}
+
+TextureID TextureResidency::RegisterTexture(TextureResidencyInfo info) {
+  const auto id = ++last_id_;
+  const auto mip_count = static_cast<uint32_t>(info.mip_sizes.size());
+  auto& entry = entries_[id];
+  entry.info = std::move(info);
+  entry.base_mip = mip_count;
+  entry.lru_position = lru_.insert(lru_.begin(), id);
+  return id;
+}
+
+void TextureResidency::UnregisterTexture(TextureID id) {
+  auto found = entries_.find(id);
+  if (found == entries_.end()) {
+    return;
+  }
+  auto& entry = found->second;
+  ResidentSize(entry.info.heap_index) -=
+      GetSizeOfMips(entry.info, entry.base_mip);
+  lru_.erase(entry.lru_position);
+  entries_.erase(found);
+}
+
+bool TextureResidency::UseTexture(TextureID id, uint64_t frame) {
+  auto found = entries_.find(id);
+  if (found == entries_.end()) {
+    return false;
+  }
+  auto& entry = found->second;
+  entry.last_used_frame = frame;
+  lru_.splice(lru_.end(), lru_, entry.lru_position);
+  if (entry.base_mip == 0u) {
+    return true;
+  }
+  return StreamTexture(id, entry, 0u);
+}
+
+void TextureResidency::Trim(uint64_t frame) {
+  for (uint32_t heap = 0u; heap < budgets_.size(); heap++) {
+    for (auto it = lru_.begin(); it != lru_.end() && IsOverBudget(heap);
+         ++it) {
+      auto& entry = entries_.at(*it);
+      if (entry.info.heap_index != heap) {
+        continue;
+      }
+      // Textures in use by the current frame cannot be touched.
+      if (entry.last_used_frame == frame) {
+        break;
+      }
+      const auto mip_count = static_cast<uint32_t>(entry.info.mip_sizes.size());
+      while (entry.base_mip < mip_count && IsOverBudget(heap)) {
+        if (!StreamTexture(*it, entry, entry.base_mip + 1u)) {
+          break;
+        }
+      }
+    }
+    if (IsOverBudget(heap)) {
+      FML_LOG(ERROR) << "Textures in use exceed the budget of heap " << heap;
+    }
+  }
+}
+
+std::optional<uint32_t> TextureResidency::GetResidentBaseMip(
+    TextureID id) const {
+  auto found = entries_.find(id);
+  if (found == entries_.end()) {
+    return std::nullopt;
+  }
+  return found->second.base_mip;
+}
+
+vk::DeviceSize TextureResidency::GetResidentSize(uint32_t heap_index) const {
+  if (heap_index >= resident_sizes_.size()) {
+    return 0u;
+  }
+  return resident_sizes_[heap_index];
+}
+
+bool TextureResidency::StreamTexture(TextureID id,
+                                     Entry& entry,
+                                     uint32_t base_mip) {
+  if (!stream_callback_ || !stream_callback_(id, base_mip)) {
+    return false;
+  }
+  auto& resident_size = ResidentSize(entry.info.heap_index);
+  resident_size -= GetSizeOfMips(entry.info, entry.base_mip);
+  resident_size += GetSizeOfMips(entry.info, base_mip);
+  entry.base_mip = base_mip;
+  return true;
+}
+
+bool TextureResidency::IsOverBudget(uint32_t heap_index) const {
+  if (heap_index >= budgets_.size()) {
+    return false;
+  }
+  const auto& budget = budgets_[heap_index];
+  return budget.usage + GetResidentSize(heap_index) > budget.budget;
+}
+
+vk::DeviceSize& TextureResidency::ResidentSize(uint32_t heap_index) {
+  if (heap_index >= resident_sizes_.size()) {
+    resident_sizes_.resize(heap_index + 1u, 0u);
+  }
+  return resident_sizes_[heap_index];
+}
+
+}  // namespace one
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "context.h"
+#include "fml/macros.h"
+#include "vk.h"
+
+namespace one {
+
+using TextureID = uint64_t;
+
+struct TextureResidencyInfo {
+  uint32_t heap_index = 0u;
+  // The allocation size of each mip level. Level zero (the largest) first.
+  std::vector<vk::DeviceSize> mip_sizes;
+};
+
+// Tracks how much texture memory is resident in each heap and keeps it within
+// the heap budgets. Textures are kept in LRU order of the frame they were last
+// used in. When a heap is over budget, the least recently used textures are
+// demoted to smaller mip levels and eventually evicted. Textures are streamed
+// back in at full resolution the next time they are used.
+class TextureResidency {
+ public:
+  // Invoked when the resident mips of a texture need to change to the levels
+  // in [base_mip, mip_count). A base_mip equal to the mip count means the
+  // texture must be evicted entirely. Return false if the change could not be
+  // made and the texture must stay as it was.
+  using StreamCallback = std::function<bool(TextureID id, uint32_t base_mip)>;
+
+  explicit TextureResidency(StreamCallback stream_callback);
+
+  ~TextureResidency();
+
+  void SetBudgets(const std::vector<HeapBudgetVK>& budgets);
+
+  // Registered textures start out evicted.
+  TextureID RegisterTexture(TextureResidencyInfo info);
+
+  void UnregisterTexture(TextureID id);
+
+  // Marks the texture as used in the frame and streams in its full mip chain if
+  // it has been demoted or evicted.
+  bool UseTexture(TextureID id, uint64_t frame);
+
+  // Demotes and evicts textures not used in the given frame till every heap is
+  // within its budget.
+  void Trim(uint64_t frame);
+
+  std::optional<uint32_t> GetResidentBaseMip(TextureID id) const;
+
+  vk::DeviceSize GetResidentSize(uint32_t heap_index) const;
+
+ private:
+  struct Entry {
+    TextureResidencyInfo info;
+    uint32_t base_mip = 0u;
+    uint64_t last_used_frame = 0u;
+    std::list<TextureID>::iterator lru_position;
+  };
+
+  StreamCallback stream_callback_;
+  // The usage of each heap excludes the textures tracked here.
+  std::vector<HeapBudgetVK> budgets_;
+  std::vector<vk::DeviceSize> resident_sizes_;
+  std::unordered_map<TextureID, Entry> entries_;
+  // Least recently used textures are at the front.
+  std::list<TextureID> lru_;
+  TextureID last_id_ = 0u;
+
+  bool StreamTexture(TextureID id, Entry& entry, uint32_t base_mip);
+
+  bool IsOverBudget(uint32_t heap_index) const;
+
+  vk::DeviceSize& ResidentSize(uint32_t heap_index);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(TextureResidency);
+};
+
+}  // namespace one
@@ -1,12 +1,244 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
 #include "assets_location.h"
+#include "bindless_textures.h"
 #include "context.h"
+#include "deletion_queue.h"
+#include "frame_allocator.h"
+#include "frame_scheduler.h"
+#include "fml/file.h"
+#include "fml/logging.h"
 #include "fml/mapping.h"
+#include "fml/synchronization/waitable_event.h"
+#include "fml/thread.h"
+#include "glm/glm/ext/matrix_clip_space.hpp"
+#include "gpu_culler.h"
+#include "gpu_jpeg_decoder.h"
 #include "gtest/gtest.h"
+#include "headless_target.h"
+#include "host_arena.h"
 #include "image_decoder.h"
+#include "image_encoder.h"
+#include "jpeg_parser.h"
+#include "parallel_jpeg_decoder.h"
 #include "playground_test.h"
+#include "readback.h"
+#include "render_graph.h"
+#include "swapchain.h"
+#include "texture_residency.h"
+#include "virtual_texture.h"
+#include "vk_utils.h"
+
+// Heap allocations made by each thread. Tests use it to check that steady
+// state frames don't allocate.
+static thread_local size_t tHeapAllocationCount = 0u;
+
+void* operator new(std::size_t size) {
+  tHeapAllocationCount++;
+  auto allocation = std::malloc(size == 0u ? 1u : size);
+  FML_CHECK(allocation);
+  return allocation;
+}
+
+void operator delete(void* allocation) noexcept {
+  std::free(allocation);
+}
+
+void operator delete(void* allocation, std::size_t) noexcept {
+  std::free(allocation);
+}
 
 namespace one::testing {
 
+// A synthetic RGBA8 image with both smooth gradients and sharp edges.
+static std::shared_ptr<fml::Mapping> EncodeTestJPEG(glm::ivec2 size) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(size.x) * size.y * 4u);
+  for (int y = 0; y < size.y; y++) {
+    for (int x = 0; x < size.x; x++) {
+      auto* pixel = pixels.data() + (static_cast<size_t>(y) * size.x + x) * 4u;
+      pixel[0] = static_cast<uint8_t>(x);
+      pixel[1] = static_cast<uint8_t>(y);
+      pixel[2] = static_cast<uint8_t>((x ^ y) * 8);
+      pixel[3] = 255u;
+    }
+  }
+  fml::NonOwnedMapping mapping(pixels.data(), pixels.size());
+  return EncodeJPEG(mapping, size);
+}
+
+struct ImageError {
+  double mean = 0.0;
+  int max = 0;
+};
+
+// The absolute differences between the bytes of two images of equal size.
+static ImageError CompareImages(const fml::Mapping& actual,
+                                const fml::Mapping& expected) {
+  FML_CHECK(actual.GetSize() == expected.GetSize());
+  ImageError error;
+  double total = 0.0;
+  for (size_t i = 0; i < actual.GetSize(); i++) {
+    const auto difference =
+        std::abs(static_cast<int>(actual.GetMapping()[i]) -
+                 static_cast<int>(expected.GetMapping()[i]));
+    total += difference;
+    error.max = std::max(error.max, difference);
+  }
+  error.mean = actual.GetSize() > 0u ? total / actual.GetSize() : 0.0;
+  return error;
+}
+
+// Rewrites a baseline JPEG with a restart marker every interval MCUs, as
+// cameras do. stb's encoder never writes them. The coefficients and Huffman
+// tables are kept, so the result decodes to the same pixels.
+static std::shared_ptr<fml::Mapping> AddRestartMarkers(const fml::Mapping& jpeg,
+                                                       uint16_t interval) {
+  static constexpr std::array<uint8_t, JPEGParser::kBlockSize> kZigZag = {
+      0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+      12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+      35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+      58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+  };
+  JPEGParser parser(jpeg);
+  std::vector<int16_t> coefficients(parser.GetCoefficientCount());
+  if (interval == 0u || !parser.IsValid() ||
+      !parser.DecodeCoefficients(coefficients.data())) {
+    return nullptr;
+  }
+
+  // The code of each symbol of the DC and AC tables, (length << 16) | code.
+  using HuffmanCodes = std::array<uint32_t, 256>;
+  std::array<std::array<HuffmanCodes, 4>, 2> codes = {};
+  std::vector<uint8_t> output = {0xFF, 0xD8};
+  const auto* data = jpeg.GetMapping();
+  size_t offset = 2u;
+  while (offset + 4u <= jpeg.GetSize() && data[offset] == 0xFF) {
+    const auto marker = data[offset + 1u];
+    const size_t length = (data[offset + 2u] << 8u) | data[offset + 3u];
+    const auto* segment = data + offset + 4u;
+    if (marker == 0xC4) {
+      // Huffman tables, each a class and index, 16 counts and the symbols.
+      for (size_t i = 0; i + 17u <= length - 2u;) {
+        auto& table = codes[segment[i] >> 4u][segment[i] & 3u];
+        const auto* counts = segment + i + 1u;
+        const auto* symbols = counts + 16u;
+        uint32_t code = 0u;
+        for (uint32_t bits = 1u; bits <= 16u; bits++) {
+          for (uint32_t j = 0; j < counts[bits - 1u]; j++) {
+            table[*symbols++] = (bits << 16u) | code++;
+          }
+          code <<= 1u;
+        }
+        i = symbols - segment;
+      }
+    }
+    if (marker == 0xDA) {
+      const uint8_t dri[] = {0xFF, 0xDD, 0x00, 0x04,
+                             static_cast<uint8_t>(interval >> 8u),
+                             static_cast<uint8_t>(interval & 0xFFu)};
+      output.insert(output.end(), std::begin(dri), std::end(dri));
+    }
+    if (marker != 0xDD) {
+      output.insert(output.end(), data + offset, segment + length - 2u);
+    }
+    offset += 2u + length;
+    if (marker == 0xDA) {
+      break;
+    }
+  }
+
+  uint32_t bit_buffer = 0u;
+  uint32_t bit_count = 0u;
+  auto put_bits = [&](uint32_t bits, uint32_t count) {
+    bit_buffer = (bit_buffer << count) | (bits & ((1u << count) - 1u));
+    bit_count += count;
+    while (bit_count >= 8u) {
+      bit_count -= 8u;
+      const auto byte = static_cast<uint8_t>(bit_buffer >> bit_count);
+      output.push_back(byte);
+      if (byte == 0xFF) {
+        output.push_back(0x00);
+      }
+    }
+  };
+  auto put_symbol = [&](const HuffmanCodes& table, uint32_t symbol) {
+    put_bits(table[symbol] & 0xFFFFu, table[symbol] >> 16u);
+  };
+  // The magnitude category of a value followed by its bits.
+  auto put_value = [&](const HuffmanCodes& table, uint32_t run, int32_t value) {
+    uint32_t category = 0u;
+    while ((std::abs(value) >> category) != 0) {
+      category++;
+    }
+    put_symbol(table, (run << 4u) | category);
+    put_bits(value < 0 ? value - 1 : value, category);
+  };
+
+  const auto& components = parser.GetComponents();
+  const auto size = parser.GetSize();
+  const uint32_t mcu_width = 8u * parser.GetMaxHSampling();
+  const uint32_t mcu_height = 8u * parser.GetMaxVSampling();
+  const uint32_t mcus_x = (size.x + mcu_width - 1u) / mcu_width;
+  const uint32_t mcus_y = (size.y + mcu_height - 1u) / mcu_height;
+  std::array<int32_t, 3> dc_predictions = {};
+  for (uint32_t mcu = 0; mcu < mcus_x * mcus_y; mcu++) {
+    if (mcu > 0u && mcu % interval == 0u) {
+      // Pad to a byte with ones, then the next of RST0 to RST7.
+      put_bits(0x7Fu, (8u - bit_count) % 8u);
+      output.push_back(0xFF);
+      output.push_back(0xD0 + (mcu / interval - 1u) % 8u);
+      dc_predictions = {};
+    }
+    for (size_t c = 0; c < components.size(); c++) {
+      const auto& component = components[c];
+      const auto& dc_table = codes[0][component.dc_table];
+      const auto& ac_table = codes[1][component.ac_table];
+      for (uint32_t v = 0; v < component.v_sampling; v++) {
+        for (uint32_t h = 0; h < component.h_sampling; h++) {
+          const size_t block_x = (mcu % mcus_x) * component.h_sampling + h;
+          const size_t block_y = (mcu / mcus_x) * component.v_sampling + v;
+          const auto* block =
+              coefficients.data() + component.coefficient_offset +
+              (block_y * component.blocks_x + block_x) *
+                  JPEGParser::kBlockSize;
+          put_value(dc_table, 0u, block[0] - dc_predictions[c]);
+          dc_predictions[c] = block[0];
+          uint32_t run = 0u;
+          for (size_t k = 1u; k < JPEGParser::kBlockSize; k++) {
+            const auto value = block[kZigZag[k]];
+            if (value == 0) {
+              run++;
+              continue;
+            }
+            for (; run >= 16u; run -= 16u) {
+              put_symbol(ac_table, 0xF0u);
+            }
+            put_value(ac_table, run, value);
+            run = 0u;
+          }
+          if (run > 0u) {
+            put_symbol(ac_table, 0x00u);
+          }
+        }
+      }
+    }
+  }
+  put_bits(0x7Fu, (8u - bit_count) % 8u);
+  output.push_back(0xFF);
+  output.push_back(0xD9);
+  return std::make_shared<fml::DataMapping>(std::move(output));
+}
+
 TEST(JustOne, CanDecodeImage) {
   auto airplane =
       fml::FileMapping::CreateReadOnly(JUSTONE_ASSETS_LOCATION "airplane.jpg");
@@ -17,8 +249,1247 @@ TEST(JustOne, CanDecodeImage) {
   EXPECT_EQ(decoder.GetSize().y, 378u);
 }
 
+TEST(JustOne, JPEGParserDecodesBaselineImages) {
+  auto airplane =
+      fml::FileMapping::CreateReadOnly(JUSTONE_ASSETS_LOCATION "airplane.jpg");
+  ASSERT_TRUE(airplane && airplane->IsValid());
+  // The asset is progressive.
+  EXPECT_FALSE(JPEGParser(*airplane).IsValid());
+
+  ImageDecoder decoder(*airplane);
+  ASSERT_TRUE(decoder.IsValid());
+  auto jpeg = EncodeJPEG(*decoder.GetPixels(), decoder.GetSize());
+  ASSERT_TRUE(jpeg);
+  JPEGParser parser(*jpeg);
+  ASSERT_TRUE(parser.IsValid());
+  EXPECT_EQ(parser.GetSize(), decoder.GetSize());
+  ASSERT_EQ(parser.GetComponents().size(), 3u);
+  for (const auto& component : parser.GetComponents()) {
+    EXPECT_GE(component.blocks_x * 8u, component.width);
+    EXPECT_GE(component.blocks_y * 8u, component.height);
+  }
+  std::vector<int16_t> coefficients(parser.GetCoefficientCount());
+  EXPECT_TRUE(parser.DecodeCoefficients(coefficients.data()));
+}
+
+TEST(JustOne, ConcurrentJPEGDecodeMatchesSerialDecode) {
+  // 4:2:0 with partial MCUs along the right and bottom edges.
+  const auto jpeg = EncodeTestJPEG({1000, 600});
+  ASSERT_TRUE(jpeg);
+  const auto restarted = AddRestartMarkers(*jpeg, 4u);
+  ASSERT_TRUE(restarted);
+  ImageDecoder expected(*jpeg);
+  ASSERT_TRUE(expected.IsValid());
+
+  auto loop = fml::ConcurrentMessageLoop::Create(4u);
+  // 63 by 38 MCUs.
+  for (const auto& [source, segment_count] :
+       {std::pair{jpeg, 1u}, std::pair{restarted, 599u}}) {
+    JPEGParser parser(*source);
+    ASSERT_TRUE(parser.IsValid());
+    EXPECT_EQ(parser.GetMaxHSampling(), 2u);
+    EXPECT_EQ(parser.GetMaxVSampling(), 2u);
+    EXPECT_EQ(parser.GetSegmentCount(), segment_count);
+    const auto decoded = DecodeJPEGConcurrently(parser, *loop->GetTaskRunner());
+    ASSERT_TRUE(decoded);
+    // The IDCT and chroma upsampling differ slightly from stb's.
+    const auto error = CompareImages(*decoded, *expected.GetPixels());
+    EXPECT_LT(error.mean, 1.0);
+    EXPECT_LE(error.max, 8);
+  }
+}
+
+// A benchmark, run with --gtest_also_run_disabled_tests.
+TEST(JustOne, DISABLED_ConcurrentJPEGDecodeTime) {
+  // 50 megapixels with a restart marker every MCU row, as cameras write them.
+  const glm::ivec2 size = {8192, 6144};
+  const auto jpeg = AddRestartMarkers(*EncodeTestJPEG(size), size.x / 16);
+  ASSERT_TRUE(jpeg);
+  EXPECT_EQ(JPEGParser(*jpeg).GetSegmentCount(), size.y / 16u);
+
+  auto loop = fml::ConcurrentMessageLoop::Create();
+  static constexpr size_t kDecodeCount = 3u;
+  std::chrono::steady_clock::duration serial_time = {};
+  std::chrono::steady_clock::duration concurrent_time = {};
+  for (size_t i = 0; i < kDecodeCount; i++) {
+    const auto serial_start = std::chrono::steady_clock::now();
+    ImageDecoder expected(*jpeg);
+    const auto serial_end = std::chrono::steady_clock::now();
+    ASSERT_TRUE(expected.IsValid());
+    ImageDecoder decoder(*jpeg, *loop->GetTaskRunner());
+    concurrent_time += std::chrono::steady_clock::now() - serial_end;
+    serial_time += serial_end - serial_start;
+    ASSERT_TRUE(decoder.IsValid());
+    ASSERT_EQ(decoder.GetSize(), expected.GetSize());
+    EXPECT_LT(CompareImages(*decoder.GetPixels(), *expected.GetPixels()).mean,
+              1.0);
+  }
+  FML_LOG(INFO) << "Serial decode: "
+                << std::chrono::duration<double, std::milli>(serial_time)
+                           .count() /
+                       kDecodeCount
+                << "ms Concurrent decode on " << loop->GetWorkerCount()
+                << " workers: "
+                << std::chrono::duration<double, std::milli>(concurrent_time)
+                           .count() /
+                       kDecodeCount
+                << "ms";
+}
+
+TEST(JustOne, PresentPolicyPicksSupportedModes) {
+  using Mode = vk::PresentModeKHR;
+  const std::vector<Mode> all = {Mode::eImmediate, Mode::eMailbox,
+                                 Mode::eFifo, Mode::eFifoRelaxed};
+  EXPECT_EQ(Swapchain::PickPresentMode(PresentPolicy::kLowLatency, all),
+            Mode::eMailbox);
+  EXPECT_EQ(Swapchain::PickPresentMode(PresentPolicy::kThroughput, all),
+            Mode::eImmediate);
+  EXPECT_EQ(Swapchain::PickPresentMode(PresentPolicy::kPowerSaving, all),
+            Mode::eFifo);
+
+  const std::vector<Mode> fifo_only = {Mode::eFifo};
+  EXPECT_EQ(Swapchain::PickPresentMode(PresentPolicy::kLowLatency, fifo_only),
+            Mode::eFifo);
+  EXPECT_EQ(Swapchain::PickPresentMode(PresentPolicy::kThroughput,
+                                       {Mode::eFifo, Mode::eMailbox}),
+            Mode::eMailbox);
+  EXPECT_EQ(Swapchain::PickPresentMode(PresentPolicy::kLowLatency,
+                                       {Mode::eImmediate, Mode::eFifo}),
+            Mode::eFifo);
+}
+
+TEST(JustOne, PresentPolicyPicksImageCounts) {
+  vk::SurfaceCapabilitiesKHR caps;
+  caps.minImageCount = 2u;
+  caps.maxImageCount = 0u;
+  EXPECT_EQ(Swapchain::PickImageCount(PresentPolicy::kLowLatency, caps), 3u);
+  EXPECT_EQ(Swapchain::PickImageCount(PresentPolicy::kThroughput, caps), 4u);
+  EXPECT_EQ(Swapchain::PickImageCount(PresentPolicy::kPowerSaving, caps), 2u);
+
+  caps.maxImageCount = 3u;
+  EXPECT_EQ(Swapchain::PickImageCount(PresentPolicy::kLowLatency, caps), 3u);
+  EXPECT_EQ(Swapchain::PickImageCount(PresentPolicy::kThroughput, caps), 3u);
+  EXPECT_EQ(Swapchain::PickImageCount(PresentPolicy::kPowerSaving, caps), 2u);
+}
+
+TEST(JustOne, PresentPolicyBoundsOnlyFIFOFrames) {
+  using Mode = vk::PresentModeKHR;
+  EXPECT_EQ(
+      Swapchain::PickMaxFramesAhead(PresentPolicy::kLowLatency, Mode::eFifo),
+      1u);
+  EXPECT_EQ(Swapchain::PickMaxFramesAhead(PresentPolicy::kLowLatency,
+                                          Mode::eMailbox),
+            0u);
+  EXPECT_EQ(Swapchain::PickMaxFramesAhead(PresentPolicy::kPowerSaving,
+                                          Mode::eFifo),
+            2u);
+  EXPECT_EQ(Swapchain::PickMaxFramesAhead(PresentPolicy::kThroughput,
+                                          Mode::eImmediate),
+            0u);
+  EXPECT_EQ(Swapchain::PickMaxFramesAhead(PresentPolicy::kThroughput,
+                                          Mode::eFifo),
+            0u);
+
+  // Frame N waits for the present of frame N - max.
+  EXPECT_EQ(Swapchain::GetPresentWaitID(1u, 1u), 0u);
+  EXPECT_EQ(Swapchain::GetPresentWaitID(2u, 1u), 1u);
+  EXPECT_EQ(Swapchain::GetPresentWaitID(2u, 2u), 0u);
+  EXPECT_EQ(Swapchain::GetPresentWaitID(10u, 2u), 8u);
+  EXPECT_EQ(Swapchain::GetPresentWaitID(10u, 0u), 0u);
+}
+
+TEST(JustOne, TextureResidencyEvictsLeastRecentlyUsed) {
+  std::map<TextureID, uint32_t> streamed;
+  TextureResidency residency([&](TextureID id, uint32_t base_mip) {
+    streamed[id] = base_mip;
+    return true;
+  });
+  residency.SetBudgets({HeapBudgetVK{.usage = 0u, .budget = 100u}});
+  const TextureResidencyInfo info = {.heap_index = 0u,
+                                     .mip_sizes = {64u, 16u, 4u}};
+  const auto a = residency.RegisterTexture(info);
+  const auto b = residency.RegisterTexture(info);
+  const auto c = residency.RegisterTexture(info);
+  EXPECT_EQ(residency.GetResidentBaseMip(a), 3u);
+
+  // Textures used in the current frame are never evicted.
+  ASSERT_TRUE(residency.UseTexture(a, 1u));
+  ASSERT_TRUE(residency.UseTexture(b, 1u));
+  ASSERT_TRUE(residency.UseTexture(c, 1u));
+  residency.Trim(1u);
+  EXPECT_EQ(residency.GetResidentSize(0u), 252u);
+
+  ASSERT_TRUE(residency.UseTexture(c, 2u));
+  residency.Trim(2u);
+  EXPECT_EQ(residency.GetResidentBaseMip(a), 3u);
+  EXPECT_EQ(residency.GetResidentBaseMip(b), 2u);
+  EXPECT_EQ(residency.GetResidentBaseMip(c), 0u);
+  EXPECT_EQ(residency.GetResidentSize(0u), 88u);
+
+  // Evicted textures are streamed back in on use.
+  ASSERT_TRUE(residency.UseTexture(a, 3u));
+  EXPECT_EQ(streamed[a], 0u);
+  residency.Trim(3u);
+  EXPECT_EQ(residency.GetResidentBaseMip(b), 3u);
+  EXPECT_EQ(residency.GetResidentBaseMip(c), 2u);
+  EXPECT_EQ(residency.GetResidentSize(0u), 88u);
+}
+
+TEST(JustOne, DeletionQueueWaitsForTimeline) {
+  DeletionQueue queue(nullptr);
+  size_t deleted = 0u;
+  queue.EnqueueCallback([&]() { deleted++; }, 1u);
+  queue.EnqueueCallback([&]() { deleted++; }, 3u);
+  auto handle = std::shared_ptr<int>(new int(0), [&](int* value) {
+    delete value;
+    deleted++;
+  });
+  queue.Enqueue(std::move(handle), 2u);
+  EXPECT_EQ(queue.GetPendingCount(), 3u);
+  queue.Collect(0u);
+  EXPECT_EQ(deleted, 0u);
+  queue.Collect(2u);
+  EXPECT_EQ(deleted, 2u);
+  EXPECT_EQ(queue.GetPendingCount(), 1u);
+  queue.Drain();
+  EXPECT_EQ(deleted, 3u);
+}
+
+TEST(JustOne, WorkerCountLeavesACoreForTheRenderThread) {
+  ContextSettings settings;
+  settings.worker_count = 5u;
+  EXPECT_EQ(Context::PickWorkerCount(settings), 5u);
+
+  settings.worker_count = 0u;
+  settings.pin_to_performance_cores = false;
+  const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  const auto all_cores = std::max<size_t>(cores - 1u, 1u);
+  EXPECT_EQ(Context::PickWorkerCount(settings), all_cores);
+
+  // Efficiency cores are left out, if there are any.
+  settings.pin_to_performance_cores = true;
+  EXPECT_GE(Context::PickWorkerCount(settings), 1u);
+  EXPECT_LE(Context::PickWorkerCount(settings), all_cores);
+}
+
+TEST_F(PlaygroundTest, ContextRunsTheRequestedWorkerCount) {
+  ASSERT_TRUE(IsValid());
+  EXPECT_EQ(GetContext()->GetWorkerCount(), Context::PickWorkerCount({}));
+
+  ContextSettings settings;
+  settings.worker_count = 3u;
+  auto context = MakeContext(settings);
+  ASSERT_TRUE(context);
+  EXPECT_EQ(context->GetWorkerCount(), 3u);
+}
+
+TEST(JustOne, HostArenaReusesBlocksAcrossFrames) {
+  HostArena arena(1024u);
+  size_t warm_block_count = 0u;
+  for (size_t frame = 0; frame < 16u; frame++) {
+    arena.Reset();
+    for (size_t i = 0; i < 64u; i++) {
+      auto floats = arena.Allocate<float>(i + 1u);
+      ASSERT_NE(floats, nullptr);
+      floats[i] = 1.0f;
+    }
+    auto aligned = arena.Allocate(4096u, 256u);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(aligned) % 256u, 0u);
+    if (frame == 0u) {
+      warm_block_count = arena.GetBlockAllocationCount();
+    }
+  }
+  EXPECT_GT(warm_block_count, 0u);
+  EXPECT_EQ(arena.GetBlockAllocationCount(), warm_block_count);
+}
+
+// A pipeline drawing triangle lists into a single color attachment with
+// dynamic rendering. Blending adds to the attachment if enabled.
+static vk::UniquePipeline CreateTestPipeline(const vk::Device& device,
+                                             const vk::PipelineLayout& layout,
+                                             const char* vertex_shader,
+                                             const char* fragment_shader,
+                                             vk::Format format,
+                                             bool additive_blend) {
+  auto vertex_module = LoadShaderModule(device, vertex_shader);
+  auto fragment_module = LoadShaderModule(device, fragment_shader);
+  if (!vertex_module || !fragment_module) {
+    return {};
+  }
+  std::array<vk::PipelineShaderStageCreateInfo, 2> stages;
+  stages[0].stage = vk::ShaderStageFlagBits::eVertex;
+  stages[0].module = *vertex_module;
+  stages[0].pName = "main";
+  stages[1].stage = vk::ShaderStageFlagBits::eFragment;
+  stages[1].module = *fragment_module;
+  stages[1].pName = "main";
+  vk::PipelineVertexInputStateCreateInfo vertex_input;
+  vk::PipelineInputAssemblyStateCreateInfo input_assembly;
+  input_assembly.topology = vk::PrimitiveTopology::eTriangleList;
+  vk::PipelineViewportStateCreateInfo viewport_state;
+  viewport_state.viewportCount = 1u;
+  viewport_state.scissorCount = 1u;
+  vk::PipelineRasterizationStateCreateInfo rasterization;
+  rasterization.cullMode = vk::CullModeFlagBits::eNone;
+  rasterization.lineWidth = 1.0f;
+  vk::PipelineMultisampleStateCreateInfo multisample;
+  vk::PipelineColorBlendAttachmentState blend_attachment;
+  blend_attachment.blendEnable = additive_blend;
+  blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+  blend_attachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+  blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+  blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eOne;
+  blend_attachment.colorWriteMask =
+      vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+      vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+  vk::PipelineColorBlendStateCreateInfo color_blend;
+  color_blend.setAttachments(blend_attachment);
+  const std::array<vk::DynamicState, 2> dynamic_states = {
+      vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamic_state;
+  dynamic_state.setDynamicStates(dynamic_states);
+  vk::PipelineRenderingCreateInfo rendering_info;
+  rendering_info.setColorAttachmentFormats(format);
+  vk::GraphicsPipelineCreateInfo pipeline_info;
+  pipeline_info.pNext = &rendering_info;
+  pipeline_info.setStages(stages);
+  pipeline_info.pVertexInputState = &vertex_input;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pRasterizationState = &rasterization;
+  pipeline_info.pMultisampleState = &multisample;
+  pipeline_info.pColorBlendState = &color_blend;
+  pipeline_info.pDynamicState = &dynamic_state;
+  pipeline_info.layout = layout;
+  auto [pipeline_result, pipeline] =
+      device.createGraphicsPipelineUnique({}, pipeline_info);
+  if (pipeline_result != vk::Result::eSuccess) {
+    return {};
+  }
+  return std::move(pipeline);
+}
+
+TEST_F(PlaygroundTest, BindlessTexturesReuseUnregisteredIndices) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  if (!context->SupportsBindlessTextures()) {
+    GTEST_SKIP() << "Device doesn't support bindless textures.";
+  }
+  const auto& device = context->GetDevice();
+
+  ImageVK image;
+  ASSERT_TRUE(CreateImage(*context, image, vk::Format::eR8G8B8A8Unorm, {1u, 1u},
+                          vk::ImageUsageFlagBits::eSampled));
+  auto [sampler_result, sampler] =
+      device.createSamplerUnique(vk::SamplerCreateInfo{});
+  ASSERT_EQ(sampler_result, vk::Result::eSuccess);
+
+  auto textures = BindlessTextures::Make(context, 2u);
+  ASSERT_TRUE(textures);
+  ASSERT_EQ(textures->GetCapacity(), 2u);
+  const auto first = textures->Register(*image.view, *sampler);
+  const auto second = textures->Register(*image.view, *sampler);
+  ASSERT_TRUE(first.has_value());
+  ASSERT_TRUE(second.has_value());
+  EXPECT_NE(first.value(), second.value());
+  EXPECT_FALSE(textures->Register(*image.view, *sampler).has_value());
+
+  // The second call must not free the index again.
+  textures->Unregister(first.value());
+  textures->Unregister(first.value());
+  ASSERT_TRUE(context->WaitForTimelineValue(
+      context->GetLastSubmittedTimelineValue()));
+  context->GetDeletionQueue().Drain();
+
+  const auto reused = textures->Register(*image.view, *sampler);
+  ASSERT_TRUE(reused.has_value());
+  EXPECT_EQ(reused.value(), first.value());
+  EXPECT_FALSE(textures->Register(*image.view, *sampler).has_value());
+}
+
+TEST_F(PlaygroundTest, BindlessTexturesSampleRegisteredIndex) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  if (!context->SupportsBindlessTextures()) {
+    GTEST_SKIP() << "Device doesn't support bindless textures.";
+  }
+  const auto& device = context->GetDevice();
+
+  // Two single texel textures, cleared to red and green.
+  const RenderGraphImageDesc texture_desc = {vk::Format::eR8G8B8A8Unorm,
+                                             {1u, 1u}};
+  std::array<ImageVK, 2> images;
+  for (auto& image : images) {
+    ASSERT_TRUE(CreateImage(*context, image, texture_desc.format,
+                            texture_desc.extent,
+                            vk::ImageUsageFlagBits::eSampled |
+                                vk::ImageUsageFlagBits::eTransferDst));
+  }
+  auto [sampler_result, sampler] =
+      device.createSamplerUnique(vk::SamplerCreateInfo{});
+  ASSERT_EQ(sampler_result, vk::Result::eSuccess);
+  auto textures = BindlessTextures::Make(context, 2u);
+  ASSERT_TRUE(textures);
+  const auto red = textures->Register(*images[0].view, *sampler);
+  const auto green = textures->Register(*images[1].view, *sampler);
+  ASSERT_TRUE(red.has_value());
+  ASSERT_TRUE(green.has_value());
+
+  vk::PushConstantRange push_constants;
+  push_constants.stageFlags = vk::ShaderStageFlagBits::eFragment;
+  push_constants.size = sizeof(uint32_t);
+  vk::PipelineLayoutCreateInfo layout_info;
+  layout_info.setSetLayouts(textures->GetDescriptorSetLayout());
+  layout_info.setPushConstantRanges(push_constants);
+  auto [layout_result, pipeline_layout] =
+      device.createPipelineLayoutUnique(layout_info);
+  ASSERT_EQ(layout_result, vk::Result::eSuccess);
+  const RenderGraphImageDesc target_desc = {vk::Format::eR8G8B8A8Unorm,
+                                            {4u, 4u}};
+  auto pipeline = CreateTestPipeline(
+      device, *pipeline_layout, "bindless_test.vert.spv",
+      "bindless_test.frag.spv", target_desc.format, false);
+  ASSERT_TRUE(pipeline);
+
+  auto readback = Readback::Make(
+      context, 1u, target_desc.extent.width * target_desc.extent.height * 4u);
+  ASSERT_TRUE(readback);
+
+  RenderGraph graph(context);
+  std::array<RenderGraphResource, 2> texture_resources;
+  const std::array<const char*, 2> names = {"red", "green"};
+  const std::array<vk::ClearColorValue, 2> colors = {
+      vk::ClearColorValue{1.0f, 0.0f, 0.0f, 1.0f},
+      vk::ClearColorValue{0.0f, 1.0f, 0.0f, 1.0f}};
+  for (size_t i = 0; i < images.size(); i++) {
+    const auto resource = graph.ImportImage(
+        names[i], texture_desc, vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eShaderReadOnlyOptimal);
+    texture_resources[i] = resource;
+    graph
+        .AddPass(std::string("clear ") + names[i],
+                 [&, resource, i](const vk::CommandBuffer& command_buffer) {
+                   vk::ImageSubresourceRange range;
+                   range.aspectMask = vk::ImageAspectFlagBits::eColor;
+                   range.levelCount = 1u;
+                   range.layerCount = 1u;
+                   command_buffer.clearColorImage(
+                       graph.GetImage(resource),
+                       vk::ImageLayout::eTransferDstOptimal, colors[i],
+                       range);
+                 })
+        .Overwrite(resource, RenderGraphUsage::kTransferDst);
+  }
+  const auto target = graph.CreateImage("target", target_desc);
+  graph
+      .AddPass("draw",
+               [&](const vk::CommandBuffer& command_buffer) {
+                 vk::RenderingAttachmentInfo attachment;
+                 attachment.imageView = graph.GetImageView(target);
+                 attachment.imageLayout =
+                     vk::ImageLayout::eColorAttachmentOptimal;
+                 attachment.loadOp = vk::AttachmentLoadOp::eDontCare;
+                 attachment.storeOp = vk::AttachmentStoreOp::eStore;
+                 vk::RenderingInfo rendering;
+                 rendering.renderArea.extent = target_desc.extent;
+                 rendering.layerCount = 1u;
+                 rendering.setColorAttachments(attachment);
+                 command_buffer.beginRendering(rendering);
+                 command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                             *pipeline);
+                 command_buffer.bindDescriptorSets(
+                     vk::PipelineBindPoint::eGraphics, *pipeline_layout, 0u,
+                     textures->GetDescriptorSet(), {});
+                 command_buffer.pushConstants<uint32_t>(
+                     *pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0u,
+                     green.value());
+                 command_buffer.setViewport(
+                     0u, vk::Viewport{
+                             0.0f, 0.0f,
+                             static_cast<float>(target_desc.extent.width),
+                             static_cast<float>(target_desc.extent.height),
+                             0.0f, 1.0f});
+                 command_buffer.setScissor(0u,
+                                           vk::Rect2D{{}, target_desc.extent});
+                 command_buffer.draw(3u, 1u, 0u, 0u);
+                 command_buffer.endRendering();
+               })
+      .Read(texture_resources[0], RenderGraphUsage::kSampled)
+      .Read(texture_resources[1], RenderGraphUsage::kSampled)
+      .Overwrite(target, RenderGraphUsage::kColorAttachment);
+  std::unique_ptr<fml::Mapping> pixels;
+  graph
+      .AddPass("capture",
+               [&](const vk::CommandBuffer& command_buffer) {
+                 readback->Record(
+                     command_buffer, graph.GetImage(target),
+                     vk::ImageLayout::eTransferSrcOptimal, target_desc.extent,
+                     target_desc.format,
+                     [&](std::unique_ptr<fml::Mapping> p_pixels,
+                         vk::Extent2D) { pixels = std::move(p_pixels); });
+               })
+      .Read(target, RenderGraphUsage::kTransferSrc)
+      .HasSideEffects();
+  ASSERT_TRUE(graph.Compile());
+  for (size_t i = 0; i < images.size(); i++) {
+    graph.SetImportedImage(texture_resources[i], *images[i].image,
+                           *images[i].view);
+  }
+
+  const auto command_buffer = MakeCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+  ASSERT_EQ(command_buffer.begin(vk::CommandBufferBeginInfo{}),
+            vk::Result::eSuccess);
+  ASSERT_TRUE(graph.Execute(command_buffer));
+  ASSERT_EQ(command_buffer.end(), vk::Result::eSuccess);
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  const auto timeline_value = context->Submit(submit_info);
+  ASSERT_TRUE(timeline_value.has_value());
+  readback->Submitted(timeline_value.value());
+  ASSERT_TRUE(context->WaitForTimelineValue(timeline_value.value()));
+  ASSERT_TRUE(readback->Flush());
+
+  // Every pixel comes from the green texture the draw was given the index of.
+  ASSERT_TRUE(pixels);
+  ASSERT_EQ(pixels->GetSize(),
+            target_desc.extent.width * target_desc.extent.height * 4u);
+  for (size_t i = 0; i < pixels->GetSize(); i += 4u) {
+    EXPECT_EQ(pixels->GetMapping()[i + 0], 0u);
+    EXPECT_EQ(pixels->GetMapping()[i + 1], 255u);
+    EXPECT_EQ(pixels->GetMapping()[i + 2], 0u);
+    EXPECT_EQ(pixels->GetMapping()[i + 3], 255u);
+  }
+}
+
+TEST_F(PlaygroundTest, FrameAllocatorDoesNotAllocateInSteadyState) {
+  ASSERT_TRUE(IsValid());
+  FrameAllocator allocator(GetContext(), 3u, 4096u, 64u * 1024u);
+  ASSERT_TRUE(allocator.IsValid());
+  auto render_frame = [&](size_t frame) {
+    allocator.BeginFrame(frame % allocator.GetFrameCount());
+    auto& arena = allocator.GetHostArena();
+    ASSERT_NE(arena.Allocate<uint32_t>(512u), nullptr);
+    for (size_t i = 0; i < 16u; i++) {
+      auto allocation = allocator.AllocateDevice(100u, 16u);
+      ASSERT_TRUE(allocation.has_value());
+      ASSERT_EQ(allocation->offset % 16u, 0u);
+      ::memset(allocation->data, 0xFF, allocation->size);
+    }
+    // Alignments beyond the device's apply to the offset in the buffer.
+    auto aligned = allocator.AllocateDevice(100u, 4096u);
+    ASSERT_TRUE(aligned.has_value());
+    ASSERT_EQ(aligned->offset % 4096u, 0u);
+    ASSERT_TRUE(allocator.EndFrame());
+  };
+  // The arenas get their blocks the first time each frame is used.
+  for (size_t frame = 0; frame < allocator.GetFrameCount(); frame++) {
+    render_frame(frame);
+  }
+  const auto heap_allocations = tHeapAllocationCount;
+  for (size_t frame = allocator.GetFrameCount(); frame < 30u; frame++) {
+    render_frame(frame);
+  }
+  EXPECT_EQ(tHeapAllocationCount, heap_allocations);
+
+  // Each frame only gets its own slice of the buffer.
+  allocator.BeginFrame(0u);
+  const auto frame_size = allocator.GetDeviceFrameSize();
+  EXPECT_FALSE(allocator.AllocateDevice(frame_size + 1u).has_value());
+}
+
+TEST_F(PlaygroundTest, FrameSchedulerDoesNotAllocateInSteadyState) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  HeadlessTarget target(context, vk::Extent2D{64u, 64u});
+  ASSERT_TRUE(target.IsValid());
+  FrameScheduler scheduler(context);
+  scheduler.AddTarget(&target);
+  // With a single target, the whole frame is recorded and submitted on this
+  // thread.
+  auto render_frame = [&]() {
+    const auto& results = scheduler.RenderFrame();
+    ASSERT_EQ(results.size(), 1u);
+    ASSERT_EQ(results.front(), vk::Result::eSuccess);
+  };
+  for (size_t frame = 0; frame < 4u; frame++) {
+    render_frame();
+  }
+  const auto heap_allocations = tHeapAllocationCount;
+  for (size_t frame = 0; frame < 16u; frame++) {
+    render_frame();
+  }
+  EXPECT_EQ(tHeapAllocationCount, heap_allocations);
+  scheduler.RemoveTarget(&target);
+}
+
+TEST_F(PlaygroundTest, RenderGraphCullsPassesAndAliasesImages) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  RenderGraph graph(context);
+  const RenderGraphImageDesc desc = {vk::Format::eR8G8B8A8Unorm, {256u, 256u}};
+  const auto a = graph.CreateImage("a", desc);
+  const auto b = graph.CreateImage("b", desc);
+  const auto c = graph.CreateImage("c", desc);
+  const auto unused = graph.CreateImage("unused", desc);
+  const auto output = graph.ImportImage("output", desc,
+                                        vk::ImageLayout::eUndefined,
+                                        vk::ImageLayout::eTransferSrcOptimal);
+  graph.AddPass("a", nullptr)
+      .Overwrite(a, RenderGraphUsage::kColorAttachment);
+  graph.AddPass("b", nullptr)
+      .Read(a, RenderGraphUsage::kSampled)
+      .Overwrite(b, RenderGraphUsage::kColorAttachment);
+  graph.AddPass("c", nullptr)
+      .Read(b, RenderGraphUsage::kSampled)
+      .Overwrite(c, RenderGraphUsage::kColorAttachment);
+  graph.AddPass("unused", nullptr)
+      .Read(c, RenderGraphUsage::kSampled)
+      .Overwrite(unused, RenderGraphUsage::kColorAttachment);
+  graph.AddPass("output", nullptr)
+      .Read(c, RenderGraphUsage::kTransferSrc)
+      .Overwrite(output, RenderGraphUsage::kTransferDst);
+  ASSERT_TRUE(graph.Compile());
+
+  EXPECT_TRUE(graph.IsPassCulled("unused"));
+  EXPECT_FALSE(graph.IsPassCulled("a"));
+  EXPECT_FALSE(graph.IsPassCulled("output"));
+  EXPECT_FALSE(graph.GetImage(unused));
+  // A is done by the time C is first used so they can share memory.
+  EXPECT_LT(graph.GetTransientMemorySize(),
+            graph.GetUnaliasedTransientMemorySize());
+  // One barrier per use, plus the final transition of the output.
+  EXPECT_EQ(graph.GetBarrierCount(), 8u);
+
+  // The graph leaves the output in the transfer source layout.
+  ImageVK image;
+  ASSERT_TRUE(CreateImage(*context, image, desc.format, desc.extent,
+                          vk::ImageUsageFlagBits::eTransferDst |
+                              vk::ImageUsageFlagBits::eTransferSrc));
+
+  const auto command_buffer = MakeCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+
+  graph.SetImportedImage(output, *image.image);
+  ASSERT_EQ(command_buffer.begin(vk::CommandBufferBeginInfo{}),
+            vk::Result::eSuccess);
+  ASSERT_TRUE(graph.Execute(command_buffer));
+  ASSERT_EQ(command_buffer.end(), vk::Result::eSuccess);
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  const auto timeline_value = context->Submit(submit_info);
+  ASSERT_TRUE(timeline_value.has_value());
+  ASSERT_TRUE(context->WaitForTimelineValue(timeline_value.value()));
+}
+
+// Culls 1000 to max_count instances, every other one outside the view, and
+// draws the survivors into a 16x16 target. Instance i adds one to the red
+// channel of pixel i % 256.
+static void DrawCulledInstances(const std::shared_ptr<Context>& context,
+                                const vk::CommandBuffer& command_buffer,
+                                uint32_t max_count) {
+  const auto& device = context->GetDevice();
+  const RenderGraphImageDesc target_desc = {vk::Format::eR8G8B8A8Unorm,
+                                            {16u, 16u}};
+  auto [layout_result, pipeline_layout] =
+      device.createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo{});
+  ASSERT_EQ(layout_result, vk::Result::eSuccess);
+  auto pipeline = CreateTestPipeline(device, *pipeline_layout,
+                                     "cull_test.vert.spv",
+                                     "cull_test.frag.spv", target_desc.format,
+                                     true);
+  ASSERT_TRUE(pipeline);
+
+  FrameAllocator allocator(context, 1u, 4096u, 4096u);
+  ASSERT_TRUE(allocator.IsValid());
+  allocator.BeginFrame(0u);
+  const auto indices = allocator.AllocateDevice(3u * sizeof(uint32_t));
+  ASSERT_TRUE(indices.has_value());
+  const std::array<uint32_t, 3> index_data = {0u, 1u, 2u};
+  ::memcpy(indices->data, index_data.data(), indices->size);
+  ASSERT_TRUE(allocator.EndFrame());
+
+  auto readback = Readback::Make(
+      context, 1u, target_desc.extent.width * target_desc.extent.height * 4u);
+  ASSERT_TRUE(readback);
+
+  // The view looks down -Z, so instances in front of it have negative Z.
+  const auto frustum = GPUCuller::FrustumFromViewProjection(
+      glm::orthoRH_ZO(0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f));
+  for (uint32_t count = 1000u; count <= max_count; count *= 10u) {
+    auto culler = GPUCuller::Make(context, count);
+    ASSERT_TRUE(culler);
+    // Every other instance is outside the view.
+    std::vector<CullInstance> instances(count);
+    for (uint32_t i = 0; i < count; i++) {
+      instances[i].center = {(i % 2u == 0u) ? 0.5f : 2.5f, 0.5f, -0.5f};
+      instances[i].radius = 0.25f;
+      instances[i].index_count = 3u;
+    }
+    ASSERT_TRUE(culler->SetInstances(instances.data(), count));
+    culler->SetFrustum(frustum);
+
+    RenderGraph graph(context);
+    const auto resources = culler->AddPasses(graph);
+    const auto target = graph.CreateImage("target", target_desc);
+    graph
+        .AddPass("draw",
+                 [&](const vk::CommandBuffer& command_buffer) {
+                   vk::RenderingAttachmentInfo attachment;
+                   attachment.imageView = graph.GetImageView(target);
+                   attachment.imageLayout =
+                       vk::ImageLayout::eColorAttachmentOptimal;
+                   attachment.loadOp = vk::AttachmentLoadOp::eClear;
+                   attachment.storeOp = vk::AttachmentStoreOp::eStore;
+                   vk::RenderingInfo rendering;
+                   rendering.renderArea.extent = target_desc.extent;
+                   rendering.layerCount = 1u;
+                   rendering.setColorAttachments(attachment);
+                   command_buffer.beginRendering(rendering);
+                   command_buffer.bindPipeline(
+                       vk::PipelineBindPoint::eGraphics, *pipeline);
+                   command_buffer.setViewport(
+                       0u, vk::Viewport{
+                               0.0f, 0.0f,
+                               static_cast<float>(target_desc.extent.width),
+                               static_cast<float>(target_desc.extent.height),
+                               0.0f, 1.0f});
+                   command_buffer.setScissor(
+                       0u, vk::Rect2D{{}, target_desc.extent});
+                   command_buffer.bindIndexBuffer(indices->buffer,
+                                                  indices->offset,
+                                                  vk::IndexType::eUint32);
+                   culler->RecordDraws(command_buffer);
+                   command_buffer.endRendering();
+                 })
+        .Read(resources.draws, RenderGraphUsage::kIndirectBuffer)
+        .Read(resources.draw_count, RenderGraphUsage::kIndirectBuffer)
+        .Overwrite(target, RenderGraphUsage::kColorAttachment);
+    bool capture = false;
+    std::unique_ptr<fml::Mapping> pixels;
+    graph
+        .AddPass("capture",
+                 [&](const vk::CommandBuffer& command_buffer) {
+                   if (!capture) {
+                     return;
+                   }
+                   readback->Record(
+                       command_buffer, graph.GetImage(target),
+                       vk::ImageLayout::eTransferSrcOptimal,
+                       target_desc.extent, target_desc.format,
+                       [&](std::unique_ptr<fml::Mapping> p_pixels,
+                           vk::Extent2D) { pixels = std::move(p_pixels); });
+                 })
+        .Read(target, RenderGraphUsage::kTransferSrc)
+        .HasSideEffects();
+    ASSERT_TRUE(graph.Compile());
+    culler->SetGraphResources(graph, resources);
+
+    // Only recording the frame is timed. The graph is built once.
+    static constexpr size_t kRecordCount = 10u;
+    std::chrono::steady_clock::duration record_time = {};
+    for (size_t i = 0; i < kRecordCount; i++) {
+      capture = i + 1u == kRecordCount;
+      const auto start = std::chrono::steady_clock::now();
+      ASSERT_EQ(command_buffer.begin(vk::CommandBufferBeginInfo{}),
+                vk::Result::eSuccess);
+      ASSERT_TRUE(graph.Execute(command_buffer));
+      ASSERT_EQ(command_buffer.end(), vk::Result::eSuccess);
+      record_time += std::chrono::steady_clock::now() - start;
+    }
+    FML_LOG(INFO) << count << " instances recorded in "
+                  << std::chrono::duration<double, std::micro>(record_time)
+                             .count() /
+                         kRecordCount
+                  << "us";
+
+    vk::SubmitInfo submit_info;
+    submit_info.setCommandBuffers(command_buffer);
+    const auto timeline_value = context->Submit(submit_info);
+    ASSERT_TRUE(timeline_value.has_value());
+    readback->Submitted(timeline_value.value());
+    ASSERT_TRUE(context->WaitForTimelineValue(timeline_value.value()));
+    ASSERT_TRUE(readback->Flush());
+    EXPECT_EQ(culler->GetVisibleCount(), count / 2u);
+    ASSERT_TRUE(pixels);
+    // Instance i is drawn to pixel i % 256, so this checks gl_InstanceIndex
+    // too.
+    const auto pixel_count = target_desc.extent.width *
+                             target_desc.extent.height;
+    ASSERT_EQ(pixels->GetSize(), pixel_count * 4u);
+    std::vector<uint32_t> expected(pixel_count);
+    for (uint32_t i = 0; i < count; i += 2u) {
+      expected[i % pixel_count]++;
+    }
+    for (uint32_t i = 0; i < pixel_count; i++) {
+      EXPECT_EQ(pixels->GetMapping()[i * 4u], std::min(expected[i], 255u))
+          << "Pixel " << i << " of " << count << " instances.";
+    }
+  }
+}
+
+TEST_F(PlaygroundTest, GPUCullerDrawsVisibleInstances) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  if (!context->SupportsIndirectDrawCount()) {
+    GTEST_SKIP() << "Device doesn't support indirect draw counts.";
+  }
+  const auto command_buffer = MakeCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+  DrawCulledInstances(context, command_buffer, 1000u);
+}
+
+// A benchmark, run with --gtest_also_run_disabled_tests.
+TEST_F(PlaygroundTest, DISABLED_GPUCullerCostDoesNotDependOnInstanceCount) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  if (!context->SupportsIndirectDrawCount()) {
+    GTEST_SKIP() << "Device doesn't support indirect draw counts.";
+  }
+  const auto command_buffer = MakeCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+  DrawCulledInstances(context, command_buffer, 1000000u);
+}
+
+TEST_F(PlaygroundTest, FrameSchedulerRendersManyTargets) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  std::vector<std::unique_ptr<HeadlessTarget>> targets;
+  FrameScheduler scheduler(context);
+  std::mutex captures_mutex;
+  std::map<uint32_t, size_t> captures;
+  for (uint32_t width = 64u; width <= 256u; width *= 2u) {
+    auto target =
+        std::make_unique<HeadlessTarget>(context, vk::Extent2D{width, 32u});
+    ASSERT_TRUE(target->IsValid());
+    ASSERT_TRUE(target->SetCaptureCallback(
+        [&](std::unique_ptr<fml::Mapping> pixels, vk::Extent2D extent) {
+          ASSERT_TRUE(pixels);
+          std::scoped_lock lock(captures_mutex);
+          captures[extent.width]++;
+        }));
+    scheduler.AddTarget(target.get());
+    targets.emplace_back(std::move(target));
+  }
+  ASSERT_EQ(scheduler.GetTargetCount(), 3u);
+
+  const auto submitted = context->GetLastSubmittedTimelineValue();
+  static constexpr size_t kFrameCount = 5u;
+  for (size_t frame = 0; frame < kFrameCount; frame++) {
+    const auto& results = scheduler.RenderFrame();
+    ASSERT_EQ(results.size(), targets.size());
+    for (const auto result : results) {
+      ASSERT_EQ(result, vk::Result::eSuccess);
+    }
+  }
+  // One submission per frame regardless of the number of targets.
+  EXPECT_EQ(context->GetLastSubmittedTimelineValue(), submitted + kFrameCount);
+
+  for (const auto& target : targets) {
+    ASSERT_TRUE(target->FlushCaptures());
+    scheduler.RemoveTarget(target.get());
+  }
+  std::scoped_lock lock(captures_mutex);
+  ASSERT_EQ(captures.size(), targets.size());
+  for (const auto& [width, count] : captures) {
+    EXPECT_GT(count, 0u);
+  }
+}
+
+TEST_F(PlaygroundTest, FrameSchedulerPresentsSwapchainsTogether) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  auto swapchain = MakeWindowSwapchain();
+  ASSERT_TRUE(swapchain);
+  HeadlessTarget headless(context, vk::Extent2D{64u, 64u});
+  ASSERT_TRUE(headless.IsValid());
+  FrameScheduler scheduler(context);
+  // The headless target between the swapchains doesn't present, so the
+  // present results must be mapped back to the right targets.
+  scheduler.AddTarget(&GetSwapchain());
+  scheduler.AddTarget(&headless);
+  scheduler.AddTarget(swapchain.get());
+
+  const auto submitted = context->GetLastSubmittedTimelineValue();
+  static constexpr size_t kFrameCount = 8u;
+  for (size_t frame = 0; frame < kFrameCount; frame++) {
+    const auto& results = scheduler.RenderFrame();
+    ASSERT_EQ(results.size(), 3u);
+    for (const size_t i : {0u, 2u}) {
+      EXPECT_TRUE(results[i] == vk::Result::eSuccess ||
+                  results[i] == vk::Result::eSuboptimalKHR)
+          << vk::to_string(results[i]);
+    }
+    EXPECT_EQ(results[1], vk::Result::eSuccess);
+  }
+  EXPECT_EQ(context->GetLastSubmittedTimelineValue(), submitted + kFrameCount);
+}
+
+// Acquires and submits the frames of another target but fails to record them.
+class FailingRecordTarget final : public RenderTarget {
+ public:
+  explicit FailingRecordTarget(RenderTarget& target) : target_(target) {}
+
+  bool IsValid() const override { return target_.IsValid(); }
+
+  std::optional<Frame> AcquireFrame() override {
+    return target_.AcquireFrame();
+  }
+
+  bool RecordFrame() override { return false; }
+
+  bool RecordReleaseFrame() override { return target_.RecordReleaseFrame(); }
+
+  void FrameSubmitted(uint64_t timeline_value) override {
+    target_.FrameSubmitted(timeline_value);
+  }
+
+  void FrameDiscarded() override { target_.FrameDiscarded(); }
+
+ private:
+  RenderTarget& target_;
+};
+
+TEST_F(PlaygroundTest, FrameSchedulerReleasesImagesOfFailedFrames) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  FailingRecordTarget failing(GetSwapchain());
+  FrameScheduler scheduler(context);
+  scheduler.AddTarget(&failing);
+
+  // Were the images of failed frames kept, acquiring would time out once the
+  // swapchain runs out of them.
+  const auto submitted = context->GetLastSubmittedTimelineValue();
+  static constexpr size_t kFrameCount = 16u;
+  for (size_t frame = 0; frame < kFrameCount; frame++) {
+    const auto& results = scheduler.RenderFrame();
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results.front(), vk::Result::eNotReady);
+  }
+  EXPECT_EQ(context->GetLastSubmittedTimelineValue(), submitted + kFrameCount);
+}
+
 TEST_F(PlaygroundTest, CanShowWindow) {
   ASSERT_TRUE(OpenPlaygroundHere());
 }
 
+TEST_F(PlaygroundTest, CanReadbackImage) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  const vk::Extent2D extent = {64u, 32u};
+
+  ImageVK image;
+  ASSERT_TRUE(CreateImage(*context, image, vk::Format::eR8G8B8A8Unorm, extent,
+                          vk::ImageUsageFlagBits::eTransferSrc |
+                              vk::ImageUsageFlagBits::eTransferDst));
+
+  const auto command_buffer = MakeCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+
+  ASSERT_EQ(command_buffer.begin(vk::CommandBufferBeginInfo{}),
+            vk::Result::eSuccess);
+  vk::ImageMemoryBarrier barrier;
+  barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+  barrier.oldLayout = vk::ImageLayout::eUndefined;
+  barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = *image.image;
+  barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+  barrier.subresourceRange.levelCount = 1u;
+  barrier.subresourceRange.layerCount = 1u;
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                                 vk::PipelineStageFlagBits::eTransfer, {}, {},
+                                 {}, barrier);
+  command_buffer.clearColorImage(
+      *image.image, vk::ImageLayout::eTransferDstOptimal,
+      vk::ClearColorValue{std::array<float, 4>{1.0f, 0.0f, 1.0f, 1.0f}},
+      barrier.subresourceRange);
+  ASSERT_EQ(command_buffer.end(), vk::Result::eSuccess);
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  ASSERT_TRUE(context->Submit(submit_info).has_value());
+
+  auto readback =
+      Readback::Make(context, 2u, extent.width * extent.height * 4u);
+  ASSERT_TRUE(readback);
+  std::shared_ptr<fml::Mapping> pixels;
+  ASSERT_TRUE(readback->Capture(
+      *image.image, vk::ImageLayout::eTransferDstOptimal, extent,
+      vk::Format::eR8G8B8A8Unorm,
+      [&](std::unique_ptr<fml::Mapping> p_pixels, vk::Extent2D) {
+        pixels = std::move(p_pixels);
+      }));
+  ASSERT_TRUE(readback->Flush());
+  ASSERT_TRUE(pixels);
+  ASSERT_EQ(pixels->GetSize(), extent.width * extent.height * 4u);
+  for (size_t i = 0; i < pixels->GetSize(); i += 4u) {
+    ASSERT_EQ(pixels->GetMapping()[i + 0], 255u);
+    ASSERT_EQ(pixels->GetMapping()[i + 1], 0u);
+    ASSERT_EQ(pixels->GetMapping()[i + 2], 255u);
+    ASSERT_EQ(pixels->GetMapping()[i + 3], 255u);
+  }
+
+  // PNG encoding must be lossless.
+  const auto size = glm::ivec2{static_cast<int>(extent.width),
+                               static_cast<int>(extent.height)};
+  fml::AutoResetWaitableEvent encoded_event;
+  std::unique_ptr<fml::Mapping> png;
+  EncodePNGAsync(context->GetConcurrentTaskRunner(), pixels, size,
+                 [&](std::unique_ptr<fml::Mapping> p_png) {
+                   png = std::move(p_png);
+                   encoded_event.Signal();
+                 });
+  encoded_event.Wait();
+  ASSERT_TRUE(png);
+  ImageDecoder decoder(*png);
+  ASSERT_TRUE(decoder.IsValid());
+  ASSERT_EQ(decoder.GetSize(), size);
+  ASSERT_EQ(::memcmp(decoder.GetPixels()->GetMapping(), pixels->GetMapping(),
+                     pixels->GetSize()),
+            0);
+}
+
+TEST_F(PlaygroundTest, GPUJPEGDecoderMatchesCPUDecoder) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  auto airplane =
+      fml::FileMapping::CreateReadOnly(JUSTONE_ASSETS_LOCATION "airplane.jpg");
+  ASSERT_TRUE(airplane && airplane->IsValid());
+  ImageDecoder source(*airplane);
+  ASSERT_TRUE(source.IsValid());
+  std::shared_ptr<fml::Mapping> jpeg =
+      EncodeJPEG(*source.GetPixels(), source.GetSize());
+  ASSERT_TRUE(jpeg);
+  ImageDecoder expected(*jpeg);
+  ASSERT_TRUE(expected.IsValid());
+
+  auto decoder = GPUJPEGDecoder::Make(context);
+  ASSERT_TRUE(decoder);
+  // Submits happen off the context's threads.
+  fml::Thread submit_thread("jpeg.submit");
+  fml::AutoResetWaitableEvent decoded_event;
+  std::optional<DecodedImageVK> decoded;
+  decoder->DecodeAsync(jpeg, submit_thread.GetTaskRunner(),
+                       [&](std::optional<DecodedImageVK> image) {
+                         decoded = std::move(image);
+                         decoded_event.Signal();
+                       });
+  decoded_event.Wait();
+  ASSERT_TRUE(decoded.has_value());
+  ASSERT_TRUE(context->WaitForTimelineValue(decoded->timeline_value));
+  ASSERT_EQ(decoded->size, expected.GetSize());
+
+  const vk::Extent2D extent = {static_cast<uint32_t>(decoded->size.x),
+                               static_cast<uint32_t>(decoded->size.y)};
+  auto readback =
+      Readback::Make(context, 1u, extent.width * extent.height * 4u);
+  ASSERT_TRUE(readback);
+  std::unique_ptr<fml::Mapping> pixels;
+  ASSERT_TRUE(readback->Capture(
+      *decoded->image, vk::ImageLayout::eShaderReadOnlyOptimal, extent,
+      vk::Format::eR8G8B8A8Unorm,
+      [&](std::unique_ptr<fml::Mapping> p_pixels, vk::Extent2D) {
+        pixels = std::move(p_pixels);
+      }));
+  ASSERT_TRUE(readback->Flush());
+  ASSERT_TRUE(pixels);
+  ASSERT_EQ(pixels->GetSize(), expected.GetPixels()->GetSize());
+
+  // The IDCT and chroma upsampling differ slightly from stb's.
+  const auto error = CompareImages(*pixels, *expected.GetPixels());
+  EXPECT_LT(error.mean, 1.0);
+  EXPECT_LE(error.max, 8);
+}
+
+// A benchmark, run with --gtest_also_run_disabled_tests.
+TEST_F(PlaygroundTest, DISABLED_GPUJPEGDecoderWarmDecodeTime) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+  const auto jpeg = EncodeTestJPEG({4096, 4096});
+  ASSERT_TRUE(jpeg);
+  auto decoder = GPUJPEGDecoder::Make(context);
+  ASSERT_TRUE(decoder);
+
+  // Decodes are timed once the pipelines and the driver are warm.
+  static constexpr size_t kDecodeCount = 5u;
+  std::chrono::steady_clock::duration gpu_time = {};
+  for (size_t i = 0; i <= kDecodeCount; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto image = decoder->Decode(*jpeg);
+    ASSERT_TRUE(image.has_value());
+    ASSERT_TRUE(context->WaitForTimelineValue(image->timeline_value));
+    if (i > 0u) {
+      gpu_time += std::chrono::steady_clock::now() - start;
+    }
+  }
+  std::chrono::steady_clock::duration cpu_time = {};
+  for (size_t i = 0; i <= kDecodeCount; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    ImageDecoder image(*jpeg);
+    ASSERT_TRUE(image.IsValid());
+    if (i > 0u) {
+      cpu_time += std::chrono::steady_clock::now() - start;
+    }
+  }
+  FML_LOG(INFO) << "CPU decode: "
+                << std::chrono::duration<double, std::milli>(cpu_time).count() /
+                       kDecodeCount
+                << "ms GPU decode: "
+                << std::chrono::duration<double, std::milli>(gpu_time).count() /
+                       kDecodeCount
+                << "ms";
+}
+
+TEST(JustOne, VirtualTextureFileAveragesOddLevels) {
+  // Only the last column is red and only the last row green. Halving the odd
+  // sized level must not drop them.
+  const glm::ivec2 size = {243, 5};
+  std::vector<uint8_t> source(static_cast<size_t>(size.x) * size.y * 4u);
+  for (int y = 0; y < size.y; y++) {
+    for (int x = 0; x < size.x; x++) {
+      auto* pixel = source.data() + (static_cast<size_t>(y) * size.x + x) * 4u;
+      pixel[0] = x == size.x - 1 ? 255u : 0u;
+      pixel[1] = y == size.y - 1 ? 255u : 0u;
+      pixel[2] = 0u;
+      pixel[3] = 255u;
+    }
+  }
+  fml::ScopedTemporaryDirectory directory;
+  const auto path = directory.path() + "/image.vt";
+  ASSERT_TRUE(VirtualTextureFile::Write(
+      path, fml::NonOwnedMapping(source.data(), source.size()), size));
+  auto file = VirtualTextureFile::Make(path);
+  ASSERT_TRUE(file);
+  ASSERT_EQ(file->GetMipCount(), 3u);
+  ASSERT_EQ(file->GetMipSize(1u), glm::uvec2(121u, 2u));
+
+  static constexpr auto kContentSize = VirtualTextureFile::kPageContentSize;
+  static constexpr auto kBorder = VirtualTextureFile::kPageBorder;
+  const auto texel = [&](uint32_t x, uint32_t y) {
+    const auto* page = file->GetPageData(file->GetPageIndex(
+        {1u, x / kContentSize, y / kContentSize}));
+    return page + ((static_cast<size_t>(y % kContentSize) + kBorder) *
+                       VirtualTextureFile::kPageSize +
+                   x % kContentSize + kBorder) *
+                      4u;
+  };
+  // The last column and row each average three of level zero.
+  EXPECT_EQ(texel(120u, 0u)[0], 85u);
+  EXPECT_EQ(texel(119u, 0u)[0], 0u);
+  EXPECT_EQ(texel(0u, 1u)[1], 85u);
+  EXPECT_EQ(texel(0u, 0u)[1], 0u);
+  EXPECT_EQ(texel(120u, 1u)[3], 255u);
+}
+
+TEST_F(PlaygroundTest, VirtualTextureStreamsVisiblePages) {
+  ASSERT_TRUE(IsValid());
+  const auto& context = GetContext();
+
+  const glm::ivec2 size = {2000, 1000};
+  std::vector<uint8_t> source(static_cast<size_t>(size.x) * size.y * 4u);
+  for (int y = 0; y < size.y; y++) {
+    for (int x = 0; x < size.x; x++) {
+      auto* pixel = source.data() + (static_cast<size_t>(y) * size.x + x) * 4u;
+      pixel[0] = static_cast<uint8_t>(x);
+      pixel[1] = static_cast<uint8_t>(y);
+      pixel[2] = static_cast<uint8_t>((x / 8) ^ (y / 8));
+      pixel[3] = 255u;
+    }
+  }
+  fml::ScopedTemporaryDirectory directory;
+  const auto path = directory.path() + "/image.vt";
+  ASSERT_TRUE(VirtualTextureFile::Write(
+      path, fml::NonOwnedMapping(source.data(), source.size()), size));
+  std::shared_ptr<VirtualTextureFile> file = VirtualTextureFile::Make(path);
+  ASSERT_TRUE(file);
+  EXPECT_EQ(file->GetSize(), size);
+  EXPECT_EQ(file->GetPageGrid(file->GetMipCount() - 1u),
+            glm::uvec2(1u, 1u));
+
+  // Room for 15 pages besides the coarsest one.
+  auto texture = VirtualTexture::Make(context, file, 1u, 4u);
+  ASSERT_TRUE(texture);
+
+  const vk::Extent2D extent = {256u, 256u};
+  auto readback =
+      Readback::Make(context, 1u, extent.width * extent.height * 4u);
+  ASSERT_TRUE(readback);
+  bool capture = false;
+  std::unique_ptr<fml::Mapping> pixels;
+
+  RenderGraph graph(context);
+  const auto target =
+      graph.CreateImage("view", {vk::Format::eR8G8B8A8Unorm, extent});
+  const auto resources = texture->AddPasses(graph, target, extent);
+  graph
+      .AddPass("capture",
+               [&](const vk::CommandBuffer& command_buffer) {
+                 if (!capture) {
+                   return;
+                 }
+                 ASSERT_TRUE(readback->Record(
+                     command_buffer, graph.GetImage(target),
+                     vk::ImageLayout::eTransferSrcOptimal, extent,
+                     vk::Format::eR8G8B8A8Unorm,
+                     [&](std::unique_ptr<fml::Mapping> p_pixels,
+                         vk::Extent2D) { pixels = std::move(p_pixels); }));
+               })
+      .Read(target, RenderGraphUsage::kTransferSrc)
+      .HasSideEffects();
+  ASSERT_TRUE(graph.Compile());
+  texture->SetGraphResources(graph, resources);
+
+  const auto command_buffer = MakeCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+
+  const auto render_view = [&](glm::vec2 origin) {
+    texture->SetView({origin, 1.0f});
+    pixels.reset();
+    // Pages requested by a frame are uploaded in the next one.
+    for (size_t frame = 0; frame < 3u; frame++) {
+      capture = frame == 2u;
+      ASSERT_TRUE(texture->BeginFrame(0u));
+      ASSERT_EQ(command_buffer.begin(vk::CommandBufferBeginInfo{}),
+                vk::Result::eSuccess);
+      ASSERT_TRUE(graph.Execute(command_buffer));
+      ASSERT_EQ(command_buffer.end(), vk::Result::eSuccess);
+      vk::SubmitInfo submit_info;
+      submit_info.setCommandBuffers(command_buffer);
+      const auto timeline_value = context->Submit(submit_info);
+      ASSERT_TRUE(timeline_value.has_value());
+      readback->Submitted(timeline_value.value());
+      ASSERT_TRUE(context->WaitForTimelineValue(timeline_value.value()));
+    }
+    ASSERT_TRUE(readback->Flush());
+    ASSERT_TRUE(pixels);
+    EXPECT_EQ(texture->GetMissingPageCount(), 0u);
+
+    int max_error = 0;
+    for (uint32_t y = 0; y < extent.height; y++) {
+      for (uint32_t x = 0; x < extent.width; x++) {
+        const auto* actual = pixels->GetMapping() + (y * extent.width + x) * 4u;
+        const auto* expected =
+            source.data() + ((static_cast<size_t>(origin.y) + y) * size.x +
+                             static_cast<size_t>(origin.x) + x) *
+                                4u;
+        for (size_t c = 0; c < 4u; c++) {
+          max_error = std::max(max_error, std::abs(actual[c] - expected[c]));
+        }
+      }
+    }
+    EXPECT_LE(max_error, 1);
+  };
+
+  // Each view needs 3 by 3 pages of level zero.
+  render_view({300.0f, 200.0f});
+  EXPECT_EQ(texture->GetResidentPageCount(), 10u);
+  render_view({1500.0f, 700.0f});
+  // Panning replaced the least recently used pages.
+  EXPECT_EQ(texture->GetResidentPageCount(), 16u);
+  EXPECT_EQ(texture->GetUploadedPageCount(), 19u);
+  FML_LOG(INFO) << "Page cache: " << texture->GetPageCacheSize() / 1024u
+                << "KiB for a " << size.x << "x" << size.y << " image";
+}
+
 }  // namespace one::testing
@@ -0,0 +1,651 @@
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <functional>
+
+#include "context.h"
+#include "fml/logging.h"
+#include "glm/glm/ext/vector_uint2.hpp"
+#include "glm/glm/ext/vector_uint4.hpp"
+
+namespace one {
+
+static constexpr vk::Format kPageCacheFormat = vk::Format::eR8G8B8A8Unorm;
+static constexpr uint32_t kWorkgroupSize = 8u;
+// Matches virtual_texture_feedback.comp.
+static constexpr uint32_t kFeedbackScale = 4u;
+// Matches virtual_texture.glsl.
+static constexpr uint32_t kResidentBit = 0x80000000u;
+static constexpr uint32_t kMaxCachePages = 0x7fffu;
+// The slot that holds the single page of the coarsest level.
+static constexpr uint32_t kPinnedSlot = 0u;
+
+// Matches PushConstants in virtual_texture.glsl.
+struct VirtualTexturePushConstants {
+  glm::vec2 origin = {};
+  float scale = 1.0f;
+  uint32_t mip_count = 0u;
+  glm::uvec2 extent = {};
+  uint32_t feedback_offset = 0u;
+  uint32_t cache_pages = 0u;
+};
+
+static_assert(sizeof(VirtualTexturePushConstants) == 32u);
+
+static uint32_t DivideRoundingUp(uint32_t value, uint32_t divisor) {
+  return (value + divisor - 1u) / divisor;
+}
+
+std::unique_ptr<VirtualTexture> VirtualTexture::Make(
+    const std::shared_ptr<Context>& context,
+    std::shared_ptr<VirtualTextureFile> file,
+    size_t frame_count,
+    uint32_t cache_pages,
+    uint32_t max_uploads_per_frame) {
+  auto texture = std::unique_ptr<VirtualTexture>(
+      new VirtualTexture(context, std::move(file), frame_count, cache_pages,
+                         max_uploads_per_frame));
+  if (!texture->IsValid()) {
+    return nullptr;
+  }
+  return texture;
+}
+
+VirtualTexture::VirtualTexture(const std::shared_ptr<Context>& context,
+                               std::shared_ptr<VirtualTextureFile> file,
+                               size_t frame_count,
+                               uint32_t cache_pages,
+                               uint32_t max_uploads_per_frame)
+    : context_(context),
+      file_(std::move(file)),
+      cache_pages_(cache_pages),
+      max_uploads_per_frame_(max_uploads_per_frame) {
+  if (!context || !file_ || frame_count == 0u ||
+      max_uploads_per_frame_ == 0u) {
+    return;
+  }
+  const auto max_dimension =
+      context->GetPhysicalDevice().getProperties().limits.maxImageDimension2D;
+  if (cache_pages_ < 2u || cache_pages_ > kMaxCachePages ||
+      cache_pages_ * VirtualTextureFile::kPageSize > max_dimension) {
+    FML_LOG(ERROR) << "Invalid page cache size " << cache_pages_;
+    return;
+  }
+
+  const auto& device = context->GetDevice();
+  const auto page_count = file_->GetPageCount();
+  const auto cache_size = cache_pages_ * VirtualTextureFile::kPageSize;
+
+  {
+    if (!CreateImage(*context, page_cache_, kPageCacheFormat,
+                     vk::Extent2D{cache_size, cache_size},
+                     vk::ImageUsageFlagBits::eSampled |
+                         vk::ImageUsageFlagBits::eTransferDst)) {
+      FML_LOG(ERROR) << "Could not create the page cache.";
+      return;
+    }
+    page_cache_size_ =
+        device.getImageMemoryRequirements(*page_cache_.image).size;
+
+    // Pages carry their own borders so filtering never crosses into the
+    // neighboring slot.
+    vk::SamplerCreateInfo sampler_info;
+    sampler_info.magFilter = vk::Filter::eLinear;
+    sampler_info.minFilter = vk::Filter::eLinear;
+    sampler_info.mipmapMode = vk::SamplerMipmapMode::eNearest;
+    sampler_info.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    sampler_info.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    sampler_info.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    auto [sampler_result, sampler] = device.createSamplerUnique(sampler_info);
+    if (sampler_result != vk::Result::eSuccess) {
+      return;
+    }
+    sampler_ = std::move(sampler);
+  }
+
+  feedback_words_ = DivideRoundingUp(page_count, 32u);
+  staging_frame_size_ =
+      max_uploads_per_frame_ * VirtualTextureFile::kPageBytes +
+      // An entry for each upload and for the page it replaces.
+      2u * max_uploads_per_frame_ * sizeof(uint32_t);
+  if (!CreateBuffer(*context, page_table_, page_count * sizeof(uint32_t),
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eTransferDst,
+                    false) ||
+      !CreateBuffer(*context, levels_,
+                    file_->GetMipCount() * sizeof(glm::uvec4),
+                    vk::BufferUsageFlagBits::eStorageBuffer, true) ||
+      !CreateBuffer(*context, feedback_,
+                    frame_count * feedback_words_ * sizeof(uint32_t),
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eTransferDst,
+                    true) ||
+      !CreateBuffer(*context, staging_, frame_count * staging_frame_size_,
+                    vk::BufferUsageFlagBits::eTransferSrc, true)) {
+    FML_LOG(ERROR) << "Could not allocate virtual texture buffers.";
+    return;
+  }
+  auto* levels = static_cast<glm::uvec4*>(levels_.mapping);
+  for (uint32_t mip = 0; mip < file_->GetMipCount(); mip++) {
+    const auto mip_size = file_->GetMipSize(mip);
+    levels[mip] = {mip_size.x, mip_size.y, file_->GetFirstPageIndex(mip), 0u};
+  }
+  std::memset(feedback_.mapping, 0,
+              frame_count * feedback_words_ * sizeof(uint32_t));
+
+  {
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+      bindings[i].binding = i;
+      bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+      bindings[i].descriptorCount = 1u;
+      bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+    bindings.front().descriptorType =
+        vk::DescriptorType::eCombinedImageSampler;
+    vk::DescriptorSetLayoutCreateInfo layout_info;
+    layout_info.setBindings(bindings);
+    auto [result, layout] = device.createDescriptorSetLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_layout_ = std::move(layout);
+  }
+
+  // The target may change every frame, so it lives in a set of its own for
+  // each frame that is written before it is bound.
+  {
+    vk::DescriptorSetLayoutBinding binding;
+    binding.binding = 0u;
+    binding.descriptorType = vk::DescriptorType::eStorageImage;
+    binding.descriptorCount = 1u;
+    binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    vk::DescriptorSetLayoutCreateInfo layout_info;
+    layout_info.setBindings(binding);
+    auto [result, layout] = device.createDescriptorSetLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    target_descriptor_set_layout_ = std::move(layout);
+  }
+
+  {
+    const std::array<vk::DescriptorPoolSize, 3> pool_sizes = {
+        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 1u},
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 3u},
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageImage,
+                               static_cast<uint32_t>(frame_count)},
+    };
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.maxSets = 1u + static_cast<uint32_t>(frame_count);
+    pool_info.setPoolSizes(pool_sizes);
+    auto [pool_result, pool] = device.createDescriptorPoolUnique(pool_info);
+    if (pool_result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_pool_ = std::move(pool);
+
+    std::vector<vk::DescriptorSetLayout> set_layouts(
+        frame_count, *target_descriptor_set_layout_);
+    set_layouts.push_back(*descriptor_set_layout_);
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info.descriptorPool = *descriptor_pool_;
+    set_info.setSetLayouts(set_layouts);
+    auto [sets_result, sets] = device.allocateDescriptorSets(set_info);
+    if (sets_result != vk::Result::eSuccess) {
+      return;
+    }
+    descriptor_set_ = sets.back();
+    frames_.resize(frame_count);
+    for (size_t i = 0; i < frame_count; i++) {
+      frames_[i].target_descriptor_set = sets[i];
+    }
+
+    vk::DescriptorImageInfo image_info;
+    image_info.sampler = *sampler_;
+    image_info.imageView = *page_cache_.view;
+    image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    const std::array<vk::DescriptorBufferInfo, 3> buffer_infos = {
+        vk::DescriptorBufferInfo{*page_table_.buffer, 0u, VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{*levels_.buffer, 0u, VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{*feedback_.buffer, 0u, VK_WHOLE_SIZE},
+    };
+    std::array<vk::WriteDescriptorSet, 4> writes;
+    for (uint32_t i = 0; i < writes.size(); i++) {
+      writes[i].dstSet = descriptor_set_;
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1u;
+      if (i == 0u) {
+        writes[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        writes[i].pImageInfo = &image_info;
+      } else {
+        writes[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        writes[i].pBufferInfo = &buffer_infos[i - 1u];
+      }
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+
+  {
+    vk::PushConstantRange push_constants;
+    push_constants.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constants.size = sizeof(VirtualTexturePushConstants);
+
+    const std::array<vk::DescriptorSetLayout, 2> set_layouts = {
+        *descriptor_set_layout_, *target_descriptor_set_layout_};
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setSetLayouts(set_layouts);
+    layout_info.setPushConstantRanges(push_constants);
+    auto [result, layout] = device.createPipelineLayoutUnique(layout_info);
+    if (result != vk::Result::eSuccess) {
+      return;
+    }
+    pipeline_layout_ = std::move(layout);
+  }
+
+  feedback_pipeline_ = CreateComputePipeline(
+      device, *pipeline_layout_, "virtual_texture_feedback.comp.spv");
+  draw_pipeline_ = CreateComputePipeline(device, *pipeline_layout_,
+                                         "virtual_texture_draw.comp.spv");
+  if (!feedback_pipeline_ || !draw_pipeline_) {
+    return;
+  }
+
+  page_slots_.resize(page_count);
+  slots_.resize(cache_pages_ * cache_pages_);
+  for (uint32_t slot = 0; slot < slots_.size(); slot++) {
+    if (slot != kPinnedSlot) {
+      slots_[slot].lru_position = lru_.insert(lru_.end(), slot);
+    }
+  }
+
+  if (!Initialize(*context)) {
+    FML_LOG(ERROR) << "Could not initialize the virtual texture.";
+    return;
+  }
+
+  is_valid_ = true;
+}
+
+VirtualTexture::~VirtualTexture() = default;
+
+// Clears the page cache and empties the page table in a submission of its
+// own.
+bool VirtualTexture::Initialize(Context& context) {
+  const auto& device = context.GetDevice();
+
+  vk::CommandPoolCreateInfo pool_info;
+  pool_info.flags = vk::CommandPoolCreateFlagBits::eTransient;
+  pool_info.queueFamilyIndex = context.GetQueueIndex().family;
+  auto [pool_result, pool] = device.createCommandPoolUnique(pool_info);
+  if (pool_result != vk::Result::eSuccess) {
+    return false;
+  }
+  vk::CommandBufferAllocateInfo command_buffer_info;
+  command_buffer_info.commandPool = *pool;
+  command_buffer_info.level = vk::CommandBufferLevel::ePrimary;
+  command_buffer_info.commandBufferCount = 1u;
+  auto [command_buffers_result, command_buffers] =
+      device.allocateCommandBuffers(command_buffer_info);
+  if (command_buffers_result != vk::Result::eSuccess) {
+    return false;
+  }
+  const auto& command_buffer = command_buffers.front();
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  if (command_buffer.begin(begin_info) != vk::Result::eSuccess) {
+    return false;
+  }
+
+  vk::ImageSubresourceRange range;
+  range.aspectMask = vk::ImageAspectFlagBits::eColor;
+  range.levelCount = 1u;
+  range.layerCount = 1u;
+
+  vk::ImageMemoryBarrier2 image_barrier;
+  image_barrier.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+  image_barrier.dstStageMask = vk::PipelineStageFlagBits2::eClear;
+  image_barrier.dstAccessMask = vk::AccessFlagBits2::eTransferWrite;
+  image_barrier.oldLayout = vk::ImageLayout::eUndefined;
+  image_barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+  image_barrier.image = *page_cache_.image;
+  image_barrier.subresourceRange = range;
+  vk::DependencyInfo dependency_info;
+  dependency_info.setImageMemoryBarriers(image_barrier);
+  command_buffer.pipelineBarrier2(dependency_info);
+
+  command_buffer.clearColorImage(*page_cache_.image,
+                                 vk::ImageLayout::eTransferDstOptimal,
+                                 vk::ClearColorValue{}, range);
+  command_buffer.fillBuffer(*page_table_.buffer, 0u, VK_WHOLE_SIZE, 0u);
+
+  image_barrier.srcStageMask = vk::PipelineStageFlagBits2::eClear;
+  image_barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+  image_barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader |
+                               vk::PipelineStageFlagBits2::eFragmentShader;
+  image_barrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+  image_barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+  image_barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+  vk::MemoryBarrier2 memory_barrier;
+  memory_barrier.srcStageMask = vk::PipelineStageFlagBits2::eClear;
+  memory_barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+  memory_barrier.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+  memory_barrier.dstAccessMask = vk::AccessFlagBits2::eMemoryRead |
+                                 vk::AccessFlagBits2::eMemoryWrite;
+  dependency_info.setImageMemoryBarriers(image_barrier);
+  dependency_info.setMemoryBarriers(memory_barrier);
+  command_buffer.pipelineBarrier2(dependency_info);
+
+  if (command_buffer.end() != vk::Result::eSuccess) {
+    return false;
+  }
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  const auto timeline_value = context.Submit(submit_info);
+  if (!timeline_value.has_value()) {
+    return false;
+  }
+  context.GetDeletionQueue().Enqueue(std::move(pool), timeline_value.value());
+  return true;
+}
+
+bool VirtualTexture::IsValid() const {
+  return is_valid_;
+}
+
+const VirtualTextureFile& VirtualTexture::GetFile() const {
+  return *file_;
+}
+
+void VirtualTexture::TouchSlot(uint32_t slot) {
+  slots_[slot].last_used_frame = frame_number_;
+  if (slot != kPinnedSlot) {
+    lru_.splice(lru_.end(), lru_, slots_[slot].lru_position);
+  }
+}
+
+std::optional<uint32_t> VirtualTexture::AcquireSlot() {
+  if (lru_.empty()) {
+    return std::nullopt;
+  }
+  const auto slot = lru_.front();
+  // Everything in the cache is needed by this frame.
+  if (slots_[slot].page.has_value() &&
+      slots_[slot].last_used_frame == frame_number_) {
+    return std::nullopt;
+  }
+  return slot;
+}
+
+void VirtualTexture::StageTableEntry(uint32_t page, uint32_t entry) {
+  const auto offset =
+      frame_index_ * staging_frame_size_ +
+      max_uploads_per_frame_ * VirtualTextureFile::kPageBytes +
+      table_copies_.size() * sizeof(uint32_t);
+  std::memcpy(static_cast<uint8_t*>(staging_.mapping) + offset, &entry,
+              sizeof(entry));
+  table_copies_.push_back(
+      vk::BufferCopy{offset, page * sizeof(uint32_t), sizeof(uint32_t)});
+}
+
+void VirtualTexture::StagePage(uint32_t page, uint32_t slot) {
+  auto& cache_slot = slots_[slot];
+  if (cache_slot.page.has_value()) {
+    page_slots_[cache_slot.page.value()].reset();
+    StageTableEntry(cache_slot.page.value(), 0u);
+    resident_page_count_--;
+  }
+  cache_slot.page = page;
+  page_slots_[page] = slot;
+  resident_page_count_++;
+  uploaded_page_count_++;
+  TouchSlot(slot);
+
+  const auto slot_x = slot % cache_pages_;
+  const auto slot_y = slot / cache_pages_;
+  StageTableEntry(page, kResidentBit | (slot_y << 16u) | slot_x);
+
+  const auto offset = frame_index_ * staging_frame_size_ +
+                      page_copies_.size() * VirtualTextureFile::kPageBytes;
+  std::memcpy(static_cast<uint8_t*>(staging_.mapping) + offset,
+              file_->GetPageData(page), VirtualTextureFile::kPageBytes);
+  vk::BufferImageCopy copy;
+  copy.bufferOffset = offset;
+  copy.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  copy.imageSubresource.layerCount = 1u;
+  copy.imageOffset = vk::Offset3D{
+      static_cast<int32_t>(slot_x * VirtualTextureFile::kPageSize),
+      static_cast<int32_t>(slot_y * VirtualTextureFile::kPageSize), 0};
+  copy.imageExtent = vk::Extent3D{VirtualTextureFile::kPageSize,
+                                  VirtualTextureFile::kPageSize, 1u};
+  page_copies_.push_back(copy);
+}
+
+bool VirtualTexture::BeginFrame(size_t frame_index) {
+  if (!IsValid() || frame_index >= frames_.size()) {
+    return false;
+  }
+  frame_index_ = frame_index;
+  frame_number_++;
+  page_copies_.clear();
+  table_copies_.clear();
+
+  // The feedback was written the last time the frame index was used.
+  requests_.clear();
+  const auto* feedback =
+      static_cast<const uint32_t*>(feedback_.mapping) +
+      frame_index_ * feedback_words_;
+  for (uint32_t word = 0; word < feedback_words_; word++) {
+    for (uint32_t bits = feedback[word]; bits != 0u; bits &= bits - 1u) {
+      const uint32_t page =
+          word * 32u + static_cast<uint32_t>(std::countr_zero(bits));
+      if (page_slots_[page].has_value()) {
+        TouchSlot(page_slots_[page].value());
+      } else {
+        requests_.push_back(page);
+      }
+    }
+  }
+  missing_page_count_ = static_cast<uint32_t>(requests_.size());
+
+  const auto pinned_page = file_->GetPageCount() - 1u;
+  if (!page_slots_[pinned_page].has_value()) {
+    StagePage(pinned_page, kPinnedSlot);
+  }
+
+  // Coarser levels come later in the page order. Uploading them first gives
+  // the fallback for everything else the most detail soonest.
+  std::sort(requests_.begin(), requests_.end(), std::greater<uint32_t>());
+  for (const auto page : requests_) {
+    if (page_copies_.size() >= max_uploads_per_frame_) {
+      break;
+    }
+    if (page_slots_[page].has_value()) {
+      missing_page_count_--;
+      continue;
+    }
+    const auto slot = AcquireSlot();
+    if (!slot.has_value()) {
+      break;
+    }
+    StagePage(page, slot.value());
+    missing_page_count_--;
+  }
+  return true;
+}
+
+void VirtualTexture::SetView(const VirtualTextureView& view) {
+  view_ = view;
+}
+
+void VirtualTexture::RecordUploads(
+    const vk::CommandBuffer& command_buffer) const {
+  if (table_copies_.empty()) {
+    return;
+  }
+  // Earlier frames may still be reading the entries and slots replaced here.
+  vk::MemoryBarrier2 barrier;
+  barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader |
+                         vk::PipelineStageFlagBits2::eFragmentShader;
+  barrier.dstStageMask = vk::PipelineStageFlagBits2::eCopy;
+  vk::DependencyInfo dependency_info;
+  dependency_info.setMemoryBarriers(barrier);
+  command_buffer.pipelineBarrier2(dependency_info);
+
+  if (!page_copies_.empty()) {
+    command_buffer.copyBufferToImage(*staging_.buffer, *page_cache_.image,
+                                     vk::ImageLayout::eTransferDstOptimal,
+                                     page_copies_);
+  }
+  command_buffer.copyBuffer(*staging_.buffer, *page_table_.buffer,
+                            table_copies_);
+}
+
+void VirtualTexture::BindDescriptorSets(
+    const vk::CommandBuffer& command_buffer,
+    bool bind_target) const {
+  const std::array<vk::DescriptorSet, 2> sets = {
+      descriptor_set_, frames_[frame_index_].target_descriptor_set};
+  command_buffer.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, *pipeline_layout_, 0u,
+      bind_target ? 2u : 1u, sets.data(), 0u, nullptr);
+}
+
+void VirtualTexture::PushConstants(
+    const vk::CommandBuffer& command_buffer) const {
+  VirtualTexturePushConstants push_constants;
+  push_constants.origin = view_.origin;
+  push_constants.scale = view_.scale;
+  push_constants.mip_count = file_->GetMipCount();
+  push_constants.extent = {extent_.width, extent_.height};
+  push_constants.feedback_offset =
+      static_cast<uint32_t>(frame_index_ * feedback_words_);
+  push_constants.cache_pages = cache_pages_;
+  command_buffer.pushConstants<VirtualTexturePushConstants>(
+      *pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0u,
+      push_constants);
+}
+
+VirtualTexture::GraphResources VirtualTexture::AddPasses(
+    RenderGraph& graph,
+    RenderGraphResource target,
+    vk::Extent2D extent) {
+  extent_ = extent;
+  const auto cache_size = cache_pages_ * VirtualTextureFile::kPageSize;
+
+  GraphResources resources;
+  resources.page_cache = graph.ImportImage(
+      "virtual_texture_page_cache",
+      {kPageCacheFormat, {cache_size, cache_size}},
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal);
+  resources.page_table = graph.ImportBuffer("virtual_texture_page_table");
+  resources.feedback = graph.ImportBuffer("virtual_texture_feedback");
+
+  graph
+      .AddPass("virtual_texture_upload",
+               [this](const vk::CommandBuffer& command_buffer) {
+                 RecordUploads(command_buffer);
+               })
+      .Write(resources.page_cache, RenderGraphUsage::kTransferDst)
+      .Write(resources.page_table, RenderGraphUsage::kTransferDst);
+  graph
+      .AddPass("virtual_texture_feedback_clear",
+               [this](const vk::CommandBuffer& command_buffer) {
+                 command_buffer.fillBuffer(
+                     *feedback_.buffer,
+                     frame_index_ * feedback_words_ * sizeof(uint32_t),
+                     feedback_words_ * sizeof(uint32_t), 0u);
+               })
+      .Overwrite(resources.feedback, RenderGraphUsage::kTransferDst);
+  graph
+      .AddPass("virtual_texture_feedback",
+               [this](const vk::CommandBuffer& command_buffer) {
+                 command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                             *feedback_pipeline_);
+                 BindDescriptorSets(command_buffer, false);
+                 PushConstants(command_buffer);
+                 const auto count = [](uint32_t size) {
+                   const auto samples =
+                       DivideRoundingUp(size - 1u, kFeedbackScale) + 1u;
+                   return DivideRoundingUp(samples, kWorkgroupSize);
+                 };
+                 command_buffer.dispatch(count(extent_.width),
+                                         count(extent_.height), 1u);
+
+                 // For the next BeginFrame with the same frame index.
+                 vk::MemoryBarrier2 barrier;
+                 barrier.srcStageMask =
+                     vk::PipelineStageFlagBits2::eComputeShader;
+                 barrier.srcAccessMask =
+                     vk::AccessFlagBits2::eShaderStorageWrite;
+                 barrier.dstStageMask = vk::PipelineStageFlagBits2::eHost;
+                 barrier.dstAccessMask = vk::AccessFlagBits2::eHostRead;
+                 vk::DependencyInfo dependency_info;
+                 dependency_info.setMemoryBarriers(barrier);
+                 command_buffer.pipelineBarrier2(dependency_info);
+               })
+      .Write(resources.feedback, RenderGraphUsage::kStorage)
+      .HasSideEffects();
+  graph
+      .AddPass("virtual_texture_draw",
+               [this, &graph, target](const vk::CommandBuffer& command_buffer) {
+                 auto context = context_.lock();
+                 if (!context) {
+                   return;
+                 }
+                 vk::DescriptorImageInfo image_info;
+                 image_info.imageView = graph.GetImageView(target);
+                 image_info.imageLayout = vk::ImageLayout::eGeneral;
+                 vk::WriteDescriptorSet write;
+                 write.dstSet = frames_[frame_index_].target_descriptor_set;
+                 write.dstBinding = 0u;
+                 write.descriptorCount = 1u;
+                 write.descriptorType = vk::DescriptorType::eStorageImage;
+                 write.pImageInfo = &image_info;
+                 context->GetDevice().updateDescriptorSets(write, {});
+
+                 command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                             *draw_pipeline_);
+                 BindDescriptorSets(command_buffer, true);
+                 PushConstants(command_buffer);
+                 command_buffer.dispatch(
+                     DivideRoundingUp(extent_.width, kWorkgroupSize),
+                     DivideRoundingUp(extent_.height, kWorkgroupSize), 1u);
+               })
+      .Read(resources.page_cache, RenderGraphUsage::kSampled)
+      .Read(resources.page_table, RenderGraphUsage::kStorage)
+      .Overwrite(target, RenderGraphUsage::kStorage);
+  return resources;
+}
+
+void VirtualTexture::SetGraphResources(RenderGraph& graph,
+                                       const GraphResources& resources) const {
+  graph.SetImportedImage(resources.page_cache, *page_cache_.image,
+                         *page_cache_.view);
+  graph.SetImportedBuffer(resources.page_table, *page_table_.buffer);
+  graph.SetImportedBuffer(resources.feedback, *feedback_.buffer);
+}
+
+uint32_t VirtualTexture::GetResidentPageCount() const {
+  return resident_page_count_;
+}
+
+uint32_t VirtualTexture::GetMissingPageCount() const {
+  return missing_page_count_;
+}
+
+size_t VirtualTexture::GetUploadedPageCount() const {
+  return uploaded_page_count_;
+}
+
+vk::DeviceSize VirtualTexture::GetPageCacheSize() const {
+  return page_cache_size_;
+}
+
+}  // namespace one
@@ -0,0 +1,88 @@
+// Resources and lookups shared by the virtual texture shaders. Must match the
+// layout in virtual_texture.cc.
+
+const uint kPageSize = 128u;
+const uint kPageBorder = 4u;
+const uint kPageContentSize = kPageSize - 2u * kPageBorder;
+// Set in page table entries of resident pages. The low and high halves of the
+// rest hold the column and row of the page's cache slot.
+const uint kResidentBit = 0x80000000u;
+
+layout(set = 0, binding = 0) uniform sampler2D page_cache;
+
+layout(std430, set = 0, binding = 1) readonly buffer PageTable {
+  uint page_table[];
+};
+
+// The width and height of each level followed by the index of its first page.
+layout(std430, set = 0, binding = 2) readonly buffer Levels {
+  uvec4 levels[];
+};
+
+// A bit for each page the view needs, a run of words for each frame.
+layout(std430, set = 0, binding = 3) buffer Feedback {
+  uint feedback[];
+};
+
+layout(push_constant) uniform PushConstants {
+  vec2 origin;
+  float scale;
+  uint mip_count;
+  uvec2 extent;
+  uint feedback_offset;
+  uint cache_pages;
+}
+push_constants;
+
+// The level zero texel covered by the center of the target pixel.
+vec2 GetViewPosition(uvec2 pixel) {
+  return push_constants.origin + (vec2(pixel) + 0.5) * push_constants.scale;
+}
+
+// The level with about one texel per target pixel.
+uint GetViewMip() {
+  const float mip = floor(log2(max(push_constants.scale, 1.0)));
+  return uint(min(mip, float(push_constants.mip_count - 1u)));
+}
+
+bool IsInsideImage(vec2 position) {
+  return all(greaterThanEqual(position, vec2(0.0))) &&
+         all(lessThan(position, vec2(levels[0].xy)));
+}
+
+// The position in texels within the level.
+vec2 GetMipPosition(vec2 position, uint mip) {
+  return position / vec2(levels[0].xy) * vec2(levels[mip].xy);
+}
+
+uvec2 GetPageGrid(uint mip) {
+  return (levels[mip].xy + kPageContentSize - 1u) / kPageContentSize;
+}
+
+uvec2 GetPageCoordinates(vec2 mip_position, uint mip) {
+  return min(uvec2(mip_position / float(kPageContentSize)),
+             GetPageGrid(mip) - 1u);
+}
+
+uint GetPageIndex(uvec2 page, uint mip) {
+  return levels[mip].z + page.y * GetPageGrid(mip).x + page.x;
+}
+
+// Samples the finest resident level at or above the mip.
+vec4 SampleVirtualTexture(vec2 position, uint mip) {
+  for (; mip < push_constants.mip_count; mip++) {
+    const vec2 mip_position = GetMipPosition(position, mip);
+    const uvec2 page = GetPageCoordinates(mip_position, mip);
+    const uint entry = page_table[GetPageIndex(page, mip)];
+    if ((entry & kResidentBit) == 0u) {
+      continue;
+    }
+    const uvec2 slot = uvec2(entry & 0xffffu, (entry >> 16u) & 0x7fffu);
+    const vec2 texel = vec2(slot * kPageSize) + mip_position -
+                       vec2(page * kPageContentSize) + float(kPageBorder);
+    return textureLod(page_cache,
+                      texel / float(push_constants.cache_pages * kPageSize),
+                      0.0);
+  }
+  return vec4(0.0);
+}
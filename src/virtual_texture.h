@@ -0,0 +1,168 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "fml/macros.h"
+#include "glm/glm/ext/vector_float2.hpp"
+#include "render_graph.h"
+#include "virtual_texture_file.h"
+#include "vk.h"
+#include "vk_utils.h"
+
+namespace one {
+
+class Context;
+
+// The part of a virtual texture shown in a target.
+struct VirtualTextureView {
+  // The level zero texel at the top left corner of the target.
+  glm::vec2 origin = {};
+  // Level zero texels per target pixel. Larger values zoom out.
+  float scale = 1.0f;
+};
+
+// Shows images too large for a single vk::Image with bounded GPU memory. The
+// pages of a VirtualTextureFile are streamed into a fixed size page cache
+// texture, and a page table maps every page of the pyramid to its slot in the
+// cache. Shaders that find a page missing fall back to the next coarser
+// resident one. See virtual_texture.glsl for the shader side.
+//
+// Each frame, a feedback pass records which pages the view needs into a host
+// visible bitset. Once the GPU is done with the frame, the pages it requested
+// that aren't resident are uploaded, coarsest first and at most a fixed number
+// per frame, replacing the pages used least recently. The single page of the
+// coarsest level is always resident.
+class VirtualTexture {
+ public:
+  struct GraphResources {
+    RenderGraphResource page_cache = 0u;
+    RenderGraphResource page_table = 0u;
+    RenderGraphResource feedback = 0u;
+  };
+
+  // The page cache holds cache_pages by cache_pages pages.
+  static std::unique_ptr<VirtualTexture> Make(
+      const std::shared_ptr<Context>& context,
+      std::shared_ptr<VirtualTextureFile> file,
+      size_t frame_count,
+      uint32_t cache_pages = 16u,
+      uint32_t max_uploads_per_frame = 16u);
+
+  ~VirtualTexture();
+
+  bool IsValid() const;
+
+  const VirtualTextureFile& GetFile() const;
+
+  // The GPU must be done with the submissions of the last frame that used the
+  // same index. Reads back the pages that frame needed and stages the uploads
+  // of the ones that are missing.
+  bool BeginFrame(size_t frame_index);
+
+  void SetView(const VirtualTextureView& view);
+
+  // Adds passes that upload the staged pages, record the pages the view needs
+  // and draw the view into the target, an RGBA8 image of the given extent.
+  GraphResources AddPasses(RenderGraph& graph,
+                           RenderGraphResource target,
+                           vk::Extent2D extent);
+
+  // Binds the page cache, page table and feedback once the graph has been
+  // compiled.
+  void SetGraphResources(RenderGraph& graph,
+                         const GraphResources& resources) const;
+
+  uint32_t GetResidentPageCount() const;
+
+  // Pages needed by the last frame read back that are still not resident.
+  uint32_t GetMissingPageCount() const;
+
+  // The number of pages uploaded over the lifetime of the texture.
+  size_t GetUploadedPageCount() const;
+
+  // The GPU memory used by the page cache texture.
+  vk::DeviceSize GetPageCacheSize() const;
+
+ private:
+  struct CacheSlot {
+    std::optional<uint32_t> page;
+    uint64_t last_used_frame = 0u;
+    std::list<uint32_t>::iterator lru_position;
+  };
+
+  struct Frame {
+    vk::DescriptorSet target_descriptor_set;
+  };
+
+  std::weak_ptr<Context> context_;
+  std::shared_ptr<VirtualTextureFile> file_;
+  uint32_t cache_pages_ = 0u;
+  uint32_t max_uploads_per_frame_ = 0u;
+  VirtualTextureView view_;
+  vk::Extent2D extent_;
+  ImageVK page_cache_;
+  vk::DeviceSize page_cache_size_ = 0u;
+  vk::UniqueSampler sampler_;
+  BufferVK page_table_;
+  BufferVK levels_;
+  // A bitset of requested pages for each frame.
+  BufferVK feedback_;
+  uint32_t feedback_words_ = 0u;
+  // Page data and page table entries for each frame.
+  BufferVK staging_;
+  vk::DeviceSize staging_frame_size_ = 0u;
+  vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+  vk::UniqueDescriptorSetLayout target_descriptor_set_layout_;
+  vk::UniqueDescriptorPool descriptor_pool_;
+  vk::DescriptorSet descriptor_set_;
+  vk::UniquePipelineLayout pipeline_layout_;
+  vk::UniquePipeline feedback_pipeline_;
+  vk::UniquePipeline draw_pipeline_;
+  std::vector<Frame> frames_;
+  size_t frame_index_ = 0u;
+  uint64_t frame_number_ = 0u;
+  // The cache slot of each page if it is resident.
+  std::vector<std::optional<uint32_t>> page_slots_;
+  std::vector<CacheSlot> slots_;
+  // Slots that may be replaced, least recently used first. The slot holding
+  // the coarsest level is never replaced.
+  std::list<uint32_t> lru_;
+  uint32_t resident_page_count_ = 0u;
+  uint32_t missing_page_count_ = 0u;
+  size_t uploaded_page_count_ = 0u;
+  // Reused across frames.
+  std::vector<uint32_t> requests_;
+  std::vector<vk::BufferImageCopy> page_copies_;
+  std::vector<vk::BufferCopy> table_copies_;
+  bool is_valid_ = false;
+
+  VirtualTexture(const std::shared_ptr<Context>& context,
+                 std::shared_ptr<VirtualTextureFile> file,
+                 size_t frame_count,
+                 uint32_t cache_pages,
+                 uint32_t max_uploads_per_frame);
+
+  bool Initialize(Context& context);
+
+  void TouchSlot(uint32_t slot);
+
+  std::optional<uint32_t> AcquireSlot();
+
+  void StagePage(uint32_t page, uint32_t slot);
+
+  void StageTableEntry(uint32_t page, uint32_t entry);
+
+  void RecordUploads(const vk::CommandBuffer& command_buffer) const;
+
+  void BindDescriptorSets(const vk::CommandBuffer& command_buffer,
+                          bool bind_target) const;
+
+  void PushConstants(const vk::CommandBuffer& command_buffer) const;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(VirtualTexture);
+};
+
+}  // namespace one
@@ -0,0 +1,238 @@
+#include "virtual_texture_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "fml/logging.h"
+
+namespace one {
+
+static constexpr char kMagic[4] = {'J', 'O', 'V', 'T'};
+static constexpr uint32_t kVersion = 1u;
+// Pages start on a boundary of the OS page size.
+static constexpr size_t kPagesOffset = 4096u;
+
+struct FileHeader {
+  char magic[4] = {};
+  uint32_t version = 0u;
+  uint32_t width = 0u;
+  uint32_t height = 0u;
+  uint32_t mip_count = 0u;
+  uint32_t page_size = 0u;
+  uint32_t page_border = 0u;
+};
+
+static_assert(sizeof(FileHeader) <= kPagesOffset);
+
+static glm::uvec2 MipSize(glm::ivec2 size, uint32_t mip) {
+  return {std::max(static_cast<uint32_t>(size.x) >> mip, 1u),
+          std::max(static_cast<uint32_t>(size.y) >> mip, 1u)};
+}
+
+static glm::uvec2 PageGrid(glm::ivec2 size, uint32_t mip) {
+  const auto mip_size = MipSize(size, mip);
+  return (mip_size + VirtualTextureFile::kPageContentSize - 1u) /
+         VirtualTextureFile::kPageContentSize;
+}
+
+static uint32_t CountMips(glm::ivec2 size) {
+  uint32_t mip = 0u;
+  while (PageGrid(size, mip) != glm::uvec2{1u, 1u}) {
+    mip++;
+  }
+  return mip + 1u;
+}
+
+// Halves the level with a box filter. Odd sizes round down, so the last row
+// and column of odd sized levels are averaged into the texels next to them.
+static std::vector<uint8_t> Downsample(const uint8_t* pixels,
+                                       glm::uvec2 size,
+                                       glm::uvec2 half_size) {
+  std::vector<uint8_t> result(static_cast<size_t>(half_size.x) *
+                              half_size.y * 4u);
+  for (uint32_t y = 0; y < half_size.y; y++) {
+    const uint32_t y_end = y + 1u == half_size.y ? size.y : y * 2u + 2u;
+    for (uint32_t x = 0; x < half_size.x; x++) {
+      const uint32_t x_end = x + 1u == half_size.x ? size.x : x * 2u + 2u;
+      const uint32_t count = (y_end - y * 2u) * (x_end - x * 2u);
+      for (uint32_t c = 0; c < 4u; c++) {
+        uint32_t sum = 0u;
+        for (uint32_t ty = y * 2u; ty < y_end; ty++) {
+          for (uint32_t tx = x * 2u; tx < x_end; tx++) {
+            sum += pixels[(static_cast<size_t>(ty) * size.x + tx) * 4u + c];
+          }
+        }
+        result[(static_cast<size_t>(y) * half_size.x + x) * 4u + c] =
+            static_cast<uint8_t>((sum + count / 2u) / count);
+      }
+    }
+  }
+  return result;
+}
+
+// Copies the page and its border out of the level, clamping to the edges.
+static void ExtractPage(const uint8_t* pixels,
+                        glm::uvec2 size,
+                        uint32_t page_x,
+                        uint32_t page_y,
+                        uint8_t* page) {
+  static constexpr auto kPageSize = VirtualTextureFile::kPageSize;
+  static constexpr auto kContentSize = VirtualTextureFile::kPageContentSize;
+  static constexpr auto kBorder = VirtualTextureFile::kPageBorder;
+  for (uint32_t y = 0; y < kPageSize; y++) {
+    const auto source_y = static_cast<uint32_t>(
+        std::clamp<int64_t>(static_cast<int64_t>(page_y) * kContentSize + y -
+                                kBorder,
+                            0, size.y - 1u));
+    for (uint32_t x = 0; x < kPageSize; x++) {
+      const auto source_x = static_cast<uint32_t>(
+          std::clamp<int64_t>(static_cast<int64_t>(page_x) * kContentSize + x -
+                                  kBorder,
+                              0, size.x - 1u));
+      std::memcpy(
+          page + (y * kPageSize + x) * 4u,
+          pixels + (static_cast<size_t>(source_y) * size.x + source_x) * 4u,
+          4u);
+    }
+  }
+}
+
+bool VirtualTextureFile::Write(const std::string& path,
+                               const fml::Mapping& pixels,
+                               glm::ivec2 size) {
+  if (size.x <= 0 || size.y <= 0 ||
+      pixels.GetSize() != static_cast<size_t>(size.x) * size.y * 4u) {
+    FML_LOG(ERROR) << "Invalid virtual texture pixels.";
+    return false;
+  }
+
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    FML_LOG(ERROR) << "Could not open " << path;
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.width = static_cast<uint32_t>(size.x);
+  header.height = static_cast<uint32_t>(size.y);
+  header.mip_count = CountMips(size);
+  header.page_size = kPageSize;
+  header.page_border = kPageBorder;
+  std::vector<uint8_t> header_bytes(kPagesOffset, 0u);
+  std::memcpy(header_bytes.data(), &header, sizeof(header));
+  stream.write(reinterpret_cast<const char*>(header_bytes.data()),
+               header_bytes.size());
+
+  // Only the current level and the one derived from it are held in memory.
+  std::vector<uint8_t> level;
+  const uint8_t* level_pixels = pixels.GetMapping();
+  std::vector<uint8_t> page(kPageBytes);
+  for (uint32_t mip = 0; mip < header.mip_count; mip++) {
+    const auto mip_size = MipSize(size, mip);
+    if (mip > 0u) {
+      level = Downsample(level_pixels, MipSize(size, mip - 1u), mip_size);
+      level_pixels = level.data();
+    }
+    const auto grid = PageGrid(size, mip);
+    for (uint32_t y = 0; y < grid.y; y++) {
+      for (uint32_t x = 0; x < grid.x; x++) {
+        ExtractPage(level_pixels, mip_size, x, y, page.data());
+        stream.write(reinterpret_cast<const char*>(page.data()), page.size());
+      }
+    }
+  }
+
+  if (!stream) {
+    FML_LOG(ERROR) << "Could not write " << path;
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<VirtualTextureFile> VirtualTextureFile::Make(
+    const std::string& path) {
+  auto mapping = fml::FileMapping::CreateReadOnly(path);
+  if (!mapping || !mapping->IsValid() ||
+      mapping->GetSize() < sizeof(FileHeader)) {
+    FML_LOG(ERROR) << "Could not map virtual texture " << path;
+    return nullptr;
+  }
+
+  FileHeader header;
+  std::memcpy(&header, mapping->GetMapping(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.page_size != kPageSize ||
+      header.page_border != kPageBorder || header.width == 0u ||
+      header.height == 0u) {
+    FML_LOG(ERROR) << "Not a virtual texture: " << path;
+    return nullptr;
+  }
+
+  const glm::ivec2 size = {static_cast<int>(header.width),
+                           static_cast<int>(header.height)};
+  if (header.mip_count != CountMips(size)) {
+    FML_LOG(ERROR) << "Unexpected virtual texture mip count.";
+    return nullptr;
+  }
+  auto file = std::unique_ptr<VirtualTextureFile>(
+      new VirtualTextureFile(std::move(mapping), size, header.mip_count));
+  if (file->mapping_->GetSize() <
+      kPagesOffset + static_cast<size_t>(file->GetPageCount()) * kPageBytes) {
+    FML_LOG(ERROR) << "Truncated virtual texture: " << path;
+    return nullptr;
+  }
+  return file;
+}
+
+VirtualTextureFile::VirtualTextureFile(std::unique_ptr<fml::Mapping> mapping,
+                                       glm::ivec2 size,
+                                       uint32_t mip_count)
+    : mapping_(std::move(mapping)), size_(size) {
+  uint32_t page_count = 0u;
+  for (uint32_t mip = 0; mip < mip_count; mip++) {
+    first_pages_.push_back(page_count);
+    const auto grid = PageGrid(size_, mip);
+    page_count += grid.x * grid.y;
+  }
+  first_pages_.push_back(page_count);
+}
+
+VirtualTextureFile::~VirtualTextureFile() = default;
+
+glm::ivec2 VirtualTextureFile::GetSize() const {
+  return size_;
+}
+
+uint32_t VirtualTextureFile::GetMipCount() const {
+  return static_cast<uint32_t>(first_pages_.size() - 1u);
+}
+
+glm::uvec2 VirtualTextureFile::GetMipSize(uint32_t mip) const {
+  return MipSize(size_, mip);
+}
+
+glm::uvec2 VirtualTextureFile::GetPageGrid(uint32_t mip) const {
+  return PageGrid(size_, mip);
+}
+
+uint32_t VirtualTextureFile::GetPageCount() const {
+  return first_pages_.back();
+}
+
+uint32_t VirtualTextureFile::GetPageIndex(const VirtualPage& page) const {
+  return first_pages_[page.mip] + page.y * GetPageGrid(page.mip).x + page.x;
+}
+
+uint32_t VirtualTextureFile::GetFirstPageIndex(uint32_t mip) const {
+  return first_pages_[mip];
+}
+
+const uint8_t* VirtualTextureFile::GetPageData(uint32_t index) const {
+  return mapping_->GetMapping() + kPagesOffset +
+         static_cast<size_t>(index) * kPageBytes;
+}
+
+}  // namespace one
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fml/macros.h"
+#include "fml/mapping.h"
+#include "glm/glm/ext/vector_int2.hpp"
+#include "glm/glm/ext/vector_uint2.hpp"
+
+namespace one {
+
+// A tile of one level of a virtual texture's mip pyramid.
+struct VirtualPage {
+  uint32_t mip = 0u;
+  uint32_t x = 0u;
+  uint32_t y = 0u;
+};
+
+// An image split into a mip pyramid of fixed size RGBA8 pages. The file is
+// memory mapped so pages are only read from disk once they are streamed in.
+//
+// Each page covers kPageContentSize texels of its level in each direction and
+// repeats kPageBorder texels of its neighbors on every side, so a page can be
+// filtered bilinearly without sampling the pages next to it. The pyramid
+// stops at the first level that fits in a single page.
+class VirtualTextureFile {
+ public:
+  static constexpr uint32_t kPageSize = 128u;
+  static constexpr uint32_t kPageBorder = 4u;
+  static constexpr uint32_t kPageContentSize = kPageSize - 2u * kPageBorder;
+  static constexpr size_t kPageBytes = kPageSize * kPageSize * 4u;
+
+  // Tiles tightly packed RGBA8 pixels and writes them to the path. The whole
+  // of level zero must be in memory, along with up to a quarter of its size
+  // for the level being derived from it, so images larger than memory have to
+  // be tiled by other means.
+  static bool Write(const std::string& path,
+                    const fml::Mapping& pixels,
+                    glm::ivec2 size);
+
+  static std::unique_ptr<VirtualTextureFile> Make(const std::string& path);
+
+  ~VirtualTextureFile();
+
+  glm::ivec2 GetSize() const;
+
+  uint32_t GetMipCount() const;
+
+  // The size of the level in texels.
+  glm::uvec2 GetMipSize(uint32_t mip) const;
+
+  // The number of pages of the level in each direction.
+  glm::uvec2 GetPageGrid(uint32_t mip) const;
+
+  // The number of pages in all levels.
+  uint32_t GetPageCount() const;
+
+  // Pages are numbered level by level starting at level zero and row major
+  // within each level.
+  uint32_t GetPageIndex(const VirtualPage& page) const;
+
+  uint32_t GetFirstPageIndex(uint32_t mip) const;
+
+  // The kPageBytes of the page's texels.
+  const uint8_t* GetPageData(uint32_t index) const;
+
+ private:
+  std::unique_ptr<fml::Mapping> mapping_;
+  glm::ivec2 size_ = {};
+  // The index of the first page of each level followed by the page count.
+  std::vector<uint32_t> first_pages_;
+
+  VirtualTextureFile(std::unique_ptr<fml::Mapping> mapping,
+                     glm::ivec2 size,
+                     uint32_t mip_count);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(VirtualTextureFile);
+};
+
+}  // namespace one
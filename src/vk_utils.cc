@@ -0,0 +1,178 @@
+#include "vk_utils.h"
+
+#include <optional>
+#include <string>
+
+#include "context.h"
+#include "fml/mapping.h"
+#include "fml/logging.h"
+#include "shaders_location.h"
+
+namespace one {
+
+bool CreateBuffer(const Context& context,
+                  BufferVK& buffer,
+                  vk::DeviceSize size,
+                  vk::BufferUsageFlags usage,
+                  bool host_visible) {
+  const auto& device = context.GetDevice();
+
+  vk::BufferCreateInfo buffer_info;
+  buffer_info.size = size;
+  buffer_info.usage = usage;
+  buffer_info.sharingMode = vk::SharingMode::eExclusive;
+  auto [buffer_result, new_buffer] = device.createBufferUnique(buffer_info);
+  if (buffer_result != vk::Result::eSuccess) {
+    return false;
+  }
+
+  const auto requirements = device.getBufferMemoryRequirements(*new_buffer);
+  std::optional<uint32_t> memory_type;
+  if (host_visible) {
+    memory_type = context.FindMemoryTypeIndex(
+        requirements.memoryTypeBits,
+        vk::MemoryPropertyFlagBits::eDeviceLocal |
+            vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+    if (!memory_type.has_value()) {
+      memory_type = context.FindMemoryTypeIndex(
+          requirements.memoryTypeBits,
+          vk::MemoryPropertyFlagBits::eHostVisible |
+              vk::MemoryPropertyFlagBits::eHostCoherent);
+    }
+  } else {
+    memory_type = context.FindMemoryTypeIndex(
+        requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  }
+  if (!memory_type.has_value()) {
+    return false;
+  }
+
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info.allocationSize = requirements.size;
+  allocate_info.memoryTypeIndex = memory_type.value();
+  auto [memory_result, memory] = device.allocateMemoryUnique(allocate_info);
+  if (memory_result != vk::Result::eSuccess) {
+    return false;
+  }
+  if (device.bindBufferMemory(*new_buffer, *memory, 0u) !=
+      vk::Result::eSuccess) {
+    return false;
+  }
+  if (host_visible) {
+    auto [map_result, mapping] =
+        device.mapMemory(*memory, 0u, VK_WHOLE_SIZE);
+    if (map_result != vk::Result::eSuccess) {
+      return false;
+    }
+    buffer.mapping = mapping;
+  }
+
+  buffer.buffer = std::move(new_buffer);
+  buffer.memory = std::move(memory);
+  return true;
+}
+
+bool CreateImage(const Context& context,
+                 ImageVK& image,
+                 vk::Format format,
+                 vk::Extent2D extent,
+                 vk::ImageUsageFlags usage) {
+  const auto& device = context.GetDevice();
+
+  vk::ImageCreateInfo image_info;
+  image_info.imageType = vk::ImageType::e2D;
+  image_info.format = format;
+  image_info.extent = vk::Extent3D{extent.width, extent.height, 1u};
+  image_info.mipLevels = 1u;
+  image_info.arrayLayers = 1u;
+  image_info.samples = vk::SampleCountFlagBits::e1;
+  image_info.tiling = vk::ImageTiling::eOptimal;
+  image_info.usage = usage;
+  image_info.sharingMode = vk::SharingMode::eExclusive;
+  image_info.initialLayout = vk::ImageLayout::eUndefined;
+  auto [image_result, new_image] = device.createImageUnique(image_info);
+  if (image_result != vk::Result::eSuccess) {
+    return false;
+  }
+
+  const auto requirements = device.getImageMemoryRequirements(*new_image);
+  const auto memory_type = context.FindMemoryTypeIndex(
+      requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  if (!memory_type.has_value()) {
+    return false;
+  }
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info.allocationSize = requirements.size;
+  allocate_info.memoryTypeIndex = memory_type.value();
+  auto [memory_result, memory] = device.allocateMemoryUnique(allocate_info);
+  if (memory_result != vk::Result::eSuccess) {
+    return false;
+  }
+  if (device.bindImageMemory(*new_image, *memory, 0u) !=
+      vk::Result::eSuccess) {
+    return false;
+  }
+
+  if (usage & (vk::ImageUsageFlagBits::eSampled |
+               vk::ImageUsageFlagBits::eStorage |
+               vk::ImageUsageFlagBits::eColorAttachment)) {
+    vk::ImageViewCreateInfo view_info;
+    view_info.image = *new_image;
+    view_info.viewType = vk::ImageViewType::e2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    view_info.subresourceRange.levelCount = 1u;
+    view_info.subresourceRange.layerCount = 1u;
+    auto [view_result, view] = device.createImageViewUnique(view_info);
+    if (view_result != vk::Result::eSuccess) {
+      return false;
+    }
+    image.view = std::move(view);
+  }
+
+  image.image = std::move(new_image);
+  image.memory = std::move(memory);
+  return true;
+}
+
+vk::UniqueShaderModule LoadShaderModule(const vk::Device& device,
+                                        const char* shader_name) {
+  auto spirv = fml::FileMapping::CreateReadOnly(
+      std::string{JUSTONE_SHADERS_LOCATION} + shader_name);
+  if (!spirv || !spirv->IsValid()) {
+    FML_LOG(ERROR) << "Could not load shader " << shader_name;
+    return {};
+  }
+  vk::ShaderModuleCreateInfo module_info;
+  module_info.codeSize = spirv->GetSize();
+  module_info.pCode = reinterpret_cast<const uint32_t*>(spirv->GetMapping());
+  auto [result, module] = device.createShaderModuleUnique(module_info);
+  if (result != vk::Result::eSuccess) {
+    return {};
+  }
+  return std::move(module);
+}
+
+vk::UniquePipeline CreateComputePipeline(const vk::Device& device,
+                                         const vk::PipelineLayout& layout,
+                                         const char* shader_name) {
+  auto module = LoadShaderModule(device, shader_name);
+  if (!module) {
+    return {};
+  }
+
+  vk::ComputePipelineCreateInfo pipeline_info;
+  pipeline_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+  pipeline_info.stage.module = *module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = layout;
+  auto [pipeline_result, pipeline] =
+      device.createComputePipelineUnique({}, pipeline_info);
+  if (pipeline_result != vk::Result::eSuccess) {
+    return {};
+  }
+  return std::move(pipeline);
+}
+
+}  // namespace one
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vk.h"
+
+namespace one {
+
+class Context;
+
+struct BufferVK {
+  vk::UniqueBuffer buffer;
+  vk::UniqueDeviceMemory memory;
+  // Set for host visible buffers, which stay mapped.
+  void* mapping = nullptr;
+};
+
+// Host visible buffers are coherent and prefer device local memory. Others
+// are device local.
+bool CreateBuffer(const Context& context,
+                  BufferVK& buffer,
+                  vk::DeviceSize size,
+                  vk::BufferUsageFlags usage,
+                  bool host_visible);
+
+// A 2D image with a single level and layer in its own device local memory.
+struct ImageVK {
+  vk::UniqueImage image;
+  vk::UniqueDeviceMemory memory;
+  // Set if the usage allows one.
+  vk::UniqueImageView view;
+};
+
+// The image starts out in the undefined layout. It gets a color view if it is
+// sampled, used for storage or rendered to.
+bool CreateImage(const Context& context,
+                 ImageVK& image,
+                 vk::Format format,
+                 vk::Extent2D extent,
+                 vk::ImageUsageFlags usage);
+
+// Loads SPIR-V compiled into the shaders location, e.g. "foo.comp.spv".
+vk::UniqueShaderModule LoadShaderModule(const vk::Device& device,
+                                        const char* shader_name);
+
+vk::UniquePipeline CreateComputePipeline(const vk::Device& device,
+                                         const vk::PipelineLayout& layout,
+                                         const char* shader_name);
+
+}  // namespace one
@@ -5,11 +5,15 @@
 #include "fml/concurrent_message_loop.h"
 
 #include <algorithm>
+#include <utility>
 
 #include "fml/thread.h"
 
 namespace fml {
 
+// The number of recent tasks of each priority wait times are tracked for.
+static constexpr size_t kMaxWaitTimeSamples = 1024;
+
 ConcurrentMessageLoop::ConcurrentMessageLoop(size_t worker_count)
     : worker_count_(std::max<size_t>(worker_count, 1ul)) {
   for (size_t i = 0; i < worker_count_; ++i) {
@@ -41,9 +45,12 @@ std::shared_ptr<ConcurrentTaskRunner> ConcurrentMessageLoop::GetTaskRunner() {
   return std::make_shared<ConcurrentTaskRunner>(weak_from_this());
 }
 
-void ConcurrentMessageLoop::PostTask(const fml::closure& task) {
+ConcurrentTaskId ConcurrentMessageLoop::PostTask(
+    const fml::closure& task,
+    ConcurrentTaskPriority priority,
+    std::optional<fml::TimePoint> deadline) {
   if (!task) {
-    return;
+    return 0;
   }
 
   std::unique_lock lock(tasks_mutex_);
@@ -55,10 +62,15 @@ void ConcurrentMessageLoop::PostTask(const fml::closure& task) {
            "loop. The task will be executed on the callers thread.";
     lock.unlock();
     ExecuteTask(task);
-    return;
+    return 0;
   }
 
-  tasks_.push(task);
+  const auto task_id = ++last_task_id_;
+  const auto key =
+      TaskKey{deadline.value_or(fml::TimePoint::Max()), task_id};
+  tasks_[static_cast<size_t>(priority)].emplace(
+      key, PendingTask{.task = task, .post_time = fml::TimePoint::Now()});
+  task_keys_.emplace(task_id, std::make_pair(priority, key));
 
   // Unlock the mutex before notifying the condition variable because that mutex
   // has to be acquired on the other thread anyway. Waiting in this scope till
@@ -66,25 +78,65 @@ void ConcurrentMessageLoop::PostTask(const fml::closure& task) {
   lock.unlock();
 
   tasks_condition_.notify_one();
+
+  return task_id;
+}
+
+bool ConcurrentMessageLoop::CancelTask(ConcurrentTaskId task_id) {
+  std::scoped_lock lock(tasks_mutex_);
+  auto found = task_keys_.find(task_id);
+  if (found == task_keys_.end()) {
+    return false;
+  }
+  const auto& [priority, key] = found->second;
+  tasks_[static_cast<size_t>(priority)].erase(key);
+  task_keys_.erase(found);
+  return true;
+}
+
+bool ConcurrentMessageLoop::HasTasksLocked() const {
+  return std::any_of(tasks_.begin(), tasks_.end(),
+                     [](const auto& queue) { return !queue.empty(); });
+}
+
+fml::closure ConcurrentMessageLoop::TakeNextTaskLocked() {
+  for (size_t priority = 0; priority < tasks_.size(); ++priority) {
+    auto& queue = tasks_[priority];
+    if (queue.empty()) {
+      continue;
+    }
+    auto next = queue.begin();
+    const auto task_id = next->first.second;
+    auto task = std::move(next->second.task);
+
+    auto& wait_times = wait_times_[priority];
+    const auto wait_time = fml::TimePoint::Now() - next->second.post_time;
+    if (wait_times.samples.size() < kMaxWaitTimeSamples) {
+      wait_times.samples.push_back(wait_time);
+    } else {
+      wait_times.samples[wait_times.next_sample] = wait_time;
+    }
+    wait_times.next_sample = (wait_times.next_sample + 1) % kMaxWaitTimeSamples;
+
+    queue.erase(next);
+    task_keys_.erase(task_id);
+    return task;
+  }
+  return nullptr;
 }
 
 void ConcurrentMessageLoop::WorkerMain() {
   while (true) {
     std::unique_lock lock(tasks_mutex_);
     tasks_condition_.wait(lock, [&]() {
-      return !tasks_.empty() || shutdown_ || HasThreadTasksLocked();
+      return HasTasksLocked() || shutdown_ || HasThreadTasksLocked();
     });
 
     // Shutdown cannot be read with the task mutex unlocked.
     bool shutdown_now = shutdown_;
-    fml::closure task;
+    fml::closure task = TakeNextTaskLocked();
     std::vector<fml::closure> thread_tasks;
 
-    if (!tasks_.empty()) {
-      task = tasks_.front();
-      tasks_.pop();
-    }
-
     if (HasThreadTasksLocked()) {
       thread_tasks = GetThreadTasksLocked();
       FML_DCHECK(!HasThreadTasksLocked());
@@ -132,6 +184,31 @@ void ConcurrentMessageLoop::PostTaskToAllWorkers(const fml::closure& task) {
   tasks_condition_.notify_all();
 }
 
+ConcurrentMessageLoop::WaitTimeStats ConcurrentMessageLoop::GetWaitTimeStats(
+    ConcurrentTaskPriority priority) const {
+  std::vector<fml::TimeDelta> samples;
+  {
+    std::scoped_lock lock(tasks_mutex_);
+    samples = wait_times_[static_cast<size_t>(priority)].samples;
+  }
+  WaitTimeStats stats;
+  stats.sample_count = samples.size();
+  if (samples.empty()) {
+    return stats;
+  }
+  const auto percentile = [&samples](size_t percent) {
+    const auto index =
+        std::min(samples.size() - 1, samples.size() * percent / 100);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+  };
+  stats.p50 = percentile(50);
+  stats.p90 = percentile(90);
+  stats.p99 = percentile(99);
+  stats.max = *std::max_element(samples.begin(), samples.end());
+  return stats;
+}
+
 bool ConcurrentMessageLoop::HasThreadTasksLocked() const {
   return thread_tasks_.count(std::this_thread::get_id()) > 0;
 }
@@ -152,19 +229,40 @@ ConcurrentTaskRunner::ConcurrentTaskRunner(
 ConcurrentTaskRunner::~ConcurrentTaskRunner() = default;
 
 void ConcurrentTaskRunner::PostTask(const fml::closure& task) {
+  PostTask(task, ConcurrentTaskPriority::kNormal);
+}
+
+ConcurrentTaskId ConcurrentTaskRunner::PostTask(
+    const fml::closure& task,
+    ConcurrentTaskPriority priority,
+    std::optional<fml::TimePoint> deadline) {
   if (!task) {
-    return;
+    return 0;
   }
 
   if (auto loop = weak_loop_.lock()) {
-    loop->PostTask(task);
-    return;
+    return loop->PostTask(task, priority, deadline);
   }
 
   FML_DLOG(WARNING)
       << "Tried to post to a concurrent message loop that has already died. "
          "Executing the task on the callers thread.";
   task();
+  return 0;
+}
+
+bool ConcurrentTaskRunner::CancelTask(ConcurrentTaskId task_id) {
+  if (auto loop = weak_loop_.lock()) {
+    return loop->CancelTask(task_id);
+  }
+  return false;
+}
+
+size_t ConcurrentTaskRunner::GetWorkerCount() const {
+  if (auto loop = weak_loop_.lock()) {
+    return loop->GetWorkerCount();
+  }
+  return 0;
 }
 
 bool ConcurrentMessageLoop::RunsTasksOnCurrentThread() {
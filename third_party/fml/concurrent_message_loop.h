@@ -5,19 +5,30 @@
 #ifndef FLUTTER_FML_CONCURRENT_MESSAGE_LOOP_H_
 #define FLUTTER_FML_CONCURRENT_MESSAGE_LOOP_H_
 
+#include <array>
 #include <condition_variable>
 #include <map>
-#include <queue>
+#include <mutex>
+#include <optional>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "fml/closure.h"
+#include "fml/concurrent_task_priority.h"
 #include "fml/macros.h"
 #include "fml/task_runner.h"
+#include "fml/time/time_delta.h"
+#include "fml/time/time_point.h"
 
 namespace fml {
 
 class ConcurrentTaskRunner;
 
+/// Identifies a task posted to a `ConcurrentMessageLoop` so that it may be
+/// cancelled while it is still queued. Zero is never a valid identifier.
+using ConcurrentTaskId = uint64_t;
+
 class ConcurrentMessageLoop
     : public std::enable_shared_from_this<ConcurrentMessageLoop> {
  public:
@@ -36,6 +47,18 @@ class ConcurrentMessageLoop
 
   bool RunsTasksOnCurrentThread();
 
+  /// How long tasks of a given priority waited in the queue before a worker
+  /// picked them up. Computed over the most recent tasks.
+  struct WaitTimeStats {
+    size_t sample_count = 0;
+    fml::TimeDelta p50;
+    fml::TimeDelta p90;
+    fml::TimeDelta p99;
+    fml::TimeDelta max;
+  };
+
+  WaitTimeStats GetWaitTimeStats(ConcurrentTaskPriority priority) const;
+
  protected:
   explicit ConcurrentMessageLoop(size_t worker_count);
   virtual void ExecuteTask(const fml::closure& task);
@@ -43,18 +66,46 @@ class ConcurrentMessageLoop
  private:
   friend ConcurrentTaskRunner;
 
+  struct PendingTask {
+    fml::closure task;
+    fml::TimePoint post_time;
+  };
+
+  // Within a priority, tasks are ordered by deadline and then by the order in
+  // which they were posted. Tasks without a deadline go last.
+  using TaskKey = std::pair<fml::TimePoint, ConcurrentTaskId>;
+  using TaskQueue = std::map<TaskKey, PendingTask>;
+
+  struct WaitTimeSamples {
+    std::vector<fml::TimeDelta> samples;
+    size_t next_sample = 0;
+  };
+
   size_t worker_count_ = 0;
   std::vector<std::thread> workers_;
-  std::mutex tasks_mutex_;
+  mutable std::mutex tasks_mutex_;
   std::condition_variable tasks_condition_;
-  std::queue<fml::closure> tasks_;
+  std::array<TaskQueue, kConcurrentTaskPriorityCount> tasks_;
+  std::unordered_map<ConcurrentTaskId,
+                     std::pair<ConcurrentTaskPriority, TaskKey>>
+      task_keys_;
+  ConcurrentTaskId last_task_id_ = 0;
+  std::array<WaitTimeSamples, kConcurrentTaskPriorityCount> wait_times_;
   std::vector<std::thread::id> worker_thread_ids_;
   std::map<std::thread::id, std::vector<fml::closure>> thread_tasks_;
   bool shutdown_ = false;
 
   void WorkerMain();
 
-  void PostTask(const fml::closure& task);
+  ConcurrentTaskId PostTask(const fml::closure& task,
+                            ConcurrentTaskPriority priority,
+                            std::optional<fml::TimePoint> deadline);
+
+  bool CancelTask(ConcurrentTaskId task_id);
+
+  bool HasTasksLocked() const;
+
+  fml::closure TakeNextTaskLocked();
 
   bool HasThreadTasksLocked() const;
 
@@ -69,8 +120,27 @@ class ConcurrentTaskRunner : public BasicTaskRunner {
 
   virtual ~ConcurrentTaskRunner();
 
+  /// Posts a task with `ConcurrentTaskPriority::kNormal` and no deadline.
   void PostTask(const fml::closure& task) override;
 
+  /// Posts a task that is run before all queued tasks of a lower priority and
+  /// before tasks of the same priority with a later (or no) deadline. The
+  /// deadline is only used for ordering, the task is run even if it is missed.
+  ///
+  /// Returns zero if the task was run on the callers thread because the loop
+  /// has already been terminated.
+  ConcurrentTaskId PostTask(
+      const fml::closure& task,
+      ConcurrentTaskPriority priority,
+      std::optional<fml::TimePoint> deadline = std::nullopt);
+
+  /// Removes a task that has not yet been picked up by a worker. Returns false
+  /// if the task is already running, has run, or was cancelled before.
+  bool CancelTask(ConcurrentTaskId task_id);
+
+  /// The number of workers of the loop, or zero once it has been destroyed.
+  size_t GetWorkerCount() const;
+
  private:
   friend ConcurrentMessageLoop;
 
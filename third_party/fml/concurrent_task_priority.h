@@ -0,0 +1,33 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_FML_CONCURRENT_TASK_PRIORITY_H_
+#define FLUTTER_FML_CONCURRENT_TASK_PRIORITY_H_
+
+#include <cstddef>
+
+namespace fml {
+
+/**
+ * Categories of work dispatched to a `ConcurrentMessageLoop`. Like
+ * `TaskSourceGrade` for `MessageLoopTaskQueues`, specifying the priority
+ * indicates the task's importance to the loop. Workers always pick up a task of
+ * the highest priority available.
+ */
+enum class ConcurrentTaskPriority : size_t {
+  /// This `ConcurrentTaskPriority` indicates that the frame currently being
+  /// produced is waiting on the task.
+  kFrameCritical,
+  /// The absence of a specialized `ConcurrentTaskPriority`.
+  kNormal,
+  /// This `ConcurrentTaskPriority` indicates that the results of the task may
+  /// never be needed. For example, speculatively prefetching resources.
+  kSpeculative,
+};
+
+static constexpr size_t kConcurrentTaskPriorityCount = 3u;
+
+}  // namespace fml
+
+#endif  // FLUTTER_FML_CONCURRENT_TASK_PRIORITY_H_
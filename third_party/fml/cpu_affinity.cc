@@ -13,11 +13,17 @@
 #include "fml/platform/android/cpu_affinity.h"
 #endif  // FML_OS_ANDROID
 
+#ifdef FML_OS_WIN
+#include "fml/platform/win/cpu_affinity_win.h"
+#endif  // FML_OS_WIN
+
 namespace fml {
 
 std::optional<size_t> EfficiencyCoreCount() {
 #ifdef FML_OS_ANDROID
   return AndroidEfficiencyCoreCount();
+#elif defined(FML_OS_WIN)
+  return WinEfficiencyCoreCount();
 #else
   return std::nullopt;
 #endif
@@ -26,6 +32,8 @@ std::optional<size_t> EfficiencyCoreCount() {
 bool RequestAffinity(CpuAffinity affinity) {
 #ifdef FML_OS_ANDROID
   return AndroidRequestAffinity(affinity);
+#elif defined(FML_OS_WIN)
+  return WinRequestAffinity(affinity);
 #else
   return true;
 #endif
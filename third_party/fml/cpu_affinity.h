@@ -31,15 +31,16 @@ enum class CpuAffinity {
 /// @brief Request count of efficiency cores.
 ///
 ///        Efficiency cores are defined as those with the lowest reported
-///        cpu_max_freq. If the CPU speed could not be determined, or if all
-///        cores have the same reported speed then this returns std::nullopt.
-///        That is, the result will never be 0.
+///        cpu_max_freq, or the lowest efficiency class on Windows. If the CPU
+///        speed could not be determined, or if all cores have the same
+///        reported speed then this returns std::nullopt. That is, the result
+///        will never be 0.
 std::optional<size_t> EfficiencyCoreCount();
 
 /// @brief Request the given affinity for the current thread.
 ///
 ///        Returns true if successfull, or if it was a no-op. This function is
-///        only supported on Android devices.
+///        only supported on Android and Windows devices.
 ///
 ///        Affinity requests are based on documented CPU speed. This speed data
 ///        is parsed from cpuinfo_max_freq files, see also:
@@ -191,6 +191,63 @@ TEST(MessageLoop, CanCreateAndShutdownConcurrentMessageLoopsOverAndOver) {
   }
 }
 
+TEST(MessageLoop, ConcurrentMessageLoopRunsHigherPriorityTasksFirst) {
+  auto loop = fml::ConcurrentMessageLoop::Create(1u);
+  auto task_runner = loop->GetTaskRunner();
+
+  // Keep the only worker busy till all tasks are queued.
+  fml::AutoResetWaitableEvent started;
+  fml::AutoResetWaitableEvent release;
+  task_runner->PostTask([&]() {
+    started.Signal();
+    release.Wait();
+  });
+  started.Wait();
+
+  std::vector<int> order;
+  fml::CountDownLatch latch(4u);
+  auto record = [&](int value) {
+    return [&, value]() {
+      order.push_back(value);
+      latch.CountDown();
+    };
+  };
+  const auto now = fml::TimePoint::Now();
+  task_runner->PostTask(record(5), fml::ConcurrentTaskPriority::kSpeculative);
+  const auto cancelled = task_runner->PostTask(
+      record(6), fml::ConcurrentTaskPriority::kSpeculative);
+  task_runner->PostTask(record(3), fml::ConcurrentTaskPriority::kNormal);
+  task_runner->PostTask(record(2), fml::ConcurrentTaskPriority::kFrameCritical);
+  task_runner->PostTask(record(1), fml::ConcurrentTaskPriority::kFrameCritical,
+                        now + fml::TimeDelta::FromMilliseconds(16));
+  ASSERT_TRUE(task_runner->CancelTask(cancelled));
+  ASSERT_FALSE(task_runner->CancelTask(cancelled));
+
+  release.Signal();
+  latch.Wait();
+  ASSERT_EQ(order, (std::vector<int>{1, 2, 3, 5}));
+}
+
+TEST(MessageLoop, ConcurrentMessageLoopReportsWaitTimes) {
+  auto loop = fml::ConcurrentMessageLoop::Create(1u);
+  auto task_runner = loop->GetTaskRunner();
+  fml::CountDownLatch latch(10u);
+  for (size_t i = 0; i < 10u; ++i) {
+    task_runner->PostTask([&]() { latch.CountDown(); },
+                          fml::ConcurrentTaskPriority::kFrameCritical);
+  }
+  latch.Wait();
+  const auto stats =
+      loop->GetWaitTimeStats(fml::ConcurrentTaskPriority::kFrameCritical);
+  ASSERT_EQ(stats.sample_count, 10u);
+  ASSERT_LE(stats.p50, stats.p90);
+  ASSERT_LE(stats.p90, stats.p99);
+  ASSERT_LE(stats.p99, stats.max);
+  ASSERT_EQ(
+      loop->GetWaitTimeStats(fml::ConcurrentTaskPriority::kNormal).sample_count,
+      0u);
+}
+
 TEST(MessageLoop, CanCreateConcurrentMessageLoop) {
   auto loop = fml::ConcurrentMessageLoop::Create();
   auto task_runner = loop->GetTaskRunner();
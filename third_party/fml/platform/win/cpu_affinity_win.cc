@@ -0,0 +1,118 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "fml/platform/win/cpu_affinity_win.h"
+
+#include <windows.h>
+
+#include <mutex>
+#include <vector>
+
+#include "fml/logging.h"
+
+namespace fml {
+
+// Logical processors are identified by their group and their bit in the group
+// mask. The index given to the CPU speed tracker is group * kProcessorsPerGroup
+// + bit.
+static constexpr size_t kProcessorsPerGroup = sizeof(KAFFINITY) * 8;
+
+static std::once_flag gCPUTrackerFlag;
+static CPUSpeedTracker* gCPUTracker;
+
+// Windows doesn't report CPU frequencies but does report an efficiency class
+// for each core on hybrid CPUs. Cores with a higher efficiency class have
+// higher performance and lower efficiency. The efficiency class is used in
+// place of the speed.
+static void InitCPUInfo() {
+  std::vector<CpuIndexAndSpeed> cpu_speeds;
+
+  DWORD length = 0;
+  ::GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+  if (::GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    gCPUTracker = new CPUSpeedTracker(cpu_speeds);
+    return;
+  }
+
+  std::vector<uint8_t> buffer(length);
+  auto info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(
+      buffer.data());
+  if (!::GetLogicalProcessorInformationEx(RelationProcessorCore, info,
+                                          &length)) {
+    gCPUTracker = new CPUSpeedTracker(cpu_speeds);
+    return;
+  }
+
+  for (DWORD offset = 0; offset < length;) {
+    auto core = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(
+        buffer.data() + offset);
+    offset += core->Size;
+    if (core->Relationship != RelationProcessorCore) {
+      continue;
+    }
+    const auto& processor = core->Processor;
+    for (WORD group = 0; group < processor.GroupCount; group++) {
+      const auto& group_mask = processor.GroupMask[group];
+      for (size_t bit = 0; bit < kProcessorsPerGroup; bit++) {
+        if (!(group_mask.Mask & (static_cast<KAFFINITY>(1) << bit))) {
+          continue;
+        }
+        cpu_speeds.push_back({
+            .index = group_mask.Group * kProcessorsPerGroup + bit,
+            .speed = processor.EfficiencyClass,
+        });
+      }
+    }
+  }
+
+  gCPUTracker = new CPUSpeedTracker(cpu_speeds);
+}
+
+static bool SetUpCPUTracker() {
+  std::call_once(gCPUTrackerFlag, []() { InitCPUInfo(); });
+  return gCPUTracker != nullptr && gCPUTracker->IsValid();
+}
+
+std::optional<size_t> WinEfficiencyCoreCount() {
+  if (!SetUpCPUTracker()) {
+    return std::nullopt;
+  }
+  auto result = gCPUTracker->GetIndices(CpuAffinity::kEfficiency).size();
+  FML_DCHECK(result > 0);
+  return result;
+}
+
+bool WinRequestAffinity(CpuAffinity affinity) {
+  if (!SetUpCPUTracker()) {
+    return true;
+  }
+
+  // A thread can only have affinity to processors in a single group. Stay in
+  // the current group if it has any of the requested processors.
+  GROUP_AFFINITY current = {};
+  if (!::GetThreadGroupAffinity(::GetCurrentThread(), &current)) {
+    return false;
+  }
+
+  const auto& indices = gCPUTracker->GetIndices(affinity);
+  GROUP_AFFINITY requested = {};
+  requested.Group = static_cast<WORD>(indices.front() / kProcessorsPerGroup);
+  for (const auto index : indices) {
+    if (index / kProcessorsPerGroup == current.Group) {
+      requested.Group = current.Group;
+      break;
+    }
+  }
+  for (const auto index : indices) {
+    if (index / kProcessorsPerGroup == requested.Group) {
+      requested.Mask |= static_cast<KAFFINITY>(1)
+                        << (index % kProcessorsPerGroup);
+    }
+  }
+
+  return ::SetThreadGroupAffinity(::GetCurrentThread(), &requested, nullptr) !=
+         0;
+}
+
+}  // namespace fml
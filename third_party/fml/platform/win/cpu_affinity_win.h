@@ -0,0 +1,18 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_FML_PLATFORM_WIN_CPU_AFFINITY_WIN_H_
+#define FLUTTER_FML_PLATFORM_WIN_CPU_AFFINITY_WIN_H_
+
+#include "fml/cpu_affinity.h"
+
+namespace fml {
+
+std::optional<size_t> WinEfficiencyCoreCount();
+
+bool WinRequestAffinity(CpuAffinity affinity);
+
+}  // namespace fml
+
+#endif  // FLUTTER_FML_PLATFORM_WIN_CPU_AFFINITY_WIN_H_
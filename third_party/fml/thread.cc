@@ -11,6 +11,7 @@
 #include <utility>
 
 #include "fml/build_config.h"
+#include "fml/logging.h"
 #include "fml/message_loop.h"
 #include "fml/synchronization/waitable_event.h"
 
@@ -22,6 +23,10 @@
 #include <pthread.h>
 #endif
 
+#if defined(FML_OS_LINUX) || defined(FML_OS_ANDROID)
+#include <sys/resource.h>
+#endif
+
 namespace fml {
 
 typedef std::function<void()> ThreadFunction;
@@ -136,6 +141,51 @@ void Thread::SetCurrentThreadName(const Thread::ThreadConfig& config) {
   SetThreadName(config.name);
 }
 
+void Thread::SetCurrentThreadConfig(const Thread::ThreadConfig& config) {
+  SetCurrentThreadName(config);
+#if defined(FML_OS_WIN)
+  int priority = THREAD_PRIORITY_NORMAL;
+  switch (config.priority) {
+    case ThreadPriority::kBackground:
+      priority = THREAD_PRIORITY_BELOW_NORMAL;
+      break;
+    case ThreadPriority::kNormal:
+      break;
+    case ThreadPriority::kDisplay:
+      priority = THREAD_PRIORITY_ABOVE_NORMAL;
+      break;
+    case ThreadPriority::kRaster:
+      priority = THREAD_PRIORITY_HIGHEST;
+      break;
+  }
+  if (!::SetThreadPriority(::GetCurrentThread(), priority)) {
+    FML_LOG(ERROR) << "Could not set the priority of thread '" << config.name
+                   << "'.";
+  }
+#elif defined(FML_OS_LINUX) || defined(FML_OS_ANDROID)
+  // The nice value is per thread here. Raising the priority needs
+  // CAP_SYS_NICE, without it the thread keeps the default priority.
+  int nice = 0;
+  switch (config.priority) {
+    case ThreadPriority::kBackground:
+      nice = 10;
+      break;
+    case ThreadPriority::kNormal:
+      break;
+    case ThreadPriority::kDisplay:
+      nice = -4;
+      break;
+    case ThreadPriority::kRaster:
+      nice = -5;
+      break;
+  }
+  if (::setpriority(PRIO_PROCESS, 0, nice) != 0) {
+    FML_DLOG(INFO) << "Could not set the priority of thread '" << config.name
+                   << "'.";
+  }
+#endif
+}
+
 Thread::Thread(const std::string& name)
     : Thread(Thread::SetCurrentThreadName, ThreadConfig(name)) {}
 
@@ -60,6 +60,10 @@ class Thread {
 
   static void SetCurrentThreadName(const ThreadConfig& config);
 
+  /// Names the current thread and applies the priority where the platform
+  /// allows it.
+  static void SetCurrentThreadConfig(const ThreadConfig& config);
+
   static size_t GetDefaultStackSize();
 
  private: